@@ -0,0 +1,66 @@
+/*
+ * File: AssetLoader.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the AssetLoader class, defined in
+ *      AssetLoader.hpp.
+ */
+
+// Import class definition
+#include "AssetLoader.hpp"
+using namespace Battlefield;
+
+// Import the caches
+#include "ModelCache.hpp"
+#include "TextureCache.hpp"
+
+// Import threading stuff
+#include <thread>
+
+
+AssetLoader & AssetLoader::instance() {
+    static AssetLoader loader;
+    return loader;
+}
+
+// One thread per core, on top of the thread doing the asking (which
+// WorkerPool counts, but doesn't run submitted jobs on)
+AssetLoader::AssetLoader()
+        : pool(std::thread::hardware_concurrency() + 1, "asset loader") {
+    // Make sure the caches outlive us, since our jobs use them and we
+    // finish any that are left when we're destroyed
+    ModelCache::instance();
+    TextureCache::instance();
+}
+
+std::shared_future<SolidObject3DPtr> AssetLoader::requestModel(const string &filename) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<string, std::shared_future<SolidObject3DPtr> >::iterator m
+        = models.find(filename);
+    if (m != models.end())
+        return m->second;
+
+    std::shared_future<SolidObject3DPtr> result = pool.async([filename] {
+        return ModelCache::instance().model(filename);
+    });
+    models[filename] = result;
+    return result;
+}
+
+std::shared_future<MipChainPtr> AssetLoader::requestTexture(const string &filename) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<string, std::shared_future<MipChainPtr> >::iterator t
+        = textures.find(filename);
+    if (t != textures.end())
+        return t->second;
+
+    std::shared_future<MipChainPtr> result = pool.async([filename] {
+        return TextureCache::instance().mipChain(filename);
+    });
+    textures[filename] = result;
+    return result;
+}
@@ -0,0 +1,62 @@
+/*
+ * File: AssetLoader.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The AssetLoader class loads models and textures in the background,
+ *      on a pool of its own threads, so that setup code can ask for
+ *      everything it's going to need up front and get on with other things
+ *      while it loads.
+ *
+ *      Loads go through the ModelCache and TextureCache, so the rest of the
+ *      program doesn't need to know about the loader: asking a cache for
+ *      something that's being loaded in the background just waits for it
+ *      to finish, and asking for something that hasn't been started yet
+ *      loads it right there.
+ */
+
+#ifndef BATTLEFIELD_ASSET_LOADER
+#define BATTLEFIELD_ASSET_LOADER
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the caches the loader fills & the pool it runs on
+#include "MipChain.hpp"
+#include "WorkerPool.hpp"
+
+// Import STL & threading stuff
+#include <map>
+#include <future>
+#include <mutex>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class AssetLoader;
+};
+
+
+class Battlefield::AssetLoader {
+public:
+    // Singleton access function
+    static AssetLoader & instance();
+
+    // Start loading a model or texture, if nobody's asked for it yet. The
+    // future gives the result (or throws whatever the load threw).
+    std::shared_future<SolidObject3DPtr> requestModel(const string &filename);
+    std::shared_future<MipChainPtr> requestTexture(const string &filename);
+
+protected:
+    AssetLoader();
+
+    WorkerPool pool;
+    std::mutex lock;                // Guards the maps
+    std::map<string, std::shared_future<SolidObject3DPtr> > models;
+    std::map<string, std::shared_future<MipChainPtr> > textures;
+};
+
+#endif
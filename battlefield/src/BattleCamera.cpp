@@ -12,9 +12,12 @@
 
 // Import class definition
 #include "BattleCamera.hpp"
+#include "Metrics.hpp"
 using namespace Battlefield;
 
 void BattleCamera::update(double time) {
+    BATTLEFIELD_TIME_SCOPE("camera");
+
     bool changedPosition = false,
          changedLookAt   = false;
 
@@ -13,19 +13,37 @@
 #include "BattleScene.hpp"
 
 // Import other Battlefield classes
-#include "BattleUnitControl.hpp"
+#include "AssetLoader.hpp"
+#include "Checkpoint.hpp"
+#include "FleetControl.hpp"
 #include "GroundConstraint.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "SpatialGrid.hpp"
+#include "TerrainStreamer.hpp"
+#include "TextureCache.hpp"
+#include "Trace.hpp"
 using namespace Battlefield;
 
+// Import STL
+#include <random>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
 
 // Shortcut for constructing filenames
-#define IMG(NAME) string("data\\" #NAME)
+#define IMG(NAME) string("data/" #NAME)
 
 
 // Ground plane properties
 Transform::scalar_t FIELD_WIDTH     = 10.0;
 Transform::scalar_t FIELD_LENGTH    = 10.0;
 Transform::scalar_t FIELD_ELEVATION = 0.0;
+Transform::scalar_t TERRAIN_RELIEF  = 0.25;    // High minus low point
+size_t TERRAIN_MEMORY_BUDGET = 32 << 20;        // For the ground's meshes
 
 Material::Color FIELD_AMBIENT(0.2f, 0.2f, 0.2f);
 Material::Color FIELD_DIFFUSE(0.8f, 0.8f, 0.8f);
@@ -42,71 +60,60 @@ Material::scalar_t SUN_INTENSITY = 1.0f;
 // Physical rules
 RigidBody::Vector   GRAVITY(0.0, -9.8, 0.0);
 
-typedef SolidObject3D::LinearApproximation PolygonMesh;
-typedef SolidObject3D::LinearApproximationPtr PolygonMeshPtr;
+// Edge length of a unit-avoidance grid cell (the avoidance radius)
+Transform::scalar_t UNIT_GRID_CELL_SIZE = 0.5;
+
+// How many units each thread picks models for at a time
+const size_t VIEW_CHUNK_SIZE = 512;
+
+// Standard battle setup parameters
+const Transform::Vector ROW_OFFSET(0.5, 0.0, 0.0);
+const Transform::Vector ECHELON_OFFSET(0.2, 0.0, 0.4);
+const Transform::Vector DIAMOND_OFFSET(0.4, 0.0, 0.5);
+
+// Random army parameters
+const UnitType ARMY_UNIT_TYPES[] = { LightTankType, HeavyTankType, HumveeType, APCType };
+const Transform::scalar_t ARMY_MAX_HEADING = Transform::PI / 8.0;
+
+// The phases of a frame we keep track of, in the order they're reported.
+// Integration isn't timed directly: it's whatever part of the step isn't
+// accounted for by the other phases.
+const char * FRAME_PHASES[] = {
+    "ai", "dynamics", "constraints", "integration", "step", "camera", "terrain",
+    "view", "render"
+};
 
 
 // Constructor
-BattleScene::BattleScene() {
-    // Configure the rigid-body simulator
-    system = RigidBodySystemPtr(new RigidBodySystem(0.0));
+BattleScene::BattleScene(const string &terrainImage) : currentTime(0.0) {
+    // Get the models & textures loading while we set everything else up
+    requestAssets();
 
-    // We should, of course, have gravity to keep us on the ground
-    SecondDerivOpPtr op2 = new SimpleGravityForce(GRAVITY);
-    system->add(op2);
+    // Shape the ground
+    if (! terrainImage.empty())
+        field = Terrain::load(terrainImage, FIELD_LENGTH, FIELD_ELEVATION, TERRAIN_RELIEF);
+    if (field == NULL)
+        field = Terrain::flat(FIELD_LENGTH, FIELD_WIDTH, FIELD_ELEVATION);
 
-    // We want to ensure that we don't penetrate the ground
-    ZerothDerivOpPtr op0 = new GroundConstraint(FIELD_ELEVATION);
-    system->add(op0);
+    // Have the frame phases show up in order, whichever runs first
+    for (size_t i = 0; i < sizeof(FRAME_PHASES) / sizeof(FRAME_PHASES[0]); i++)
+        Metrics::instance().timer(FRAME_PHASES[i]);
+
+    // Set up the physics
+    initializeDynamics(0.0, UnitStateTablePtr(new UnitStateTable()));
 
-    // Build the mesh that represents the ground
-    PolygonMeshPtr mesh(new PolygonMesh());
-    PolygonMesh::VertexPtr v[4];
-    v[0] = mesh->createVertex(PolygonMesh::Point(-FIELD_LENGTH / 2.0, FIELD_ELEVATION, -FIELD_WIDTH / 2.0));
-    v[1] = mesh->createVertex(PolygonMesh::Point(FIELD_LENGTH / 2.0, FIELD_ELEVATION, -FIELD_WIDTH / 2.0));
-    v[2] = mesh->createVertex(PolygonMesh::Point(FIELD_LENGTH / 2.0, FIELD_ELEVATION, FIELD_WIDTH / 2.0));
-    v[3] = mesh->createVertex(PolygonMesh::Point(-FIELD_LENGTH / 2.0, FIELD_ELEVATION, FIELD_WIDTH / 2.0));
-    index_t normal = mesh->createNormal(PolygonMesh::Vector(0.0, 1.0, 0.0));
-    index_t tex[4];
-    tex[0] = mesh->createTexCoords(PolygonMesh::TexCoords(0.0, 0.0));
-    tex[1] = mesh->createTexCoords(PolygonMesh::TexCoords(FIELD_TEXTURE_REPEAT_U, 0.0));
-    tex[2] = mesh->createTexCoords(PolygonMesh::TexCoords(FIELD_TEXTURE_REPEAT_U, FIELD_TEXTURE_REPEAT_V));
-    tex[3] = mesh->createTexCoords(PolygonMesh::TexCoords(0.0, FIELD_TEXTURE_REPEAT_V));
-    PolygonMesh::FaceVertexPtrList vertices;
-    vertices.push_back(mesh->createFaceVertex(v[0]));
-    vertices[0]->setNormalIndex(normal);
-    vertices[0]->setTexCoordsIndex(tex[0]);
-    vertices.push_back(mesh->createFaceVertex(v[3]));
-    vertices[1]->setNormalIndex(normal);
-    vertices[1]->setTexCoordsIndex(tex[3]);
-    vertices.push_back(mesh->createFaceVertex(v[2]));
-    vertices[2]->setNormalIndex(normal);
-    vertices[2]->setTexCoordsIndex(tex[2]);
-    mesh->createFace(vertices);
-    vertices.clear();
-    vertices.push_back(mesh->createFaceVertex(v[0]));
-    vertices[0]->setNormalIndex(normal);
-    vertices[0]->setTexCoordsIndex(tex[0]);
-    vertices.push_back(mesh->createFaceVertex(v[2]));
-    vertices[1]->setNormalIndex(normal);
-    vertices[1]->setTexCoordsIndex(tex[2]);
-    vertices.push_back(mesh->createFaceVertex(v[1]));
-    vertices[2]->setNormalIndex(normal);
-    vertices[2]->setTexCoordsIndex(tex[1]);
-    mesh->createFace(vertices);
-
-    // Construct the material properties
+    // Construct the material properties (the streamer textures its own
+    // copies of these)
     MaterialPtr groundMat(new Material());
     groundMat->illuminated = true;
-    groundMat->setImage(FIELD_TEXTURE);
     groundMat->ambient = FIELD_AMBIENT;
     groundMat->diffuse = FIELD_DIFFUSE;
     groundMat->specular = FIELD_SPECULAR;
 
-    // Put it all together
-    groundPlane = SolidObject3DPtr(new SolidObject3D());
-    groundPlane->addApproximation(mesh);
-    groundPlane->addMaterial(groundMat);
+    // The ground's meshes come & go as the camera moves around
+    streamer = TerrainStreamerPtr(new TerrainStreamer(*this, field, groundMat,
+            FIELD_TEXTURE, FIELD_TEXTURE_REPEAT_U, FIELD_TEXTURE_REPEAT_V,
+            TERRAIN_MEMORY_BUDGET));
 
     // Create the sun
     sunLight = LightPtr(new Light());
@@ -115,10 +122,86 @@ BattleScene::BattleScene() {
     sunLight->transform->setLocationPoint(new Transform::Point(SUN_LOCATION));
 
     // Stick it all in the scene
-    addObject(groundPlane);
     addLight(sunLight);
 }
 
+void BattleScene::initializeDynamics(double startTime, UnitStateTablePtr table) {
+    // Configure the rigid-body simulator
+    system = RigidBodySystemPtr(new RigidBodySystem(startTime));
+
+    // All of the units' per-step state lives here
+    unitState = table;
+
+    // We should, of course, have gravity to keep us on the ground
+    SecondDerivOpPtr op2 = new SimpleGravityForce(GRAVITY);
+    system->add(op2);
+
+    // We want to ensure that we don't penetrate the ground
+    ground = new GroundConstraint(field, unitState);
+    ZerothDerivOpPtr op0 = ground;
+    system->add(op0);
+
+    // All of the units are driven by a single fleet-wide controller, which
+    // uses the grid to find units' neighbours. This must come after gravity,
+    // since friction only acts on units that are pressed against the ground.
+    bool indexing = (unitGrid == NULL || unitGrid->enabled());
+    unitGrid = SpatialGridPtr(new SpatialGrid(UNIT_GRID_CELL_SIZE));
+    unitGrid->setEnabled(indexing);
+    fleet = new FleetControl(unitState, unitGrid);
+    if (workers == NULL)
+        setThreadCount(1);
+    else
+        fleet->setWorkerPool(workers);
+    system->add(static_cast<ThirdDerivOp *>(fleet));
+    system->add(static_cast<SecondDerivOp *>(fleet));
+}
+
+void BattleScene::updateTerrain(const Transform::Point &lookAt,
+                                Transform::scalar_t rho) {
+    streamer->update(lookAt, rho);
+}
+
+void BattleScene::updateView(const ViewFrustum &view) {
+    BATTLEFIELD_TIME_SCOPE("view");
+    BATTLEFIELD_TRACE_SCOPE("view");
+
+    // Every unit only changes itself, so they can all do this at once
+    std::atomic<size_t> drawn(0);
+    std::mutex markersLock;
+    std::vector<BattleUnitPtr> needMarkers;
+    workers->parallelFor(battleUnitCount(), VIEW_CHUNK_SIZE,
+                         [&](size_t begin, size_t end) {
+        size_t visible = 0;
+        for (size_t i = begin; i < end; i++) {
+            BattleUnitPtr unit = battleUnit(i);
+            unit->chooseDetail(view);
+            if (unit->detailLevel() >= 0)
+                visible++;
+            if (unit->goalMarker == NULL && unit->showsGoal()) {
+                std::lock_guard<std::mutex> guard(markersLock);
+                needMarkers.push_back(unit);
+            }
+        }
+        drawn += visible;
+    });
+    BATTLEFIELD_COUNT("units drawn", drawn.load());
+
+    // Give goal markers to the units showing one for the first time. They
+    // go after their units, so they're always placed before they're drawn.
+    for (size_t i = 0; i < needMarkers.size(); i++) {
+        needMarkers[i]->goalMarker = GoalMarkerPtr(new GoalMarker());
+        addObject(static_pointer_cast<Object>(needMarkers[i]->goalMarker));
+    }
+}
+
+void BattleScene::requestAssets() {
+    BattleUnit::requestModels();
+
+    // Textures are only any use if something's going to draw them
+    if (TextureCache::instance().isRendering())
+        AssetLoader::instance().requestTexture(FIELD_TEXTURE);
+}
+
 void BattleScene::addBattleUnit(BattleUnitPtr unit) {
     // Add this to the Scene superclass
     ObjectPtr obj = static_pointer_cast<Object>(unit);
@@ -126,132 +209,442 @@ void BattleScene::addBattleUnit(BattleUnitPtr unit) {
 
     // Make sure we've got one selected
     if (battleUnitCount() == 0)
-        unit->selected = true;
+        unit->setSelected(true);
 
     // Put it into the rigid body system
     SolidObject3DPtr s3o = static_pointer_cast<SolidObject3D>(unit);
     RigidBodyPtr rb = new RigidBody(s3o, unit->mass);
     unit->rigidBody = shared_ptr<RigidBody>(rb);
     system->add(rb);
-    BattleUnitControl * buc(new BattleUnitControl(unit, rb));
-    system->add(static_cast<ThirdDerivOp *>(buc));
-    system->add(static_cast<SecondDerivOp *>(buc));
+    fleet->addUnit(unit, rb);
 
     // Stick it in our special list of units
     ADD_VALUE(battleUnit, unit);
 }
 
 BattleUnitPtr BattleScene::addBattleUnit(const string &type) {
-    BattleUnitPtr bu;
-    try {
-        if (type == "APC")
-            bu = BattleUnitPtr(new APC());
-        else if (type == "humvee")
-            bu = BattleUnitPtr(new Humvee());
-        else if (type == "light tank")
-            bu = BattleUnitPtr(new LightTank());
-        else if (type == "heavy tank")
-            bu = BattleUnitPtr(new HeavyTank());
-        else
-            cerr << "addBattleUnit(\"" << type << "\"): Unsupported unit type\n";
+    UnitType t = unitTypeNamed(type);
+    if (t == NoUnitType) {
+        BATTLEFIELD_LOG(Error, "addBattleUnit(\"" << type << "\"): Unsupported unit type");
+        return BattleUnitPtr();
+    }
+    if (spawnUnits(t, 1) == 0)
+        return BattleUnitPtr();
+    return battleUnit(battleUnitCount() - 1);
+}
 
-        // If we were successful, stick it in
-        if (bu != NULL)
-            addBattleUnit(bu);
+size_t BattleScene::spawnUnits(UnitType type, size_t count,
+                               const UnitPlacement *placements) {
+    BATTLEFIELD_TRACE_SCOPE("spawn units");
+    if (type >= UNIT_TYPE_COUNT) {
+        BATTLEFIELD_LOG(Error, "spawnUnits(" << int(type) << "): Unsupported unit type");
+        return 0;
+    }
 
+    // Make all the room we need up front, then build everybody in one pass
+    reserveUnits(count);
+    size_t made = 0;
+    try {
+        for (; made < count; made++) {
+            BattleUnitPtr unit = BattleUnit::create(type, unitState);
+            if (placements != NULL) {
+                const UnitPlacement &p = placements[made];
+                unit->transform->setRotation(p.rotation);
+                if (p.heading != 0.0)
+                    unit->transform->rotateY(p.heading);
+                unit->transform->setLocationPoint(new Point(p.location));
+            }
+            addBattleUnit(unit);
+        }
     } catch (const Inca::IncaException &e) {    // Boom.
-        cerr << "addBattleUnit(\"" << type << "\"): " << e << '\n';
+        BATTLEFIELD_LOG(Error, "spawnUnits(\"" << UNIT_TYPE_NAMES[type] << "\"): " << e);
     }
+    return made;
+}
 
-    return bu;
+void BattleScene::reserveUnits(size_t count) {
+    size_t n = unitState->size() + count;
+    unitState->reserve(n);
+    fleet->reserve(n);
 }
 
 // Formation creation functions
+void BattleScene::createTeam() {
+    BattleUnitPtr lt = addBattleUnit("light tank");
+    BattleUnitPtr ht = addBattleUnit("heavy tank");
+    BattleUnitPtr hv = addBattleUnit("humvee");
+    BattleUnitPtr pc = addBattleUnit("APC");
+
+    pc->transform->translate(Vector(0.0, 0.0, 3.0));
+    hv->transform->translate(Vector(0.0, 0.0, -3.0));
+    hv->transform->rotateY(-Transform::PI);
+    lt->transform->translate(Vector(3.0, 0.0, 0.0));
+    lt->transform->rotateY(Transform::PI / 2.0);
+    ht->transform->translate(Vector(-3.0, 0.0, 0.0));
+    ht->transform->rotateY(-Transform::PI / 2.0);
+
+    createRow(hv, LightTankType, ROW_OFFSET, 4);
+    createRow(ht, HumveeType, ECHELON_OFFSET, 4);
+    createDiamond(lt, APCType, DIAMOND_OFFSET);
+    createTriangle(pc, HeavyTankType, DIAMOND_OFFSET);
+}
+
+void BattleScene::createArmy(size_t count, Transform::scalar_t spacing,
+                             unsigned int seed) {
+    typedef Transform::scalar_t scalar_t;
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> pickType(0, 3);
+    std::uniform_real_distribution<scalar_t> pickHeading(-ARMY_MAX_HEADING,
+                                                         ARMY_MAX_HEADING);
+
+    size_t side = size_t(std::ceil(std::sqrt(double(count))));
+    scalar_t half = side * spacing / 2.0;
+
+    // Lay everybody out first...
+    std::vector<UnitType> types(count);
+    std::vector<UnitPlacement> placements(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t row = i / side, col = i % side;
+        types[i] = ARMY_UNIT_TYPES[pickType(random)];
+        placements[i].location = Point(col * spacing - half, 0.0, row * spacing - half);
+        placements[i].heading = pickHeading(random);
+    }
+
+    // ...then make them, a run of the same type at a time
+    size_t first = battleUnitCount(), made = 0;
+    reserveUnits(count);
+    while (made < count) {
+        size_t run = 1;
+        while (made + run < count && types[made + run] == types[made])
+            run++;
+        size_t n = spawnUnits(types[made], run, &placements[made]);
+        made += n;
+        if (n < run)
+            break;              // Already complained about
+    }
+
+    // Each unit follows the one ahead of it in its row
+    for (size_t i = 0; i < made; i++) {
+        if (i % side != 0) {
+            BattleUnitPtr unit = battleUnit(first + i);
+            unit->target = battleUnit(first + i - 1);
+            unit->targetOffset = Vector(-spacing, 0.0, 0.0);
+        }
+    }
+}
+
 void BattleScene::createRow(BattleUnitPtr leader,
-                            const string &unitType,
+                            UnitType type,
                             const Vector &offset,
                             size_t number) {
-    const Quaternion &leaderRotation = leader->transform->rotation();
-    Vector relOffset = leaderRotation.rotate(offset);
-    Vector relFromLeader = relOffset;
+    std::vector<Vector> offsets;
+    offsets.reserve(number);
     Vector absFromLeader = offset;
     for (size_t i = 0; i < number; i++) {
-        BattleUnitPtr unit = addBattleUnit(unitType);
-        unit->target = leader;
-        unit->targetOffset = absFromLeader;
-        unit->relativeOffset = true;
-        unit->transform->setRotation(leaderRotation);
-        unit->transform->setLocationPoint(
-            new Point(*leader->transform->locationPoint() + relFromLeader));
-
-        // Advance down the line
-        absFromLeader += offset;
-        relFromLeader += relOffset;
+        offsets.push_back(absFromLeader);
+        absFromLeader += offset;            // Advance down the line
     }
+    createFormation(leader, type, offsets);
 }
 
 void BattleScene::createDiamond(BattleUnitPtr leader,
-                                const string &unitType,
+                                UnitType type,
                                 const Vector &offset) {
-    const Quaternion &leaderRotation = leader->transform->rotation();
-    Vector relOffset = leaderRotation.rotate(offset);
-    Vector absReflected = reflect(offset, Vector(0.0, 0.0, -1.0));
-    Vector relReflected = leaderRotation.rotate(absReflected);
-    Vector relFromLeader, absFromLeader;
-    for (size_t i = 0; i < 3; i++) {
-        switch (i) {
-        case 0:
-            relFromLeader = relOffset;
-            absFromLeader = offset;
-            break;
-        case 1:
-            relFromLeader = relReflected;
-            absFromLeader = absReflected;
-            break;
-        case 2:
-            relFromLeader = relOffset + relReflected;
-            absFromLeader = offset + absReflected;
-            break;
-        }
-        BattleUnitPtr unit = addBattleUnit(unitType);
-        unit->target = leader;
-        unit->targetOffset = absFromLeader;
-        unit->relativeOffset = true;
-        unit->transform->setRotation(leaderRotation);
-        unit->transform->setLocationPoint(
-            new Point(*leader->transform->locationPoint() + relFromLeader));
-    }
+    Vector reflected = reflect(offset, Vector(0.0, 0.0, -1.0));
+    std::vector<Vector> offsets;
+    offsets.push_back(offset);
+    offsets.push_back(reflected);
+    offsets.push_back(offset + reflected);
+    createFormation(leader, type, offsets);
 }
 
 void BattleScene::createTriangle(BattleUnitPtr leader,
-                                 const string &unitType,
+                                 UnitType type,
                                  const Vector &offset) {
+    std::vector<Vector> offsets;
+    offsets.push_back(offset);
+    offsets.push_back(reflect(offset, Vector(0.0, 0.0, -1.0)));
+    createFormation(leader, type, offsets);
+}
+
+void BattleScene::createFormation(BattleUnitPtr leader,
+                                  UnitType type,
+                                  const std::vector<Vector> &offsets) {
     const Quaternion &leaderRotation = leader->transform->rotation();
-    Vector relOffset = leaderRotation.rotate(offset);
-    Vector absReflected = reflect(offset, Vector(0.0, 0.0, -1.0));
-    Vector relReflected = leaderRotation.rotate(absReflected);
-    Vector relFromLeader, absFromLeader;
-    for (size_t i = 0; i < 2; i++) {
-        switch (i) {
-        case 0:
-            relFromLeader = relOffset;
-            absFromLeader = offset;
-            break;
-        case 1:
-            relFromLeader = relReflected;
-            absFromLeader = absReflected;
-            break;
-        }
-        BattleUnitPtr unit = addBattleUnit(unitType);
+    const Point &leaderLocation = *leader->transform->locationPoint();
+
+    // Everybody starts out in position, facing the same way as the leader
+    std::vector<UnitPlacement> placements;
+    placements.reserve(offsets.size());
+    for (size_t i = 0; i < offsets.size(); i++)
+        placements.push_back(UnitPlacement(
+            leaderLocation + leaderRotation.rotate(offsets[i]), leaderRotation));
+
+    size_t first = battleUnitCount();
+    size_t made = spawnUnits(type, offsets.size(), placements.empty() ? NULL : &placements[0]);
+    for (size_t i = 0; i < made; i++) {
+        BattleUnitPtr unit = battleUnit(first + i);
         unit->target = leader;
-        unit->targetOffset = absFromLeader;
+        unit->targetOffset = offsets[i];
         unit->relativeOffset = true;
-        unit->transform->setRotation(leaderRotation);
-        unit->transform->setLocationPoint(
-            new Point(*leader->transform->locationPoint() + relFromLeader));
     }
 }
 
+void BattleScene::setThreadCount(size_t threads) {
+    workers = WorkerPoolPtr(new WorkerPool(threads, "scene worker"));
+    fleet->setWorkerPool(workers);
+}
+
 void BattleScene::update(double time) {
-    system->update(time);
-}
\ No newline at end of file
+    BATTLEFIELD_TRACE_SCOPE("scene update");
+
+    // Apply (and log) the control changes made since the last step
+    for (size_t i = 0; i < pendingControls.size(); i++) {
+        applyControl(pendingControls[i]);
+        if (recorder != NULL)
+            recorder->recordControl(pendingControls[i]);
+    }
+    pendingControls.clear();
+    if (recorder != NULL)
+        recorder->recordStep(time);
+    currentTime = time;
+
+    Metrics &metrics = Metrics::instance();
+    static Metrics::Metric &step        = metrics.timer("step"),
+                           &ai          = metrics.timer("ai"),
+                           &dynamics    = metrics.timer("dynamics"),
+                           &constraints = metrics.timer("constraints"),
+                           &integration = metrics.timer("integration");
+    // Whatever part of the step isn't one of the others is integration. (A
+    // frame may take several steps, so only count what this one added.)
+    long long others = ai.sum() + dynamics.sum() + constraints.sum();
+    long long start = step.sum();
+    {
+        Metrics::ScopedTimer timer(step);
+        system->update(time);
+    }
+    integration.add(step.sum() - start
+                    - (ai.sum() + dynamics.sum() + constraints.sum() - others));
+}
+
+
+// Control changes & recording
+void BattleScene::queueControl(const ControlEvent &e) {
+    pendingControls.push_back(e);
+}
+
+void BattleScene::applyControl(const ControlEvent &e) {
+    if (e.unit >= battleUnitCount()) {
+        BATTLEFIELD_LOG(Warning, "Control change for nonexistent unit " << e.unit);
+        return;
+    }
+
+    BattleUnitPtr unit = battleUnit(e.unit);
+    switch (e.control) {
+        case SelectControl:     unit->setSelected(e.value != 0.0);      break;
+        case ManualControl:     unit->setManualControl(e.value != 0.0); break;
+        case ThrottleControl:   unit->throttle = e.value;               break;
+        case BrakeControl:      unit->brake = e.value;                  break;
+        case WheelControl:      unit->wheelDeflection = e.value;        break;
+    }
+}
+
+void BattleScene::setRecorder(InputRecorderPtr r) {
+    if (recorder != NULL)
+        recorder->finish(stateHash());
+    recorder = r;
+}
+
+uint64_t BattleScene::stateHash() {
+    // FNV-1a, over the exact bits of each value
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](Transform::scalar_t value) {
+        unsigned char bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        for (size_t i = 0; i < sizeof(value); i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    for (index_t i = 0; i < battleUnitCount(); i++) {
+        BattleUnitPtr unit = battleUnit(i);
+        const Transform::Point &p = *unit->transform->locationPoint();
+        const Transform::Vector &f = unit->transform->front();
+        const RigidBody::Vector &P = unit->rigidBody->P;
+        for (index_t j = 0; j < 3; j++) {
+            mix(p[j]);
+            mix(f[j]);
+            mix(P[j]);
+        }
+    }
+    return hash;
+}
+
+
+// Checkpoints
+std::shared_future<bool> BattleScene::checkpoint(const string &filename) {
+    BATTLEFIELD_TRACE_SCOPE("checkpoint");
+    const UnitStateTable &t = *unitState;
+    size_t count = battleUnitCount();
+
+    // Units refer to each other by their place in the list, so work out
+    // what that is for every slot in the state table
+    std::vector<uint32_t> indexOfSlot(t.size(), CHECKPOINT_NONE);
+    for (index_t i = 0; i < count; i++)
+        indexOfSlot[battleUnit(i)->stateSlot()] = uint32_t(i);
+
+    // Pack everything up into one buffer, which is exactly what goes into
+    // the file
+    shared_ptr<std::vector<unsigned char> > data(new std::vector<unsigned char>(
+            sizeof(CheckpointHeader) + count * sizeof(CheckpointUnit), 0));
+    CheckpointHeader &h = *reinterpret_cast<CheckpointHeader *>(&(*data)[0]);
+    std::memcpy(h.magic, CHECKPOINT_MAGIC, 4);
+    h.version    = CHECKPOINT_VERSION;
+    h.unitCount  = uint32_t(count);
+    h.unitSize   = sizeof(CheckpointUnit);
+    h.unitOffset = sizeof(CheckpointHeader);
+    h.time       = currentTime;
+
+    CheckpointUnit *records = reinterpret_cast<CheckpointUnit *>(&(*data)[h.unitOffset]);
+    for (index_t i = 0; i < count; i++) {
+        BattleUnitPtr unit = battleUnit(i);
+        CheckpointUnit &r = records[i];
+        index_t s = unit->stateSlot();
+
+        const Transform::Point &p = *unit->transform->locationPoint();
+        const Quaternion &q = unit->transform->rotation();
+        const RigidBody::Vector &P = unit->rigidBody->P, &L = unit->rigidBody->L;
+        const Vector &offset = unit->targetOffset;
+        for (index_t j = 0; j < 3; j++) {
+            r.location[j]         = p[j];
+            r.momentum[j]         = P[j];
+            r.angularMomentum[j]  = L[j];
+            r.goalDisplacement[j] = t.goalDisplacement[s][j];
+            r.goalVelocity[j]     = t.goalVelocity[s][j];
+            r.targetOffset[j]     = offset[j];
+        }
+        for (index_t j = 0; j < 4; j++)
+            r.rotation[j] = q[j];
+        r.throttle        = t.throttle[s];
+        r.brake           = t.brake[s];
+        r.wheelDeflection = t.wheelDeflection[s];
+
+        r.type = uint32_t(unit->unitType());
+        BattleUnitPtr target = unit->target;
+        r.target = (target != NULL && target->stateSlot() < indexOfSlot.size())
+                        ? indexOfSlot[target->stateSlot()] : CHECKPOINT_NONE;
+        r.action = uint32_t(BattleAction(unit->action));
+        r.armor  = unit->armor;
+        r.ammo   = unit->ammo;
+        r.morale = unit->morale;
+        r.team   = unit->team;
+        r.rank   = unit->rank;
+        r.flags  = (unit->selected()       ? CHECKPOINT_SELECTED : 0)
+                 | (unit->manualControl()  ? CHECKPOINT_MANUAL_CONTROL : 0)
+                 | (unit->renderGoal       ? CHECKPOINT_RENDER_GOAL : 0)
+                 | (unit->relativeOffset   ? CHECKPOINT_RELATIVE_OFFSET : 0);
+    }
+
+    // The simulation can get on with things while the file is written, on
+    // a thread of its own (the AI pool may not have any to spare)
+    if (writer == NULL)
+        writer = WorkerPoolPtr(new WorkerPool(2, "checkpoint writer"));
+    string name = filename;
+    return writer->async([data, name]() {
+        BATTLEFIELD_TRACE_SCOPE("write checkpoint");
+        bool ok = writeCheckpointFile(name, *data);
+        if (ok)
+            BATTLEFIELD_LOG(Info, "Wrote checkpoint " << name << " ("
+                                  << data->size() << " bytes)");
+        else
+            BATTLEFIELD_LOG(Error, "Couldn't write checkpoint " << name);
+        return ok;
+    });
+}
+
+bool BattleScene::restore(const string &filename) {
+    BATTLEFIELD_TRACE_SCOPE("restore");
+    if (battleUnitCount() != 0) {
+        BATTLEFIELD_LOG(Error, "restore(\"" << filename << "\"): Scene already has units");
+        return false;
+    }
+
+    MappedFile file(filename);
+    CheckpointView view;
+    if (! view.open(file.data(), file.size(), UNIT_TYPE_COUNT, BATTLE_ACTION_COUNT)) {
+        BATTLEFIELD_LOG(Error, "restore(\"" << filename << "\"): Not a valid checkpoint");
+        return false;
+    }
+
+    // Build everybody before touching the scene, so that if a model won't
+    // load, we're left just as we were
+    const CheckpointUnit *records = view.units();
+    uint32_t count = view.unitCount();
+    UnitStateTablePtr table(new UnitStateTable());
+    table->reserve(count);
+    std::vector<BattleUnitPtr> units(count);
+    try {
+        for (uint32_t i = 0; i < count; i++) {
+            const CheckpointUnit &r = records[i];
+            units[i] = BattleUnit::create(UnitType(r.type), table);
+            Quaternion rotation;
+            for (index_t j = 0; j < 4; j++)
+                rotation[j] = r.rotation[j];
+            units[i]->transform->setRotation(rotation);
+            units[i]->transform->setLocationPoint(
+                    new Point(r.location[0], r.location[1], r.location[2]));
+        }
+    } catch (const Inca::IncaException &e) {
+        BATTLEFIELD_LOG(Error, "restore(\"" << filename << "\"): " << e);
+        return false;
+    }
+
+    // Start the physics over from the checkpoint's time, with them in it
+    initializeDynamics(view.time(), table);
+    currentTime = view.time();
+    fleet->reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+        addBattleUnit(units[i]);
+
+    // Then put back everything else
+    for (uint32_t i = 0; i < count; i++) {
+        const CheckpointUnit &r = records[i];
+        const BattleUnitPtr &unit = units[i];
+        unit->rigidBody->P = RigidBody::Vector(r.momentum[0], r.momentum[1],
+                                               r.momentum[2]);
+        unit->rigidBody->L = RigidBody::Vector(r.angularMomentum[0],
+                                               r.angularMomentum[1],
+                                               r.angularMomentum[2]);
+
+        unit->throttle         = r.throttle;
+        unit->brake            = r.brake;
+        unit->wheelDeflection  = r.wheelDeflection;
+        unit->goalDisplacement = Vector(r.goalDisplacement[0], r.goalDisplacement[1],
+                                        r.goalDisplacement[2]);
+        unit->goalVelocity     = Vector(r.goalVelocity[0], r.goalVelocity[1],
+                                        r.goalVelocity[2]);
+        unit->targetOffset     = Vector(r.targetOffset[0], r.targetOffset[1],
+                                        r.targetOffset[2]);
+
+        unit->action = BattleAction(r.action);
+        unit->armor  = r.armor;
+        unit->ammo   = r.ammo;
+        unit->morale = r.morale;
+        unit->team   = r.team;
+        unit->rank   = r.rank;
+        unit->setSelected((r.flags & CHECKPOINT_SELECTED) != 0);
+        unit->setManualControl((r.flags & CHECKPOINT_MANUAL_CONTROL) != 0);
+        unit->renderGoal     = (r.flags & CHECKPOINT_RENDER_GOAL) != 0;
+        unit->relativeOffset = (r.flags & CHECKPOINT_RELATIVE_OFFSET) != 0;
+    }
+
+    // Now that everybody exists, hook up who's following whom
+    for (uint32_t i = 0; i < count; i++)
+        if (records[i].target != CHECKPOINT_NONE)
+            units[i]->target = units[records[i].target];
+
+    BATTLEFIELD_LOG(Info, "Restored " << count << " units from " << filename
+                          << " at t = " << currentTime);
+    return true;
+}
@@ -20,6 +20,9 @@
 namespace Battlefield {
     // Forward declarations
     class BattleScene;
+    class FleetControl;
+    class GroundConstraint;
+    struct UnitPlacement;
 
     // Pointer type definitions
     typedef shared_ptr<BattleScene> BattleScenePtr;
@@ -27,37 +30,154 @@ namespace Battlefield {
 
 // Import other battle type definitions
 #include "BattleUnit.hpp"
+#include "SpatialGrid.hpp"
+#include "WorkerPool.hpp"
+#include "InputLog.hpp"
+#include "Terrain.hpp"
+#include "TerrainStreamer.hpp"
+
+// Import STL
+#include <future>
+
+
+// Where to put a newly spawned unit: it's given 'rotation', then turned by
+// 'heading' about the vertical
+struct Battlefield::UnitPlacement {
+    UnitPlacement() : location(0.0, 0.0, 0.0), heading(0.0) { }
+    UnitPlacement(const Point &p, const Quaternion &q, Transform::scalar_t h = 0.0)
+        : location(p), rotation(q), heading(h) { }
+
+    Point location;
+    Quaternion rotation;
+    Transform::scalar_t heading;
+};
 
 
 class Battlefield::BattleScene : public Scene {
 public:
-    // Constructor
-    BattleScene();
+    // Constructor, with the ground shaped like the greyscale of
+    // 'terrainImage' (or flat, if that's empty or can't be read)
+    explicit BattleScene(const string &terrainImage = "");
+
+    // Start loading all the models & textures a battle uses in the
+    // background (the constructor does this, but calling it earlier gives
+    // the loads more of a head start). Textures are left alone unless the
+    // TextureCache has been told we're rendering.
+    static void requestAssets();
 
     // List of battle units
     PTR_PROPERTY_LIST_ADD(battleUnit, BattleUnit, addBattleUnit);
     BattleUnitPtr addBattleUnit(const string &type);
 
-    // Team/formation construction functions
+    // Create 'count' units of one type in one go, placed as in 'placements'
+    // (or all at the origin, if that's NULL). They're added to the end of
+    // the unit list. Returns how many were made, which is fewer than asked
+    // for only if something went wrong (and was logged).
+    size_t spawnUnits(UnitType type, size_t count,
+                      const UnitPlacement *placements = NULL);
+
+    // Make room for 'count' more units, so that adding them doesn't keep
+    // growing our tables (spawnUnits() does this itself)
+    void reserveUnits(size_t count);
+
+    // Team/formation construction functions. createTeam() sets up the
+    // standard four-formation battle; createArmy() lays out 'count' units in
+    // a square block, each following the unit ahead of it in its row, with
+    // unit types and headings picked at random from 'seed'.
     void createTeam();
+    void createArmy(size_t count, Transform::scalar_t spacing,
+                    unsigned int seed);
     void createRow(BattleUnitPtr leader,
-                   const string &unitType,
+                   UnitType type,
                    const Vector &offset,
                    size_t number);
     void createDiamond(BattleUnitPtr leader,
-                       const string &unitType,
+                       UnitType type,
                        const Vector &offset);
     void createTriangle(BattleUnitPtr leader,
-                        const string &unitType,
+                        UnitType type,
                         const Vector &offset);
 
-    // Simulation update function
+    // Units of 'type' following 'leader', one at each of 'offsets' (in the
+    // leader's frame), facing the same way it is
+    void createFormation(BattleUnitPtr leader,
+                         UnitType type,
+                         const std::vector<Vector> &offsets);
+
+    // Simulation update function, and the time it was last called with
     void update(double time);
+    double simulationTime() const { return currentTime; }
+
+    // Bring in the ground around where the camera's looking (once a frame,
+    // when there's something to draw it)
+    void updateTerrain(const Transform::Point &lookAt, Transform::scalar_t rho);
+
+    // Have each unit pick the model it's drawn with (or whether it's drawn
+    // at all) for what 'view' can see, before the frame is drawn. Units
+    // showing their goal for the first time get their marker here too.
+    void updateView(const ViewFrustum &view);
+
+    // Save a snapshot of the battle to 'filename'. The units are copied out
+    // right away; the file is written in the background, and the future
+    // says whether that worked.
+    std::shared_future<bool> checkpoint(const string &filename);
+
+    // Rebuild the battle saved in a checkpoint. The scene must not have any
+    // units yet. The next update() carries on from the checkpoint's time.
+    bool restore(const string &filename);
+
+    // Change a unit's controls. The change is applied at the start of the
+    // next update(), so that it happens at the same point in a replay.
+    void queueControl(const ControlEvent &e);
+
+    // Log the controls applied & steps taken to 'r' (or stop logging, if
+    // it's NULL). Any recorder we had before is finished off with a hash
+    // of where everybody ended up.
+    void setRecorder(InputRecorderPtr r);
+
+    // A hash of every unit's position, heading and momentum, for telling
+    // whether two runs came out exactly the same
+    uint64_t stateHash();
+
+    // Turn the spatial index used for unit avoidance on/off. With it off,
+    // every unit checks every other unit (O(N^2)).
+    void setSpatialIndexing(bool enabled) { unitGrid->setEnabled(enabled); }
+
+    // Set how many threads share the AI pass (zero means one per core).
+    // Scenes start out serial, so that short-lived ones (like the
+    // benchmark's) don't each start a pool's worth of threads; the
+    // application and the headless runner ask for more.
+    void setThreadCount(size_t threads);
+
+    // The dynamics behind the scene (for benchmarking & diagnostics)
+    RigidBodySystemPtr rigidBodySystem() { return system; }
+    FleetControl & fleetControl() { return *fleet; }
+    UnitStateTable & unitStateTable() { return *unitState; }
+    GroundConstraint & groundConstraint() { return *ground; }
+    TerrainPtr terrain() { return field; }
 
 protected:
+    // (Re)build the rigid-body system and the controllers that drive it,
+    // starting the clock at 'startTime', with the units' state kept in
+    // 'table'
+    void initializeDynamics(double startTime, UnitStateTablePtr table);
+
     RigidBodySystemPtr system;
-    SolidObject3DPtr groundPlane;
+    UnitStateTablePtr unitState;
+    SpatialGridPtr unitGrid;
+    WorkerPoolPtr workers;
+    WorkerPoolPtr writer;           // For checkpoints, made when first needed
+    FleetControl * fleet;
+    GroundConstraint * ground;
+    TerrainPtr field;
+    TerrainStreamerPtr streamer;
     LightPtr sunLight;
+    double currentTime;
+
+    // Control changes waiting for the next step, and where they're logged
+    void applyControl(const ControlEvent &e);
+    std::vector<ControlEvent> pendingControls;
+    InputRecorderPtr recorder;
 };
 
 #endif
@@ -11,6 +11,11 @@
  
 // Import class definitions
 #include "BattleUnit.hpp"
+#include "AssetLoader.hpp"
+#include "Log.hpp"
+#include "ModelCache.hpp"
+#include "TextureCache.hpp"
+#include "Trace.hpp"
 using namespace Battlefield;
 
 // Import Inca stuff
@@ -18,9 +23,42 @@ using namespace Battlefield;
 using namespace Inca::IO;
 using namespace Inca::World;
 
+// Import STL & threading stuff
+#include <mutex>
+
 
 // Shortcut for constructing filenames
-#define OBJ(NAME) string("data\\" #NAME)
+#define OBJ(NAME) string("data/" #NAME)
+
+// The model each type of unit is made from
+const string APC_MODEL        = OBJ(cube.obj);
+const string HUMVEE_MODEL     = OBJ(cube.obj);
+const string LIGHT_TANK_MODEL = OBJ(cube.obj);
+const string HEAVY_TANK_MODEL = OBJ(cube.obj);
+
+// The same, in the same order as UnitType
+const string UNIT_MODELS[UNIT_TYPE_COUNT] = {
+    APC_MODEL, HUMVEE_MODEL, LIGHT_TANK_MODEL, HEAVY_TANK_MODEL
+};
+
+// Finer models, drawn when a unit covers at least so much of the picture's
+// height. Each type's list is finest first, and in UnitType order.
+struct DetailLevel {
+    string model;
+    Transform::scalar_t minScreenSize;
+};
+const string HUMVEE_MEDIUM_MODEL = OBJ(HumVMed.obj);
+const string HUMVEE_LOW_MODEL    = OBJ(HumVLow.obj);
+static std::vector<DetailLevel> detailLevels[UNIT_TYPE_COUNT] = {
+    { },
+    { { HUMVEE_MEDIUM_MODEL, 0.12 }, { HUMVEE_LOW_MODEL, 0.04 } },
+    { },
+    { }
+};
+static std::mutex detailLock;
+
+// How far past a threshold a unit must be before it switches models
+const Transform::scalar_t DETAIL_HYSTERESIS = 0.15;
 
 
 // Appearance for units in the simulation
@@ -28,140 +66,198 @@ const Material::Color UNSELECTED_UNIT_EMISSIVITY(0.0f, 0.0f, 0.0f);
 const Material::Color SELECTED_UNIT_EMISSIVITY(0.2f, 0.2f, 0.2f);
 const Material::Color MANUAL_UNIT_EMISSIVITY(0.5f, 0.5f, 0.5f);
 
-// Appearance for goal marker
-const Material::Color GOAL_COLOR(1.0f, 0.0f, 0.0f);
-const Transform::scalar_t GOAL_RADIUS = 1.0;
-const Transform::scalar_t GOAL_RAD_2_2 = GOAL_RADIUS * Transform::sqrt(2.0) / 2.0;
-const Transform::scalar_t GOAL_MAJOR_TICK_2 = 0.75;
-const Transform::scalar_t GOAL_MINOR_TICK_2 = 0.25;
-const Transform::scalar_t GOAL_MINOR_TICK_2_4 = GOAL_MINOR_TICK_2 * Transform::sqrt(2.0) / 2.0;
-const Transform::scalar_t GOAL_ELEVATION = 0.01;
-const Transform::scalar_t GOAL_SCALE = 0.3;
-const Transform::Point GOAL_VERTICES[] = {
-    Transform::Point(GOAL_RADIUS, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
-    Transform::Point(GOAL_RAD_2_2, GOAL_ELEVATION, -GOAL_RAD_2_2) * GOAL_SCALE,
-    Transform::Point(0.0, GOAL_ELEVATION, -GOAL_RADIUS) * GOAL_SCALE,
-    Transform::Point(-GOAL_RAD_2_2, GOAL_ELEVATION, -GOAL_RAD_2_2) * GOAL_SCALE,
-    Transform::Point(-GOAL_RADIUS, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
-    Transform::Point(-GOAL_RAD_2_2, GOAL_ELEVATION, GOAL_RAD_2_2) * GOAL_SCALE,
-    Transform::Point(0.0, GOAL_ELEVATION, GOAL_RADIUS) * GOAL_SCALE,
-    Transform::Point(GOAL_RAD_2_2, GOAL_ELEVATION, GOAL_RAD_2_2) * GOAL_SCALE,
-
-    Transform::Point(GOAL_RADIUS + GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
-    Transform::Point(GOAL_RADIUS - GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
-    Transform::Point(0.0, GOAL_ELEVATION, -GOAL_RADIUS - GOAL_MAJOR_TICK_2) * GOAL_SCALE,
-    Transform::Point(0.0, GOAL_ELEVATION, -GOAL_RADIUS + GOAL_MAJOR_TICK_2) * GOAL_SCALE,
-    Transform::Point(-GOAL_RADIUS - GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
-    Transform::Point(-GOAL_RADIUS + GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
-    Transform::Point(0.0, GOAL_ELEVATION, GOAL_RADIUS + GOAL_MAJOR_TICK_2) * GOAL_SCALE,
-    Transform::Point(0.0, GOAL_ELEVATION, GOAL_RADIUS - GOAL_MAJOR_TICK_2) * GOAL_SCALE,
-
-    Transform::Point(GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     -GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     -GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(-GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     -GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(-GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     -GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(-GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(-GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-    Transform::Point(GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
-                     GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
-};
-const index_t GOAL_VERTEX_COUNT = 24;
-
 
 // Superclass constructor
-BattleUnit::BattleUnit(const string &model) {
-    // Load the model from the file
-    SolidObject3DPtr obj = static_pointer_cast<SolidObject3D>(loadModel(model));
-    addApproximation(obj->approximation(0));
-    for (index_t i = 0; i < obj->materialCount(); i++)
-        addMaterial(obj->material(i));
+BattleUnit::BattleUnit(UnitStateTablePtr table, UnitType type)
+        : isSelected(false), isManual(false), chosenLevel(0), shownLevel(0) {
+    // Get the model (loading it only if this is the first of its type).
+    // The geometry is shared with every other unit of our type, but we need
+    // our own materials, since we change them when we're selected.
+    SolidObject3DPtr obj = ModelCache::instance().model(UNIT_MODELS[type]);
+    for (index_t i = 0; i < obj->materialCount(); i++) {
+        MaterialPtr mat(new Material(*obj->material(i)));
+        TextureCache::instance().bindCopy(mat, obj->material(i));
+        addMaterial(mat);
+    }
+
+    // Start out with our type's finest model
+    details = detailTable(type, obj);
+    addApproximation(details->models[0]);
+
+    // Claim our slot in the state table
+    state.table = table;
+    state.slot = table->allocate(this);
+
+    // Start out looking unselected
+    updateAppearance();
 }
 
-// Change our appearance to reflect our current state
-void BattleUnit::updateTessellation(const Point &view, const Vector &look) {
-    // Do the normal tessellation update
-    SolidObject3D::updateTessellation(view, look);
+// Each type's models, loaded for its first unit (and again for the next
+// one after addDetailLevel())
+BattleUnit::DetailTablePtr BattleUnit::typeDetails[UNIT_TYPE_COUNT];
+
+// Get the table of models for units of 'type', whose own model is 'obj',
+// loading the finer ones if the type's levels have changed since the last
+// unit was built. Those that won't load are dropped, so that the next unit
+// doesn't try again.
+BattleUnit::DetailTablePtr BattleUnit::detailTable(UnitType type, SolidObject3DPtr obj) {
+    std::lock_guard<std::mutex> guard(detailLock);
+    if (typeDetails[type])
+        return typeDetails[type];
+
+    shared_ptr<DetailTable> table(new DetailTable());
+    std::vector<DetailLevel> &levels = detailLevels[type];
+    for (size_t i = 0; i < levels.size(); ) {
+        try {
+            table->models.push_back(ModelCache::instance().model(levels[i].model)->approximation(0));
+            table->minSizes.push_back(levels[i].minScreenSize);
+            i++;
+        } catch (const Inca::IncaException &e) {
+            BATTLEFIELD_LOG(Warning, "Not using detail model " << levels[i].model
+                                     << ": " << e);
+            levels.erase(levels.begin() + i);
+        }
+    }
+    table->models.push_back(obj->approximation(0));
+    table->minSizes.push_back(0.0);
+    typeDetails[type] = table;
+    return typeDetails[type];
+}
+
+// Start loading every unit type's model in the background
+void BattleUnit::requestModels() {
+    AssetLoader &loader = AssetLoader::instance();
+    loader.requestModel(APC_MODEL);
+    loader.requestModel(HUMVEE_MODEL);
+    loader.requestModel(LIGHT_TANK_MODEL);
+    loader.requestModel(HEAVY_TANK_MODEL);
+
+    std::lock_guard<std::mutex> guard(detailLock);
+    for (size_t t = 0; t < UNIT_TYPE_COUNT; t++)
+        for (size_t i = 0; i < detailLevels[t].size(); i++)
+            loader.requestModel(detailLevels[t][i].model);
+}
 
-    // Use emissivity to indicate selectedness
-    if (selected && manualControl) {
-        for (index_t i = 0; i < materialCount(); i++)
-            material(i)->emissivity = MANUAL_UNIT_EMISSIVITY;
-    } else if (selected) {
-        for (index_t i = 0; i < materialCount(); i++)
-            material(i)->emissivity = SELECTED_UNIT_EMISSIVITY;
-    } else {        
-        for (index_t i = 0; i < materialCount(); i++)
-            material(i)->emissivity = UNSELECTED_UNIT_EMISSIVITY;
+void BattleUnit::addDetailLevel(UnitType type, const string &model,
+                                scalar_t minScreenSize) {
+    if (type >= UNIT_TYPE_COUNT)
+        return;
+    std::lock_guard<std::mutex> guard(detailLock);
+    std::vector<DetailLevel> &levels = detailLevels[type];
+    size_t i = 0;
+    while (i < levels.size() && levels[i].minScreenSize > minScreenSize)
+        i++;
+    DetailLevel level = { model, minScreenSize };
+    levels.insert(levels.begin() + i, level);
+    typeDetails[type].reset();
+}
+
+// Unit construction, by type. The table is in the same order as UnitType.
+template <class Unit>
+static BattleUnit * constructUnit(UnitStateTablePtr table) {
+    return new Unit(table);
+}
+typedef BattleUnit * (*UnitConstructor)(UnitStateTablePtr table);
+static const UnitConstructor UNIT_CONSTRUCTORS[UNIT_TYPE_COUNT] = {
+    &constructUnit<APC>, &constructUnit<Humvee>,
+    &constructUnit<LightTank>, &constructUnit<HeavyTank>
+};
+static_assert(unitTypeNamed("heavy tank") == HeavyTankType
+                && unitTypeNamed("tank") == NoUnitType,
+              "Unit type names and UnitType are out of step");
+
+BattleUnitPtr BattleUnit::create(UnitType type, UnitStateTablePtr table) {
+    if (type >= UNIT_TYPE_COUNT)
+        return BattleUnitPtr();
+    return BattleUnitPtr(UNIT_CONSTRUCTORS[type](table));
+}
+
+// Superclass destructor
+BattleUnit::~BattleUnit() {
+    state.table->release(state.slot);
+}
+
+// Selection/manual-control changes
+void BattleUnit::setSelected(bool s) {
+    if (s != isSelected) {
+        isSelected = s;
+        updateAppearance();
     }
+}
 
+void BattleUnit::setManualControl(bool m) {
+    if (m != isManual) {
+        isManual = m;
+        updateAppearance();
+    }
+}
 
-    // Make sure our little target thingy get's cleaned up
-    Tessellation &tess = *tessellation;
-    Tessellation::LineGroup &lineGroup = tess.lineGroup(goalMaterialIndex);
-    lineGroup.clear();
-
-    // Redraw it if we're supposed to
-    if (target != NULL && renderGoal) {
-        const Transform::Quaternion &mRotation = transform->rotation();
-        const Transform::Quaternion &tRotation = target->transform->rotation();
-        Transform::Point goal(mRotation.unrotate(goalDisplacement));
-
-        if (selected)
-            cerr << "Goal is " << goal << endl;
-
-        const Transform::Vector &scale = transform->scale();
-        index_t vtx[GOAL_VERTEX_COUNT + 2];
-        Transform::Point pt;
-        for (index_t i = 0; i < GOAL_VERTEX_COUNT + 2; i++) {
-            // Make the goal gadget rotate with the target
-            pt = tRotation.rotate(mRotation.unrotate(GOAL_VERTICES[i]));
-            for (index_t j = 0; j < 3; j++)
-                pt[j] = (goal[j] + pt[j]) / scale[j];
-            vtx[i] = tess.addVertex(pt);
-        }
+// Use emissivity to indicate selectedness
+void BattleUnit::updateAppearance() {
+    const Material::Color &emissivity = (isSelected && isManual) ? MANUAL_UNIT_EMISSIVITY
+                                      : isSelected               ? SELECTED_UNIT_EMISSIVITY
+                                      :                            UNSELECTED_UNIT_EMISSIVITY;
+    for (index_t i = 0; i < materialCount(); i++)
+        material(i)->emissivity = emissivity;
+}
 
-        vtx[GOAL_VERTEX_COUNT] = tess.addVertex(Transform::Point(0.0));
-        vtx[GOAL_VERTEX_COUNT + 1] = tess.addVertex(Transform::Point(goalDisplacement) * -1.0);
-
-        Tessellation::Line line;
-        // Circle
-        line.v[0] =  vtx[0];  line.v[1] =  vtx[1];  lineGroup.push_back(line);
-        line.v[0] =  vtx[1];  line.v[1] =  vtx[2];  lineGroup.push_back(line);
-        line.v[0] =  vtx[2];  line.v[1] =  vtx[3];  lineGroup.push_back(line);
-        line.v[0] =  vtx[3];  line.v[1] =  vtx[4];  lineGroup.push_back(line);
-        line.v[0] =  vtx[4];  line.v[1] =  vtx[5];  lineGroup.push_back(line);
-        line.v[0] =  vtx[5];  line.v[1] =  vtx[6];  lineGroup.push_back(line);
-        line.v[0] =  vtx[6];  line.v[1] =  vtx[7];  lineGroup.push_back(line);
-        line.v[0] =  vtx[7];  line.v[1] =  vtx[0];  lineGroup.push_back(line);
-
-        // Major ticks
-        line.v[0] =  vtx[8];  line.v[1] =  vtx[9];  lineGroup.push_back(line);
-        line.v[0] = vtx[10];  line.v[1] = vtx[11];  lineGroup.push_back(line);
-        line.v[0] = vtx[12];  line.v[1] = vtx[13];  lineGroup.push_back(line);
-        line.v[0] = vtx[14];  line.v[1] = vtx[15];  lineGroup.push_back(line);
-
-        // Minor ticks
-        line.v[0] = vtx[16];  line.v[1] = vtx[17];  lineGroup.push_back(line);
-        line.v[0] = vtx[18];  line.v[1] = vtx[19];  lineGroup.push_back(line);
-        line.v[0] = vtx[20];  line.v[1] = vtx[21];  lineGroup.push_back(line);
-        line.v[0] = vtx[22];  line.v[1] = vtx[23];  lineGroup.push_back(line);
-
-        // Displacement line
-//        line.v[0] = vtx[24];  line.v[1] = vtx[25];  lineGroup.push_back(line);
+// Pick a model for how big we look, or none if we can't be seen
+void BattleUnit::chooseDetail(const ViewFrustum &view) {
+    const Point &center = *transform->locationPoint();
+    if (! view.intersects(center, boundingRadius)) {
+        chosenLevel = -1;
+        return;
     }
+
+    // Coming into view, we go straight to the right model; otherwise we
+    // have to get well past a threshold before we cross it
+    scalar_t size = view.screenSize(center, boundingRadius);
+    const std::vector<scalar_t> &minSizes = details->minSizes;
+    int last = int(minSizes.size()) - 1;
+    int level = chosenLevel;
+    if (level < 0) {
+        level = 0;
+        while (level < last && size < minSizes[level])
+            level++;
+    } else {
+        while (level > 0 && size >= minSizes[level - 1] * (1.0 + DETAIL_HYSTERESIS))
+            level--;
+        while (level < last && size < minSizes[level] * (1.0 - DETAIL_HYSTERESIS))
+            level++;
+    }
+    chosenLevel = level;
+}
+
+// Change our appearance to reflect our current state
+void BattleUnit::updateTessellation(const Point &view, const Vector &look) {
+    BATTLEFIELD_TRACE_SCOPE("tessellate");
+
+    // Switch models, if chooseDetail() picked a different one
+    if (chosenLevel != shownLevel) {
+        if (shownLevel >= 0)
+            removeApproximation(0);
+        if (chosenLevel >= 0)
+            addApproximation(details->models[chosenLevel]);
+        shownLevel = chosenLevel;
+    }
+
+    // Do the normal tessellation update
+    SolidObject3D::updateTessellation(view, look);
+
+    // Move our goal marker to where we're headed (it's drawn in the target's
+    // orientation), or hide it
+    if (goalMarker == NULL)
+        return;
+    if (showsGoal())
+        goalMarker->place(*transform->locationPoint() + Vector(goalDisplacement),
+                          target->transform->rotation());
+    else
+        goalMarker->hide();
 }
 
 
 // APC specialization
-APC::APC() : BattleUnit(OBJ(cube.obj)) {
+APC::APC(UnitStateTablePtr table) : BattleUnit(table, APCType) {
     mass = 300.0;
     maxEngineForce = 200.0;
     minTurningRadius = 1.0;
@@ -169,22 +265,16 @@ APC::APC() : BattleUnit(OBJ(cube.obj)) {
 
     Transform::Vector scale(0.15, 0.15, 0.2);
     elevationOffset = scale[1]; 
+    boundingRadius = magnitude(scale);
     transform->scale(scale);
 
     addMaterial(MaterialPtr(new Material()));
     material(0)->diffuse = Material::Color(0.1f, 0.4f, 1.0f);
-
-    // Tack on our material for drawing targets
-    MaterialPtr goalMat(new Material());
-    goalMat->illuminated = false;
-    goalMat->diffuse = GOAL_COLOR;
-    goalMaterialIndex = materialCount();
-    addMaterial(goalMat);
 }
 
 
 // Humvee specialization
-Humvee::Humvee() : BattleUnit(OBJ(cube.obj)) {
+Humvee::Humvee(UnitStateTablePtr table) : BattleUnit(table, HumveeType) {
 #if 0
     mass = 500.0;
     maxEngineForce = 500.0;
@@ -202,44 +292,32 @@ Humvee::Humvee() : BattleUnit(OBJ(cube.obj)) {
     Transform::Vector scale(0.15, 0.05, 0.25);
 #endif
     elevationOffset = scale[1]; 
+    boundingRadius = magnitude(scale);
     transform->scale(scale);
 
     addMaterial(MaterialPtr(new Material()));
     material(0)->diffuse = Material::Color(0.6f, 0.6f, 0.0f);
-
-    // Tack on our material for drawing targets
-    MaterialPtr goalMat(new Material());
-    goalMat->illuminated = false;
-    goalMat->diffuse = GOAL_COLOR;
-    goalMaterialIndex = materialCount();
-    addMaterial(goalMat);
 }
 
 
 // LightTank specialization
-LightTank::LightTank() : BattleUnit(OBJ(cube.obj)) {
+LightTank::LightTank(UnitStateTablePtr table) : BattleUnit(table, LightTankType) {
     mass = 300.0;
     maxEngineForce = 500.0;
     minTurningRadius = 1.0;
 
     Transform::Vector scale(0.2, 0.1, 0.3);
     elevationOffset = scale[1]; 
+    boundingRadius = magnitude(scale);
     transform->scale(scale);
 
     addMaterial(MaterialPtr(new Material()));
     material(0)->diffuse = Material::Color(0.8f, 0.0f, 0.0f);
-
-    // Tack on our material for drawing targets
-    MaterialPtr goalMat(new Material());
-    goalMat->illuminated = false;
-    goalMat->diffuse = GOAL_COLOR;
-    goalMaterialIndex = materialCount();
-    addMaterial(goalMat);
 }
 
 
 // HeavyTank specialization
-HeavyTank::HeavyTank() : BattleUnit(OBJ(cube.obj)) {
+HeavyTank::HeavyTank(UnitStateTablePtr table) : BattleUnit(table, HeavyTankType) {
     mass = 500.0;
     maxEngineForce = 500.0;
     minTurningRadius = 0.5;
@@ -248,15 +326,9 @@ HeavyTank::HeavyTank() : BattleUnit(OBJ(cube.obj)) {
 
     Transform::Vector scale(0.25, 0.2, 0.3);
     elevationOffset = scale[1]; 
+    boundingRadius = magnitude(scale);
     transform->scale(scale);
 
     addMaterial(MaterialPtr(new Material()));
     material(0)->diffuse = Material::Color(0.0f, 0.8f, 0.0f);
-
-    // Tack on our material for drawing targets
-    MaterialPtr goalMat(new Material());
-    goalMat->illuminated = false;
-    goalMat->diffuse = GOAL_COLOR;
-    goalMaterialIndex = materialCount();
-    addMaterial(goalMat);
 }
@@ -8,6 +8,17 @@
  * Description:
  *      The BattleUnit class is the superclass for all autonomous units in the
  *      battle simulation.
+ *
+ *      A unit can be drawn with any of several models, depending on how big
+ *      it looks: its type's own model, plus whatever finer ones have been
+ *      registered for the type with addDetailLevel(). (These must be built
+ *      to fit the same -1..1 box as the type's own model, since the unit's
+ *      scale is applied to all of them, and are drawn with the unit's
+ *      materials.) Once a frame, the scene tells each unit what the camera
+ *      can see, and the unit picks the finest model whose size threshold it
+ *      clears -- with some slack either way, so that units near a threshold
+ *      don't keep popping between models -- or none, if its bounding sphere
+ *      is out of the picture.
  */
 
 #ifndef BATTLEFIELD_BATTLE_UNIT
@@ -16,6 +27,14 @@
 // Import system configuration and Inca libraries
 #include "battlefield-common.h"
 
+// Import the table that holds units' per-step state
+#include "UnitStateTable.hpp"
+#include "GoalMarker.hpp"
+#include "ViewFrustum.hpp"
+
+// Import STL
+#include <vector>
+
 // This is part of the Battlefield simulation
 namespace Battlefield {
     // Forward declarations
@@ -25,7 +44,8 @@ namespace Battlefield {
     class LightTank;
     class HeavyTank;
 
-    // Enumeration of the possible states a BattleUnit can assume
+    // Enumeration of the possible states a BattleUnit can assume. These are
+    // saved in checkpoints, too, so the order mustn't change.
     enum BattleAction {
         Searching,      // Looking for a target
         Attacking,      // Engaged in battle with a target
@@ -34,8 +54,39 @@ namespace Battlefield {
         Evading,        // Atttempting to dodge an attack
         Uncontrolled,   // At the mercy of other forces (e.g., hit by missile)
         Destroyed,      // Shall we say, "out of the picture"
+        BATTLE_ACTION_COUNT
     };
 
+    // Enumeration of the kinds of units there are. These are also how unit
+    // types are identified in checkpoints, so the order mustn't change.
+    enum UnitType {
+        APCType,
+        HumveeType,
+        LightTankType,
+        HeavyTankType,
+        UNIT_TYPE_COUNT,
+        NoUnitType = UNIT_TYPE_COUNT
+    };
+
+    // What each type is called (e.g., in scenario files)
+    constexpr const char * UNIT_TYPE_NAMES[UNIT_TYPE_COUNT] = {
+        "APC", "humvee", "light tank", "heavy tank"
+    };
+
+    // Look a unit type up by name (NoUnitType if there's no such thing).
+    // This works at compile time, too.
+    constexpr bool sameUnitTypeName(const char *a, const char *b) {
+        return *a == *b && (*a == '\0' || sameUnitTypeName(a + 1, b + 1));
+    }
+    constexpr UnitType unitTypeNamed(const char *name, int i = 0) {
+        return i == UNIT_TYPE_COUNT                         ? NoUnitType
+             : sameUnitTypeName(UNIT_TYPE_NAMES[i], name)   ? UnitType(i)
+             : unitTypeNamed(name, i + 1);
+    }
+    inline UnitType unitTypeNamed(const string &name) {
+        return unitTypeNamed(name.c_str());
+    }
+
     // Pointer type definitions
     typedef shared_ptr<BattleUnit> BattleUnitPtr;
 };
@@ -43,28 +94,87 @@ namespace Battlefield {
 
 class Battlefield::BattleUnit : public Inca::World::SolidObject3D {
 protected:
-    // Constructor, giving model to load
-    BattleUnit(const string &model);
+    // Constructor, giving the table to keep our state in and what type we
+    // are (which says what models to load)
+    BattleUnit(UnitStateTablePtr table, UnitType type);
+
+    // Not copyable (a copy would share our slot in the state table, and its
+    // fields would still point at ours)
+    BattleUnit(const BattleUnit &) = delete;
+    BattleUnit & operator=(const BattleUnit &) = delete;
 
 public:
-    // Ccontrol/display properties
-    property_rw(bool, selected, false);             // Has the user selected this unit?
-    property_rw(bool, manualControl, false);        // Has the user taken over control?
+    // Destructor (gives back our slot in the state table)
+    ~BattleUnit();
+
+    // Start loading the models for all the unit types, so that they're
+    // (hopefully) ready by the time anybody builds a unit
+    static void requestModels();
+
+    // Build a unit of the given type, keeping its state in 'table'. Throws
+    // whatever the model loading throws.
+    static BattleUnitPtr create(UnitType type, UnitStateTablePtr table);
+
+    // Have units of 'type' built from now on drawn with 'model' when they
+    // cover at least 'minScreenSize' of the picture's height (and nothing
+    // finer fits). Models that can't be loaded are logged and forgotten.
+    // Units already built keep the models they had.
+    static void addDetailLevel(UnitType type, const string &model,
+                               scalar_t minScreenSize);
+
+    // What kind of unit this is
+    virtual UnitType unitType() const = 0;
+
+    // Where our per-step state lives. The control, physical and goal
+    // properties below are views onto this slot of the table.
+    const UnitStateTablePtr & stateTable() const { return state.table; }
+    index_t stateSlot() const { return state.slot; }
+
+protected:
+    UnitStateSlot state;
+    typedef UnitStateTable Table;
+
+    // Make our materials reflect our selected/manual state
+    void updateAppearance();
+    bool isSelected, isManual;
+
+    // The models a type's units can be drawn with, finest first, and the
+    // smallest each one is used at. The last is the type's own model, used
+    // at any size. One table is shared by all the units of a type built
+    // since its levels last changed, so a unit just holds a pointer to it.
+    struct DetailTable {
+        std::vector<SolidObject3D::LinearApproximationPtr> models;
+        std::vector<scalar_t> minSizes;
+    };
+    typedef shared_ptr<const DetailTable> DetailTablePtr;
+    static DetailTablePtr detailTable(UnitType type, SolidObject3DPtr obj);
+    static DetailTablePtr typeDetails[UNIT_TYPE_COUNT];     // Built as needed
+    DetailTablePtr details;
+    int chosenLevel, shownLevel;        // -1 for none
+
+public:
+    // Control/display properties. Selection and manual control show up in
+    // how we're drawn, so changing them updates our materials right then
+    // (and only then).
+    bool selected() const { return isSelected; }            // Has the user selected this unit?
+    bool manualControl() const { return isManual; }         // Has the user taken over control?
+    void setSelected(bool s);
+    void setManualControl(bool m);
     property_rw(bool, renderGoal, false);           // Should we draw my goal?
-    property_rw(scalar_t, throttle, 0.0);
-    property_rw(scalar_t, brake, 0.0);
-    property_rw(scalar_t, wheelDeflection, 0.0);
+    UnitStateField<scalar_t, &Table::throttle> throttle{state};
+    UnitStateField<scalar_t, &Table::brake> brake{state};
+    UnitStateField<scalar_t, &Table::wheelDeflection> wheelDeflection{state};
 
     // Physical properties
-    property_rw(scalar_t, mass, 100.0);             // Duh! The mass of the unit
-    property_rw(scalar_t, elevationOffset, 0.0);    // Height of center off ground
-    property_rw(scalar_t, axleOffset, 0.5);         // How far from CoM is turning axle
-    property_rw(scalar_t, maxEngineForce, 10.0);
-    property_rw(scalar_t, minTurningRadius, 1.0);
-    property_rw(scalar_t, minLinearFriction, 0.1);  // Friction coefficients
-    property_rw(scalar_t, minAngularFriction, 0.1); // with no brakes applied
-    property_rw(scalar_t, maxLinearFriction, 0.3);  // Friction coefficients
-    property_rw(scalar_t, maxAngularFriction, 0.5); // with full braking
+    UnitStateField<scalar_t, &Table::mass> mass{state};                         // Duh! The mass of the unit
+    UnitStateField<scalar_t, &Table::elevationOffset> elevationOffset{state};   // Height of center off ground
+    UnitStateField<scalar_t, &Table::axleOffset> axleOffset{state};             // How far from CoM is turning axle
+    UnitStateField<scalar_t, &Table::maxEngineForce> maxEngineForce{state};
+    UnitStateField<scalar_t, &Table::minTurningRadius> minTurningRadius{state};
+    UnitStateField<scalar_t, &Table::minLinearFriction> minLinearFriction{state};   // Friction coefficients
+    UnitStateField<scalar_t, &Table::minAngularFriction> minAngularFriction{state}; // with no brakes applied
+    UnitStateField<scalar_t, &Table::maxLinearFriction> maxLinearFriction{state};   // Friction coefficients
+    UnitStateField<scalar_t, &Table::maxAngularFriction> maxAngularFriction{state}; // with full braking
     property_rw_ptr(RigidBody, rigidBody, NULL);
 
     // Combat properties
@@ -81,39 +191,52 @@ public:
     property_rw(bool, relativeOffset, false);
 
     // Goal-reaching (relative) temporary values
-    property_rw(Vector, goalDisplacement, Vector(0.0));
-    property_rw(Vector, goalVelocity, Vector(0.0));
+    UnitStateField<Vector, &Table::goalDisplacement> goalDisplacement{state};
+    UnitStateField<Vector, &Table::goalVelocity> goalVelocity{state};
+
+    // Pick which of my models to draw (or none, if I'm out of sight) for
+    // what 'view' can see. The switch happens in updateTessellation().
+    void chooseDetail(const ViewFrustum &view);
+    int detailLevel() const { return chosenLevel; }
+    size_t detailLevelCount() const { return details->models.size(); }
+    property_rw(scalar_t, boundingRadius, 1.0);     // Around my center
 
     // Update my appearance to reflect my state
     void updateTessellation(const Point &view, const Vector &look);
 
-protected:
-    // What material index to use for drawing goal targets
-    index_t goalMaterialIndex;
+    // The marker showing where I'm headed. Most units never show one, so
+    // the scene only makes it (and draws it alongside me) the first time
+    // showsGoal() is true; I just move it around.
+    bool showsGoal() const { return target != NULL && renderGoal; }
+    property_rw_ptr(GoalMarker, goalMarker, NULL);
 };
 
 
 class Battlefield::APC : public BattleUnit {
 public:
-    APC();
+    APC(UnitStateTablePtr table);
+    UnitType unitType() const { return APCType; }
 };
 
 
 class Battlefield::Humvee : public BattleUnit {
 public:
-    Humvee();
+    Humvee(UnitStateTablePtr table);
+    UnitType unitType() const { return HumveeType; }
 };
 
 
 class Battlefield::LightTank : public BattleUnit {
 public:
-    LightTank();
+    LightTank(UnitStateTablePtr table);
+    UnitType unitType() const { return LightTankType; }
 };
 
 
 class Battlefield::HeavyTank : public BattleUnit {
 public:
-    HeavyTank();
+    HeavyTank(UnitStateTablePtr table);
+    UnitType unitType() const { return HeavyTankType; }
 };
 
 #endif
\ No newline at end of file
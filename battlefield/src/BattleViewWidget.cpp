@@ -14,13 +14,28 @@
 
 // Import application definition
 #include "BattlefieldApplication.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "TextureCache.hpp"
+#include "Trace.hpp"
 using namespace Battlefield;
 
+// Where the metrics & trace go
+const string METRICS_FILENAME = "metrics.csv";
+const string TRACE_FILENAME = "trace.json";
+const string CHECKPOINT_FILENAME = "battlefield.checkpoint";
+const int METRICS_LINE_HEIGHT = 14;
+
 // How much we move the camera by
 const Transform::scalar_t CAMERA_PHI_INCREMENT = Transform::PI / 20.0;
 const Transform::scalar_t MIN_CAMERA_PHI = Transform::PI / 6.0;
 const Transform::scalar_t MAX_CAMERA_PHI = Transform::PI / 2.0;
 
+// The vertical field of view we take the camera to have, for deciding what
+// units are in the picture. Erring on the wide side only costs drawing a
+// few units just off the edge.
+const Transform::scalar_t CAMERA_FIELD_OF_VIEW = Transform::PI / 3.0;
+
 // Import OpenGL
 #if __MS_WINDOZE__
     // Windows OpenGL seems to need this
@@ -28,11 +43,18 @@ const Transform::scalar_t MAX_CAMERA_PHI = Transform::PI / 2.0;
 #endif
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <GL/glut.h>
+
+// Old Windows headers stop at OpenGL 1.1
+#ifndef GL_BGRA
+#   define GL_BGRA 0x80E1
+#endif
 
 BattleViewWidget::BattleViewWidget(BattleScenePtr bs, BattleCameraPtr bc)
         : SceneView(ScenePtr(), static_pointer_cast<Camera>(bc)),
           CameraControl(static_pointer_cast<Camera>(bc)),
-          frameCapture(false), frameCount(0), selectedUnit(0) {
+          showMetrics(false), width(0), height(0), selectedUnit(0),
+          capturing(false), captureRate(0) {
     setBattleScene(bs);
     battleCamera = bc;
 }
@@ -54,30 +76,89 @@ void BattleViewWidget::initializeView() {
 }
 
 void BattleViewWidget::renderView() {
-    SceneView::renderView();
-
-    if (frameCapture) {
-#if 1
-        char filename[30];
-        sprintf(filename, "%s%03d%s", framePrefix.c_str(), frameCount, frameSuffix.c_str());
-        cerr << "Writing image " << filename << endl;
-        if (frameCount == 0) {
-            ImagePtr img(new ImageRGB(width, height));
-            glReadPixels(0, 0, width, height, GL_RGB, GL_BYTE, img->pixels().getContents());
-            Inca::IO::storeImage(img, filename);
+    // Give any new materials their textures before they're drawn
+    TextureCache::instance().resolve();
+
+    // Decide which units are worth drawing, and in how much detail
+    ViewFrustum view;
+    if (height != 0) {
+        const Transform::Point &eye = *battleCamera->transform->locationPoint();
+        view.aim(eye, Transform::Point(battleCamera->lookAt) - eye,
+                 CAMERA_FIELD_OF_VIEW, Transform::scalar_t(width) / height);
+    }
+    battleScene()->updateView(view);
+    {
+        BATTLEFIELD_TIME_SCOPE("render");
+        BATTLEFIELD_TRACE_SCOPE("render");
+        SceneView::renderView();
+    }
+
+    // Read the frame back as BGRA (which most drivers can do without
+    // converting) and let the encoder threads do the rest
+    if (capturing) {
+        BATTLEFIELD_TRACE_SCOPE("frame readback");
+        FrameCapture::Frame *frame = capture->acquire(width, height);
+        if (frame != NULL) {
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE,
+                         &frame->pixels[0]);
+            capture->submit(frame);
         }
-        frameCount++;
-#endif
     }
+
+    // The HUD goes on after the capture, so it's not in the recording
+    if (showMetrics)
+        renderMetrics();
+
+    // That's a frame (however many simulation steps went into it)
+    Metrics::instance().endFrame();
+}
+
+void BattleViewWidget::renderMetrics() {
+    std::vector<string> lines = Metrics::instance().report();
+
+    // Switch to pixel coordinates, with nothing fancy turned on
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0.0, width, 0.0, height);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glColor3f(1.0f, 1.0f, 0.0f);
+    for (size_t i = 0; i < lines.size(); i++) {
+        glRasterPos2i(8, int(height) - int(i + 1) * METRICS_LINE_HEIGHT);
+        for (size_t c = 0; c < lines[i].size(); c++)
+            glutBitmapCharacter(GLUT_BITMAP_8_BY_13, lines[i][c]);
+    }
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
 }
 
 // Event-handler functions
 void BattleViewWidget::keyPressed(KeyCode key,
                                   unsigned int x, unsigned int y) {
     switch (key) {
-        case KEY_ESCAPE:    application->exit(0, "Exited normally");
+        case KEY_ESCAPE:
+            capture.reset();    // Finish writing whatever we've captured
+            battleScene()->setRecorder(InputRecorderPtr());
+            application->exit(0, "Exited normally");
         case KEY_P:         togglePaused();                 break;
         case KEY_SPACE:     toggleFullScreen();             break;
+        case KEY_C:         toggleFrameCapture();           break;
+        case KEY_H:         toggleMetricsDisplay();         break;
+        case KEY_M:         writeMetrics();                 break;
+        case KEY_T:         toggleTracing();                break;
+        case KEY_K:         writeCheckpoint();              break;
 
         case KEY_TILDE:     toggleGoalMarkers();            break;
         case KEY_ENTER:     toggleManualControl();          break;
@@ -111,7 +192,70 @@ void BattleViewWidget::toggleFullScreen() {
 }
 
 void BattleViewWidget::toggleFrameCapture() {
-    frameCapture = !frameCapture;
+    if (capturing) {
+        capturing = false;
+        capture->flush();   // Waits for the last frames to be written
+        BATTLEFIELD_LOG(Info, "Captured " << capture->capturedCount() << " frames ("
+                              << capture->droppedCount() << " dropped, "
+                              << capture->stalledCount() << " stalled for "
+                              << capture->stalledSeconds() << " s)");
+        return;
+    }
+
+    // The first time, set up where the frames are going. After that, we
+    // just pick up where we left off (in the same stream, or with the next
+    // frame number).
+    if (! capture) {
+        FrameSinkPtr sink;
+        if (captureStream.empty()) {
+            sink.reset(new ImageSequenceSink(framePrefix, frameSuffix));
+        } else {
+            VideoStreamSinkPtr stream(new VideoStreamSink(captureStream,
+                    VideoStreamSink::formatFor(captureStream), captureRate));
+            if (! stream->isOpen())
+                return;
+            sink = stream;
+        }
+
+        // A stream is cheap to write, so we may as well keep every frame.
+        // Image files aren't, so drop frames rather than slow things down.
+        capture.reset(new FrameCapture(sink, captureStream.empty()
+                                                ? FrameCapture::DropFrames
+                                                : FrameCapture::Backpressure));
+    }
+    capturing = true;
+}
+
+void BattleViewWidget::toggleMetricsDisplay() {
+    showMetrics = ! showMetrics;
+    requestRedisplay();
+}
+
+void BattleViewWidget::writeMetrics() {
+    if (Metrics::instance().writeCSV(METRICS_FILENAME))
+        BATTLEFIELD_LOG(Info, "Wrote metrics to " << METRICS_FILENAME);
+    else
+        BATTLEFIELD_LOG(Error, "Couldn't write metrics to " << METRICS_FILENAME);
+}
+
+void BattleViewWidget::toggleTracing() {
+    if (! Tracer::isActive()) {
+        Tracer::nameThread("main");
+        Tracer::start();
+        BATTLEFIELD_LOG(Info, "Tracing started");
+        return;
+    }
+
+    Tracer::stop();
+    if (Tracer::write(TRACE_FILENAME))
+        BATTLEFIELD_LOG(Info, "Wrote trace to " << TRACE_FILENAME);
+    else
+        BATTLEFIELD_LOG(Error, "Couldn't write trace to " << TRACE_FILENAME);
+}
+
+// The scene logs how that went, once the file's written
+void BattleViewWidget::writeCheckpoint() {
+    battleScene()->checkpoint(CHECKPOINT_FILENAME);
 }
 
 void BattleViewWidget::setFilenamePattern(const string &pre, const string &suff) {
@@ -119,6 +263,11 @@ void BattleViewWidget::setFilenamePattern(const string &pre, const string &suff)
     frameSuffix = suff;
 }
 
+void BattleViewWidget::setCaptureStream(const string &target, unsigned int fps) {
+    captureStream = target;
+    captureRate = fps;
+}
+
 void BattleViewWidget::elevateCamera(int clicks) {
     Transform::scalar_t newPhi = battleCamera->targetPhi + clicks * CAMERA_PHI_INCREMENT;
 
@@ -149,15 +298,19 @@ void BattleViewWidget::orbitCamera(int slot) {
         battleCamera->targetTheta = newTheta;
 }
 
+// Unit selection & control. None of these change the units directly: they
+// queue up control changes for the scene to apply (and record) at the
+// start of the next step.
 void BattleViewWidget::selectUnit(index_t unit) {
     if (unit < battleScene()->battleUnitCount()) {
-        battleScene()->battleUnit(selectedUnit)->selected = false;
-        battleScene()->battleUnit(selectedUnit)->manualControl = false;
-        battleScene()->battleUnit(selectedUnit)->renderGoal = false;
+        BattleScenePtr scene = battleScene();
+        scene->queueControl(ControlEvent(selectedUnit, SelectControl, 0.0));
+        scene->queueControl(ControlEvent(selectedUnit, ManualControl, 0.0));
+        scene->battleUnit(selectedUnit)->renderGoal = false;
         selectedUnit = unit;
-        battleScene()->battleUnit(selectedUnit)->selected = true;
-        battleScene()->battleUnit(selectedUnit)->renderGoal = true;
-        cerr << "Selected unit " << selectedUnit << '\n';
+        scene->queueControl(ControlEvent(selectedUnit, SelectControl, 1.0));
+        scene->battleUnit(selectedUnit)->renderGoal = true;
+        BATTLEFIELD_LOG(Info, "Selected unit " << selectedUnit);
     }
     requestRedisplay();
 }
@@ -183,7 +336,8 @@ void BattleViewWidget::toggleManualControl() {
     size_t count = battleScene()->battleUnitCount();
     if (count > 0) {
         BattleUnitPtr bu = battleScene()->battleUnit(selectedUnit);
-        bu->manualControl = !bu->manualControl;
+        battleScene()->queueControl(ControlEvent(selectedUnit, ManualControl,
+                                                 bu->manualControl() ? 0.0 : 1.0));
     }
     requestRedisplay();
 }
@@ -192,11 +346,11 @@ void BattleViewWidget::accelerateSelectedUnit() {
     size_t count = battleScene()->battleUnitCount();
     if (count > 0) {
         BattleUnitPtr bu = battleScene()->battleUnit(selectedUnit);
-        if (bu->manualControl) {
+        if (bu->manualControl()) {
             if (bu->brake != 0.0)
-                bu->brake = 0.0;
+                battleScene()->queueControl(ControlEvent(selectedUnit, BrakeControl, 0.0));
             else
-                bu->throttle = 1.0;
+                battleScene()->queueControl(ControlEvent(selectedUnit, ThrottleControl, 1.0));
         }
     }
 }
@@ -205,11 +359,11 @@ void BattleViewWidget::brakeSelectedUnit() {
     size_t count = battleScene()->battleUnitCount();
     if (count > 0) {
         BattleUnitPtr bu = battleScene()->battleUnit(selectedUnit);
-        if (bu->manualControl) {
+        if (bu->manualControl()) {
             if (bu->throttle != 0.0)
-                bu->throttle = 0.0;
+                battleScene()->queueControl(ControlEvent(selectedUnit, ThrottleControl, 0.0));
             else
-                bu->brake = 1.0;
+                battleScene()->queueControl(ControlEvent(selectedUnit, BrakeControl, 1.0));
         }
     }
 }
@@ -218,11 +372,11 @@ void BattleViewWidget::turnSelectedUnit(scalar_t rate) {
     size_t count = battleScene()->battleUnitCount();
     if (count > 0) {
         BattleUnitPtr bu = battleScene()->battleUnit(selectedUnit);
-        if (bu->manualControl) {
+        if (bu->manualControl()) {
             Transform::scalar_t wd = bu->wheelDeflection + rate;
             if (wd > 1.0)          wd = 1.0;
             else if (wd < -1.0)    wd = -1.0;
-            bu->wheelDeflection = wd;
+            battleScene()->queueControl(ControlEvent(selectedUnit, WheelControl, wd));
         }
     }
 }
@@ -29,6 +29,7 @@ namespace Battlefield {
 // Import other battle type definitions
 #include "BattleScene.hpp"
 #include "BattleCamera.hpp"
+#include "FrameCapture.hpp"
 
 
 class Battlefield::BattleViewWidget : public Widget,
@@ -54,6 +55,11 @@ public:
     void toggleFullScreen();
     void toggleFrameCapture();
     void setFilenamePattern(const string &pre, const string &suff);
+    void setCaptureStream(const string &target, unsigned int fps);
+    void toggleMetricsDisplay();
+    void toggleTracing();
+    void writeMetrics();
+    void writeCheckpoint();
 
     // View-related controls
     void elevateCamera(int clicks);
@@ -71,12 +77,21 @@ public:
     void turnSelectedUnit(scalar_t deflection);
 
 protected:
+    // Draw the metrics table over the scene
+    void renderMetrics();
+
     BattleCameraPtr battleCamera;
+    bool showMetrics;
     unsigned int width, height;
-    bool frameCapture;
-    index_t frameCount;
     index_t selectedUnit;
+
+    // Frame capture, once it's been turned on. Frames go to the stream, if
+    // there is one, or else to a series of files.
+    FrameCapturePtr capture;
+    bool capturing;
     string framePrefix, frameSuffix;
+    string captureStream;
+    unsigned int captureRate;
 };
 
 #endif
@@ -10,8 +10,15 @@
 
 // Import class definition
 #include "BattlefieldApplication.hpp"
+#include "Log.hpp"
+#include "ScenarioLoader.hpp"
+#include "TextureCache.hpp"
+#include "Trace.hpp"
 using namespace Battlefield;
 
+// Import STL
+#include <algorithm>
+
 // Camera parameters
 const Transform::scalar_t CAMERA_INITIAL_RHO   = 1.0;
 const Transform::scalar_t CAMERA_INITIAL_THETA = Transform::PI;
@@ -30,10 +37,14 @@ const double TIME_SCALE = 1.0;
 const double TIME_STEP  = 0.05;
 const bool   ALLOW_SKIP = false;
 
-// Battle setup parameters
-const Transform::Vector ROW_OFFSET(0.5, 0.0, 0.0);
-const Transform::Vector ECHELON_OFFSET(0.2, 0.0, 0.4);
-const Transform::Vector DIAMOND_OFFSET(0.4, 0.0, 0.5);
+// Checkpoint to pick up from, instead of starting a new battle (if any)
+const string RESTORE_CHECKPOINT = "";
+
+// Scenario to set the battle up from (if empty, the standard battle)
+const string SCENARIO_FILE = "";
+
+// Greyscale image to shape the ground like (if empty, it's flat)
+const string TERRAIN_IMAGE = "";
 
 
 // Singleton pointer instantiation
@@ -41,15 +52,21 @@ BattlefieldApplication * BattlefieldApplication::baInstance;
 
 
 void BattlefieldApplication::setup(int &argc,  char **argv) {
+    // We draw things, so textures bound from now on are wanted
+    TextureCache::instance().setRendering(true);
+
+    // Get the assets loading while we set up everything else
+    BattleScene::requestAssets();
+
+    initializeBattleScene();
     initializeTimer();
     initializeCamera();
-    initializeBattleScene();
 
     battleViewWidget = BattleViewWidgetPtr(new BattleViewWidget(battleScene,
                                                                 battleCamera));
 
     // Make sure the simulation/camera start with valid values
-    update(0.0);
+    update(battleScene->simulationTime());
 }
 
 void BattlefieldApplication::initializeCamera() {
@@ -66,7 +83,8 @@ void BattlefieldApplication::initializeCamera() {
 
 void BattlefieldApplication::initializeTimer() {
     timer().setTimeScale(TIME_SCALE);
-    timer().setMinimumTime(START_TIME);
+    // A restored battle picks up the clock from where it left off
+    timer().setMinimumTime(std::max(START_TIME, battleScene->simulationTime()));
     timer().setMaximumTime(END_TIME);
     timer().setPulseInterval(TIME_STEP);
     timer().setMaySkipPulses(ALLOW_SKIP);
@@ -75,33 +93,46 @@ void BattlefieldApplication::initializeTimer() {
 }
 
 void BattlefieldApplication::initializeBattleScene() {
-    battleScene = BattleScenePtr(new BattleScene());
-    BattleUnitPtr lt = battleScene->addBattleUnit("light tank");
-    BattleUnitPtr ht = battleScene->addBattleUnit("heavy tank");
-    BattleUnitPtr hv = battleScene->addBattleUnit("humvee");
-    BattleUnitPtr pc = battleScene->addBattleUnit("APC");
-    
-    pc->transform->translate(Transform::Vector(0.0, 0.0, 3.0));
-    hv->transform->translate(Transform::Vector(0.0, 0.0, -3.0));
-    hv->transform->rotateY(-Transform::PI);
-    lt->transform->translate(Transform::Vector(3.0, 0.0, 0.0));
-    lt->transform->rotateY(Transform::PI / 2.0);
-    ht->transform->translate(Transform::Vector(-3.0, 0.0, 0.0));
-    ht->transform->rotateY(-Transform::PI / 2.0);
+    battleScene = BattleScenePtr(new BattleScene(TERRAIN_IMAGE));
+    battleScene->setThreadCount(0);     // Share the AI & view passes across every core
+    if (! RESTORE_CHECKPOINT.empty() && battleScene->restore(RESTORE_CHECKPOINT))
+        return;
+    if (SCENARIO_FILE.empty())
+        battleScene->createTeam();
+    else
+        ScenarioLoader(battleScene).load(SCENARIO_FILE);
+}
 
-    battleScene->createRow(hv, "light tank", ROW_OFFSET, 4);
-    battleScene->createRow(ht, "humvee", ECHELON_OFFSET, 4);
-    battleScene->createDiamond(lt, "APC", DIAMOND_OFFSET);
-    battleScene->createTriangle(pc, "heavy tank", DIAMOND_OFFSET);
+bool BattlefieldApplication::startRecording(const string &filename) {
+    if (! RESTORE_CHECKPOINT.empty() || ! SCENARIO_FILE.empty()) {
+        BATTLEFIELD_LOG(Error, "Not recording " << filename << ": input logs start "
+                               "from a generated battle, not a checkpoint or scenario");
+        return false;
+    }
+    InputRecorderPtr recorder(new InputRecorder(filename));
+    if (! recorder->isOpen()) {
+        BATTLEFIELD_LOG(Error, "Couldn't write " << filename);
+        return false;
+    }
+    if (! TERRAIN_IMAGE.empty())
+        BATTLEFIELD_LOG(Warning, "Recording " << filename << " on " << TERRAIN_IMAGE
+                                 << ", which its replay must be given too");
+    battleScene->setRecorder(recorder);
+    return true;
 }
 
 void BattlefieldApplication::update(double time) {
+    BATTLEFIELD_TRACE_SCOPE("application update");
+
     // Advance the simulation
     battleScene->update(time);
 
     // Move the camera (if necessary)
     battleCamera->update(time);
 
+    // Bring in the ground it can see
+    battleScene->updateTerrain(battleCamera->lookAt, battleCamera->rho);
+
     // Redisplay the view
     battleViewWidget->requestRedisplay();
 }
\ No newline at end of file
@@ -52,6 +52,11 @@ public:
     void initializeTimer();
     void initializeBattleScene();
 
+    // Log the battle's inputs to 'filename', for replaying headlessly.
+    // Replays start from a generated battle, so this refuses (and logs why)
+    // if ours was restored or loaded from a scenario.
+    bool startRecording(const string &filename);
+
     // System-update function (should be called repeatedly from timer)
     void timerPulsed(double time) { update(time); }
     void update(double time);
@@ -0,0 +1,645 @@
+/*
+ * File: BattlefieldBenchmark.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file contains the main() function for the battlefield
+ *      benchmark suite, which times the simulation (without any GUI) and
+ *      the individual pieces of it:
+ *
+ *          update/...      whole BattleScene::update() steps
+ *          fleet/...       FleetControl's third & second derivative passes
+ *          ground/zeroth   GroundConstraint's zeroth derivative pass
+ *          ground/flat-clamp
+ *                          the fixed-elevation clamp it replaced, as a
+ *                          baseline for what the terrain query costs
+ *          ground/terrain  the same, on a heightfield instead of flat ground
+ *          formation/...   createRow(), createDiamond() & createTriangle()
+ *          spawn/...       spawnUnits() making a big batch of each unit type
+ *          model/...       constructing each unit type, with & without
+ *                          its model already in the ModelCache
+ *          drive/...       each drive kernel this machine can run
+ *          terrain/...     each terrain query kernel this machine can run
+ *          view/...        picking units' models for the default camera, and
+ *                          how many of them end up being drawn
+ *
+ *      Results are printed as a table, or written as JSON with --json FILE
+ *      (use '-' for stdout) so that they can be compared between releases.
+ */
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the Battlefield class definitions
+#include "BattleScene.hpp"
+#include "DriveKernel.hpp"
+#include "FleetControl.hpp"
+#include "GroundConstraint.hpp"
+#include "ModelCache.hpp"
+#include "Terrain.hpp"
+#include "UnitStateTable.hpp"
+#include "ViewFrustum.hpp"
+using namespace Battlefield;
+
+// Import STL & timing stuff
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+typedef std::chrono::steady_clock Clock;
+
+// Benchmark parameters
+const size_t UPDATE_SIZES[]    = { 100, 1000, 10000 };
+const size_t PASS_SIZES[]      = { 1000, 10000 };
+const double TIME_STEP         = 0.05;
+const double MIN_RUN_SECONDS   = 2.0;
+const size_t MIN_RUN_STEPS     = 5;
+const Transform::scalar_t UNIT_SPACING = 0.4;
+const unsigned int ARMY_SEED   = 1;
+
+// Formation & model loading parameters
+const size_t FORMATION_COUNT   = 100;
+const size_t ROW_LENGTH        = 4;
+const Transform::Vector ROW_OFFSET(0.5, 0.0, 0.0);
+const Transform::Vector DIAMOND_OFFSET(0.4, 0.0, 0.5);
+const size_t MODEL_LOADS       = 20;
+const char * UNIT_TYPES[]      = { "light tank", "heavy tank", "humvee", "APC" };
+const size_t SPAWN_COUNT       = 50000;
+
+// Drive kernel test parameters
+const size_t KERNEL_UNITS      = 10003;     // Deliberately not a multiple of 8
+const size_t KERNEL_PASSES     = 2000;
+const DriveKernel DRIVE_KERNELS[] = { driveScalar, driveSSE2, driveAVX2 };
+
+// Terrain test parameters
+const char * TERRAIN_IMAGE     = "data/sand02.tif";
+const size_t TERRAIN_SAMPLES   = 513;
+const Transform::scalar_t TERRAIN_SPACING = 0.05;
+const Terrain::QueryKernel TERRAIN_KERNELS[] = { Terrain::queryScalar, Terrain::queryAVX2 };
+
+// View test parameters: the application's camera, once it's settled
+const size_t VIEW_PASSES       = 100;
+const Transform::scalar_t VIEW_RHO   = 12.0;
+const Transform::scalar_t VIEW_THETA = Transform::PI / 5.0;
+const Transform::scalar_t VIEW_PHI   = Transform::PI / 4.0;
+const Transform::scalar_t VIEW_FIELD_OF_VIEW = Transform::PI / 3.0;
+const Transform::scalar_t VIEW_ASPECT = 4.0 / 3.0;
+
+
+// One measurement: what was run, on how many units, and how fast it went
+struct BenchmarkResult {
+    std::string name;
+    size_t units;
+    double value;
+    const char * metric;
+};
+std::vector<BenchmarkResult> results;
+
+// Results that can't be worked out (because nothing ran, so we'd be dividing
+// by zero) are left out, since JSON has no way of saying inf or nan
+void record(const std::string &name, size_t units, double value, const char *metric) {
+    if (! std::isfinite(value)) {
+        std::fprintf(stderr, "%s: nothing was measured\n", name.c_str());
+        return;
+    }
+    BenchmarkResult r = { name, units, value, metric };
+    results.push_back(r);
+}
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+// Lay out a square block of 'count' units, in which everybody but the column
+// leaders is running the goal-seeking and avoidance logic
+BattleScenePtr createArmy(size_t count, const char *terrainImage = "") {
+    BattleScenePtr scene(new BattleScene(terrainImage));
+    scene->setThreadCount(0);       // Every core, like the headless runner
+    scene->createArmy(count, UNIT_SPACING, ARMY_SEED);
+    return scene;
+}
+
+// Step the scene until we've got a decent measurement, returning steps/sec
+double measureStepRate(BattleScenePtr scene) {
+    double time = 0.0;
+    scene->update(time);        // Warm up
+
+    size_t steps = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    while (steps < MIN_RUN_STEPS || elapsed < MIN_RUN_SECONDS) {
+        time += TIME_STEP;
+        scene->update(time);
+        steps++;
+        elapsed = secondsSince(start);
+    }
+    return steps / elapsed;
+}
+
+
+/*****************************************************************************
+ * Pass probes -- operators added to a scene's system after the real ones,
+ * which re-run one of the real passes each time the integrator gets to
+ * them, and time it. The pass works on scratch copies of the derivative &
+ * calculation, and anything else it writes is put back afterward, so the
+ * simulation carries on exactly as if the probe weren't there.
+ *****************************************************************************/
+struct PassTiming {
+    PassTiming() : seconds(0.0), calls(0) { }
+    double seconds;
+    size_t calls;
+};
+
+class ThirdPassProbe : public ThirdDerivOp {
+public:
+    ThirdPassProbe(BattleScene &s, PassTiming &t) : scene(s), timing(t) { }
+    void modifyThirdDerivative(SystemState &delta, SystemCalculation &calc,
+                         const SystemState &prev, const ObjectPtrList &objects) {
+        // The AI also sets the units' controls, goals & targets (and the
+        // throttle only ever nudges, so running it twice would push harder)
+        UnitStateTable &table = scene.unitStateTable();
+        std::vector<Transform::scalar_t> throttle(table.throttle), brake(table.brake),
+                                         wheels(table.wheelDeflection);
+        std::vector<Transform::Vector> displacement(table.goalDisplacement),
+                                       velocity(table.goalVelocity);
+        std::vector<BattleUnitPtr> targets(scene.battleUnitCount());
+        for (size_t i = 0; i < targets.size(); i++)
+            targets[i] = scene.battleUnit(i)->target;
+
+        SystemState d(delta);
+        SystemCalculation c(calc);
+        Clock::time_point start = Clock::now();
+        scene.fleetControl().modifyThirdDerivative(d, c, prev, objects);
+        timing.seconds += secondsSince(start);
+        timing.calls++;
+
+        table.throttle.swap(throttle);
+        table.brake.swap(brake);
+        table.wheelDeflection.swap(wheels);
+        table.goalDisplacement.swap(displacement);
+        table.goalVelocity.swap(velocity);
+        for (size_t i = 0; i < targets.size(); i++)
+            scene.battleUnit(i)->target = targets[i];
+    }
+protected:
+    BattleScene &scene;
+    PassTiming &timing;
+};
+
+class SecondPassProbe : public SecondDerivOp {
+public:
+    SecondPassProbe(FleetControl &f, PassTiming &t) : fleet(f), timing(t) { }
+    void modifySecondDerivative(SystemState &delta, SystemCalculation &calc,
+                          const SystemState &prev, const ObjectPtrList &objects) {
+        SystemState d(delta);
+        SystemCalculation c(calc);
+        Clock::time_point start = Clock::now();
+        fleet.modifySecondDerivative(d, c, prev, objects);
+        timing.seconds += secondsSince(start);
+        timing.calls++;
+    }
+protected:
+    FleetControl &fleet;
+    PassTiming &timing;
+};
+
+class ZerothPassProbe : public ZerothDerivOp {
+public:
+    ZerothPassProbe(GroundConstraint &g, PassTiming &t) : ground(g), timing(t) { }
+    void modifyZerothDerivative(SystemState &delta, SystemCalculation &calc,
+                          const SystemState &prev, const ObjectPtrList &objects) {
+        SystemState d(delta);
+        SystemCalculation c(calc);
+        Clock::time_point start = Clock::now();
+        ground.modifyZerothDerivative(d, c, prev, objects);
+        timing.seconds += secondsSince(start);
+        timing.calls++;
+    }
+protected:
+    GroundConstraint &ground;
+    PassTiming &timing;
+};
+
+// The ground constraint as it was before there was any terrain: everybody
+// is just kept above one fixed elevation
+class FlatClampProbe : public ZerothDerivOp {
+public:
+    FlatClampProbe(UnitStateTable &s, Transform::scalar_t e, PassTiming &t)
+        : table(s), elevation(e), timing(t) { }
+    void modifyZerothDerivative(SystemState &delta, SystemCalculation &calc,
+                          const SystemState &prev, const ObjectPtrList &objects) {
+        SystemState d(delta);
+        Clock::time_point start = Clock::now();
+        for (index_t s = 0; s < table.size(); s++) {
+            if (table.unit[s] == NULL)
+                continue;
+            index_t i = table.stateIndex[s];
+            Transform::scalar_t groundElev = table.elevationOffset[s] + elevation;
+            if (prev[i].x[1] + d[i].x[1] < groundElev)
+                d[i].x[1] = groundElev - prev[i].x[1];
+        }
+        timing.seconds += secondsSince(start);
+        timing.calls++;
+    }
+protected:
+    UnitStateTable &table;
+    Transform::scalar_t elevation;
+    PassTiming &timing;
+};
+
+// Time the individual passes, in nanoseconds per unit
+void benchmarkPasses(size_t count) {
+    BattleScenePtr scene = createArmy(count);
+    PassTiming third, second, zeroth, flat;
+
+    RigidBodySystemPtr system = scene->rigidBodySystem();
+    ThirdDerivOpPtr op3 = new ThirdPassProbe(*scene, third);
+    SecondDerivOpPtr op2 = new SecondPassProbe(scene->fleetControl(), second);
+    ZerothDerivOpPtr op0 = new ZerothPassProbe(scene->groundConstraint(), zeroth);
+    ZerothDerivOpPtr flat0 = new FlatClampProbe(scene->unitStateTable(),
+                                                scene->terrain()->height(0.0, 0.0), flat);
+    system->add(op3);
+    system->add(op2);
+    system->add(op0);
+    system->add(flat0);
+
+    measureStepRate(scene);
+    record("fleet/third",   count, third.seconds  * 1e9 / (third.calls  * count), "ns/unit");
+    record("fleet/second",  count, second.seconds * 1e9 / (second.calls * count), "ns/unit");
+    record("ground/zeroth", count, zeroth.seconds * 1e9 / (zeroth.calls * count), "ns/unit");
+    record("ground/flat-clamp", count, flat.seconds * 1e9 / (flat.calls * count), "ns/unit");
+}
+
+// Time the ground contact pass on uneven ground, in nanoseconds per unit
+void benchmarkTerrainContact(size_t count) {
+    BattleScenePtr scene = createArmy(count, TERRAIN_IMAGE);
+    PassTiming zeroth;
+    ZerothDerivOpPtr op0 = new ZerothPassProbe(scene->groundConstraint(), zeroth);
+    scene->rigidBodySystem()->add(op0);
+
+    measureStepRate(scene);
+    record("ground/terrain", count, zeroth.seconds * 1e9 / (zeroth.calls * count), "ns/unit");
+}
+
+
+// Pick every unit's model for the default camera, in nanoseconds per unit,
+// and report what percentage of them it'd draw
+void benchmarkView(size_t count) {
+    BattleScenePtr scene = createArmy(count);
+    Transform::scalar_t s = std::sin(VIEW_PHI);
+    Transform::Point eye(VIEW_RHO * std::cos(VIEW_THETA) * s, VIEW_RHO * std::cos(VIEW_PHI),
+                         -VIEW_RHO * std::sin(VIEW_THETA) * s);
+    ViewFrustum view(eye, Transform::Point(0.0, 0.0, 0.0) - eye,
+                     VIEW_FIELD_OF_VIEW, VIEW_ASPECT);
+
+    Clock::time_point start = Clock::now();
+    for (size_t p = 0; p < VIEW_PASSES; p++)
+        scene->updateView(view);
+    record("view/select", count, secondsSince(start) * 1e9 / (VIEW_PASSES * count), "ns/unit");
+
+    size_t drawn = 0;
+    for (size_t i = 0; i < count; i++)
+        if (scene->battleUnit(i)->detailLevel() >= 0)
+            drawn++;
+    record("view/drawn", count, 100.0 * drawn / count, "%");
+}
+
+
+/*****************************************************************************
+ * Formations & model loading
+ *****************************************************************************/
+// Build FORMATION_COUNT of each formation, in microseconds per unit created
+void benchmarkFormations() {
+    enum Formation { Row, Diamond, Triangle };
+    const char * names[] = { "formation/row", "formation/diamond",
+                             "formation/triangle" };
+
+    for (int f = Row; f <= Triangle; f++) {
+        BattleScenePtr scene(new BattleScene());
+        std::vector<BattleUnitPtr> leaders;
+        for (size_t i = 0; i < FORMATION_COUNT; i++) {
+            BattleUnitPtr leader = scene->addBattleUnit("humvee");
+            leader->transform->translate(Transform::Vector(0.0, 0.0, i * 2.0));
+            leaders.push_back(leader);
+        }
+
+        size_t before = scene->battleUnitCount();
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < FORMATION_COUNT; i++) {
+            switch (f) {
+            case Row:
+                scene->createRow(leaders[i], LightTankType, ROW_OFFSET, ROW_LENGTH);
+                break;
+            case Diamond:
+                scene->createDiamond(leaders[i], APCType, DIAMOND_OFFSET);
+                break;
+            case Triangle:
+                scene->createTriangle(leaders[i], HeavyTankType, DIAMOND_OFFSET);
+                break;
+            }
+        }
+        double elapsed = secondsSince(start);
+        size_t created = scene->battleUnitCount() - before;
+        record(names[f], created, elapsed * 1e6 / created, "us/unit");
+    }
+}
+
+// Spawn SPAWN_COUNT units of each type into an empty scene, in
+// microseconds per unit created
+void benchmarkSpawning() {
+    for (size_t t = 0; t < sizeof(UNIT_TYPES) / sizeof(UNIT_TYPES[0]); t++) {
+        std::string type(UNIT_TYPES[t]);
+        BattleScenePtr scene(new BattleScene());
+        Clock::time_point start = Clock::now();
+        size_t created = scene->spawnUnits(unitTypeNamed(type), SPAWN_COUNT);
+        double elapsed = secondsSince(start);
+        if (created != 0)
+            record("spawn/" + type, created, elapsed * 1e6 / created, "us/unit");
+    }
+}
+
+// Construct each unit type once from an empty model cache (i.e., loading
+// it from disk), then MODEL_LOADS more times, in milliseconds per unit
+void benchmarkModelLoading() {
+    UnitStateTablePtr table(new UnitStateTable());
+    for (size_t t = 0; t < sizeof(UNIT_TYPES) / sizeof(UNIT_TYPES[0]); t++) {
+        std::string type(UNIT_TYPES[t]);
+        UnitType unitType = unitTypeNamed(type);
+
+        ModelCache::instance().clear();
+        Clock::time_point start = Clock::now();
+        BattleUnit::create(unitType, table);
+        record("model/cold/" + type, 1, secondsSince(start) * 1e3, "ms/unit");
+
+        start = Clock::now();
+        for (size_t i = 0; i < MODEL_LOADS; i++)
+            BattleUnit::create(unitType, table);
+        record("model/cached/" + type, MODEL_LOADS,
+               secondsSince(start) * 1e3 / MODEL_LOADS, "ms/unit");
+    }
+}
+
+
+/*****************************************************************************
+ * Drive kernels
+ *****************************************************************************/
+// Fill a state table and batch with random (but plausible) unit values
+void createDriveBatch(UnitStateTable &table, DriveBatch &batch, size_t count) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0), signedUnit(-1.0, 1.0);
+
+    batch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        table.allocate(NULL);
+        table.throttle[i]        = unit(random);
+        table.brake[i]           = unit(random);
+        table.wheelDeflection[i] = signedUnit(random);
+        table.mass[i]            = 100.0 + 400.0 * unit(random);
+        table.maxEngineForce[i]  = 500.0 * unit(random);
+
+        batch.vx[i] = 2.0 * signedUnit(random);     batch.vz[i] = 2.0 * signedUnit(random);
+        batch.wy[i] = signedUnit(random);
+        batch.frontX[i] = signedUnit(random);       batch.frontY[i] = 0.1 * signedUnit(random);
+        batch.frontZ[i] = signedUnit(random);
+        batch.leftX[i] = -batch.frontZ[i];          batch.leftY[i] = 0.0;
+        batch.leftZ[i] = batch.frontX[i];
+        batch.Fx[i] = 0.0;  batch.Fy[i] = -980.0 * unit(random) + 100.0;   batch.Fz[i] = 0.0;
+        batch.Tx[i] = 0.0;  batch.Ty[i] = 0.0;  batch.Tz[i] = 0.0;
+    }
+}
+
+// Make sure every kernel this machine can run agrees with the scalar one.
+// Returns the number of kernels that don't.
+int checkDriveKernels() {
+    UnitStateTable table;
+    DriveBatch input;
+    createDriveBatch(table, input, KERNEL_UNITS);
+
+    DriveBatch reference = input;
+    driveScalar(table, reference, 0, KERNEL_UNITS);
+
+    int failures = 0;
+    DriveKernel best = selectDriveKernel();
+    for (size_t k = 0; k < sizeof(DRIVE_KERNELS) / sizeof(DRIVE_KERNELS[0]); k++) {
+        DriveKernel kernel = DRIVE_KERNELS[k];
+        if (kernel == driveAVX2 && best != driveAVX2)
+            continue;                   // Can't run it here
+
+        DriveBatch result = input;
+        kernel(table, result, 0, KERNEL_UNITS);
+
+        double error = 0.0;
+        for (size_t i = 0; i < KERNEL_UNITS; i++) {
+            error = std::max(error, std::fabs(result.Fx[i] - reference.Fx[i]));
+            error = std::max(error, std::fabs(result.Fy[i] - reference.Fy[i]));
+            error = std::max(error, std::fabs(result.Fz[i] - reference.Fz[i]));
+            error = std::max(error, std::fabs(result.Tx[i] - reference.Tx[i]));
+            error = std::max(error, std::fabs(result.Ty[i] - reference.Ty[i]));
+            error = std::max(error, std::fabs(result.Tz[i] - reference.Tz[i]));
+        }
+        if (error != 0.0) {
+            std::fprintf(stderr, "drive kernel %s disagrees with scalar by %g\n",
+                         driveKernelName(kernel), error);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Time each kernel this machine can run, in units/sec
+void benchmarkDriveKernels() {
+    UnitStateTable table;
+    DriveBatch input;
+    createDriveBatch(table, input, KERNEL_UNITS);
+
+    DriveKernel best = selectDriveKernel();
+    for (size_t k = 0; k < sizeof(DRIVE_KERNELS) / sizeof(DRIVE_KERNELS[0]); k++) {
+        DriveKernel kernel = DRIVE_KERNELS[k];
+        if (kernel == driveAVX2 && best != driveAVX2)
+            continue;
+
+        DriveBatch batch = input;
+        Clock::time_point start = Clock::now();
+        for (size_t p = 0; p < KERNEL_PASSES; p++)
+            kernel(table, batch, 0, KERNEL_UNITS);
+        record(std::string("drive/") + driveKernelName(kernel), KERNEL_UNITS,
+               KERNEL_UNITS * KERNEL_PASSES / secondsSince(start), "units/s");
+    }
+}
+
+
+/*****************************************************************************
+ * Terrain query kernels
+ *****************************************************************************/
+// Rolling hills, and points scattered over (and a little past) them
+TerrainPtr createHills(std::vector<double> &x, std::vector<double> &z) {
+    std::vector<float> heights(TERRAIN_SAMPLES * TERRAIN_SAMPLES);
+    for (size_t j = 0; j < TERRAIN_SAMPLES; j++)
+        for (size_t i = 0; i < TERRAIN_SAMPLES; i++)
+            heights[j * TERRAIN_SAMPLES + i] = float(0.2 * std::sin(i * 0.05) * std::cos(j * 0.07));
+    TerrainPtr hills(new Terrain(TERRAIN_SAMPLES, TERRAIN_SAMPLES, &heights[0], TERRAIN_SPACING));
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> across(-0.6 * hills->width(), 0.6 * hills->width());
+    x.resize(KERNEL_UNITS);
+    z.resize(KERNEL_UNITS);
+    for (size_t i = 0; i < KERNEL_UNITS; i++) {
+        x[i] = across(random);
+        z[i] = across(random);
+    }
+    return hills;
+}
+
+// Make sure every query kernel this machine can run agrees with the scalar
+// one. Returns the number of kernels that don't.
+int checkTerrainKernels() {
+    std::vector<double> x, z;
+    TerrainPtr hills = createHills(x, z);
+    std::vector<double> h0(KERNEL_UNITS), nx0(KERNEL_UNITS), ny0(KERNEL_UNITS), nz0(KERNEL_UNITS);
+    Terrain::queryScalar(*hills, KERNEL_UNITS, &x[0], &z[0], &h0[0], &nx0[0], &ny0[0], &nz0[0]);
+
+    int failures = 0;
+    Terrain::QueryKernel best = Terrain::selectQueryKernel();
+    for (size_t k = 0; k < sizeof(TERRAIN_KERNELS) / sizeof(TERRAIN_KERNELS[0]); k++) {
+        Terrain::QueryKernel kernel = TERRAIN_KERNELS[k];
+        if (kernel == Terrain::queryAVX2 && best != Terrain::queryAVX2)
+            continue;                   // Can't run it here
+
+        std::vector<double> h(KERNEL_UNITS), nx(KERNEL_UNITS), ny(KERNEL_UNITS), nz(KERNEL_UNITS);
+        kernel(*hills, KERNEL_UNITS, &x[0], &z[0], &h[0], &nx[0], &ny[0], &nz[0]);
+
+        double error = 0.0;
+        for (size_t i = 0; i < KERNEL_UNITS; i++) {
+            error = std::max(error, std::fabs(h[i] - h0[i]));
+            error = std::max(error, std::fabs(nx[i] - nx0[i]));
+            error = std::max(error, std::fabs(ny[i] - ny0[i]));
+            error = std::max(error, std::fabs(nz[i] - nz0[i]));
+        }
+        if (error != 0.0) {
+            std::fprintf(stderr, "terrain kernel %s disagrees with scalar by %g\n",
+                         Terrain::queryKernelName(kernel), error);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Time each query kernel this machine can run, in points/sec
+void benchmarkTerrainKernels() {
+    std::vector<double> x, z;
+    TerrainPtr hills = createHills(x, z);
+    std::vector<double> h(KERNEL_UNITS), nx(KERNEL_UNITS), ny(KERNEL_UNITS), nz(KERNEL_UNITS);
+
+    Terrain::QueryKernel best = Terrain::selectQueryKernel();
+    for (size_t k = 0; k < sizeof(TERRAIN_KERNELS) / sizeof(TERRAIN_KERNELS[0]); k++) {
+        Terrain::QueryKernel kernel = TERRAIN_KERNELS[k];
+        if (kernel == Terrain::queryAVX2 && best != Terrain::queryAVX2)
+            continue;
+
+        Clock::time_point start = Clock::now();
+        for (size_t p = 0; p < KERNEL_PASSES; p++)
+            kernel(*hills, KERNEL_UNITS, &x[0], &z[0], &h[0], &nx[0], &ny[0], &nz[0]);
+        record(std::string("terrain/") + Terrain::queryKernelName(kernel), KERNEL_UNITS,
+               KERNEL_UNITS * KERNEL_PASSES / secondsSince(start), "points/s");
+    }
+}
+
+
+/*****************************************************************************
+ * Reporting
+ *****************************************************************************/
+void printTable() {
+    std::printf("%-22s %8s %16s  %s\n", "benchmark", "units", "value", "metric");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &r = results[i];
+        std::printf("%-22s %8u %16.3f  %s\n", r.name.c_str(), unsigned(r.units),
+                    r.value, r.metric);
+    }
+}
+
+bool writeJSON(const char *filename) {
+    FILE *out = std::strcmp(filename, "-") == 0 ? stdout : std::fopen(filename, "w");
+    if (out == NULL) {
+        std::perror(filename);
+        return false;
+    }
+
+    std::fprintf(out, "{\n  \"driveKernel\": \"%s\",\n  \"cores\": %u,\n"
+                      "  \"benchmarks\": [\n",
+                 driveKernelName(selectDriveKernel()),
+                 unsigned(std::thread::hardware_concurrency()));
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &r = results[i];
+        std::fprintf(out, "    { \"name\": \"%s\", \"units\": %u, "
+                          "\"value\": %.6g, \"metric\": \"%s\" }%s\n",
+                     r.name.c_str(), unsigned(r.units), r.value, r.metric,
+                     (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        std::fclose(out);
+    return true;
+}
+
+
+/*****************************************************************************
+ * Benchmark main() entry function -- checks the drive & terrain kernels,
+ * then runs everything and reports on it. --json FILE writes the results as
+ * JSON instead of printing a table.
+ *****************************************************************************/
+int main(int argc, char **argv) {
+    const char *jsonFile = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonFile = argv[++i];
+        else {
+            std::fprintf(stderr, "Usage: %s [--json FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (checkDriveKernels() != 0 || checkTerrainKernels() != 0)
+        return 1;
+    benchmarkDriveKernels();
+    benchmarkTerrainKernels();
+
+    // Whole steps, with the spatial index off (every unit checks every
+    // unit) and on
+    for (size_t i = 0; i < sizeof(UPDATE_SIZES) / sizeof(UPDATE_SIZES[0]); i++) {
+        size_t count = UPDATE_SIZES[i];
+
+        BattleScenePtr exhaustive = createArmy(count);
+        exhaustive->setSpatialIndexing(false);
+        record("update/exhaustive", count, measureStepRate(exhaustive), "steps/s");
+
+        BattleScenePtr indexed = createArmy(count);
+        indexed->setSpatialIndexing(true);
+        record("update/grid", count, measureStepRate(indexed), "steps/s");
+    }
+
+    for (size_t i = 0; i < sizeof(PASS_SIZES) / sizeof(PASS_SIZES[0]); i++) {
+        benchmarkPasses(PASS_SIZES[i]);
+        benchmarkTerrainContact(PASS_SIZES[i]);
+        benchmarkView(PASS_SIZES[i]);
+    }
+
+    benchmarkFormations();
+    benchmarkSpawning();
+    benchmarkModelLoading();
+
+    if (jsonFile != NULL)
+        return writeJSON(jsonFile) ? 0 : 1;
+    printTable();
+    return 0;
+}
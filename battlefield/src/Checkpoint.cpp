@@ -0,0 +1,89 @@
+/*
+ * File: Checkpoint.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the checkpoint reading and writing functions
+ *      defined in Checkpoint.hpp.
+ */
+
+// Import function & class definitions
+#include "Checkpoint.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+
+// Are all of these numbers actual numbers?
+static bool allFinite(const double *values, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        if (! std::isfinite(values[i]))
+            return false;
+    return true;
+}
+
+bool CheckpointView::open(const unsigned char *data, size_t size,
+                          uint32_t typeCount, uint32_t actionCount) {
+    header = NULL;
+    if (data == NULL || size < sizeof(CheckpointHeader))
+        return false;
+
+    const CheckpointHeader *h = reinterpret_cast<const CheckpointHeader *>(data);
+    if (std::memcmp(h->magic, CHECKPOINT_MAGIC, 4) != 0
+            || h->version != CHECKPOINT_VERSION
+            || h->unitSize != sizeof(CheckpointUnit))
+        return false;
+
+    // Make sure the units are inside the file...
+    uint64_t end = uint64_t(h->unitOffset) + uint64_t(h->unitCount) * sizeof(CheckpointUnit);
+    if (h->unitOffset % 8 != 0 || end > size)
+        return false;
+
+    // ...that what they refer to exists, and that their state is something
+    // the simulation can carry on from
+    const CheckpointUnit *u = reinterpret_cast<const CheckpointUnit *>(data + h->unitOffset);
+    const size_t STATE_VALUES = offsetof(CheckpointUnit, type) / sizeof(double);  // They come first
+    for (uint32_t i = 0; i < h->unitCount; i++)
+        if (u[i].type >= typeCount
+                || u[i].action >= actionCount
+                || (u[i].target != CHECKPOINT_NONE && u[i].target >= h->unitCount)
+                || ! allFinite(reinterpret_cast<const double *>(&u[i]), STATE_VALUES))
+            return false;
+    if (! std::isfinite(h->time))
+        return false;
+
+    base = data;
+    header = h;
+    return true;
+}
+
+
+bool Battlefield::writeCheckpointFile(const string &filename,
+                                      const std::vector<unsigned char> &data) {
+    string temporary = filename + ".tmp";
+    FILE *out = std::fopen(temporary.c_str(), "wb");
+    if (out == NULL)
+        return false;
+    bool ok = data.empty()
+           || std::fwrite(&data[0], 1, data.size(), out) == data.size();
+    if (std::fclose(out) != 0)
+        ok = false;
+
+    if (ok) {
+#if __MS_WINDOZE__
+        // Windows won't rename over an existing file
+        std::remove(filename.c_str());
+#endif
+        ok = std::rename(temporary.c_str(), filename.c_str()) == 0;
+    }
+    if (! ok)
+        std::remove(temporary.c_str());
+    return ok;
+}
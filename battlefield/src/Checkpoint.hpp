@@ -0,0 +1,120 @@
+/*
+ * File: Checkpoint.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      A checkpoint is a snapshot of a running battle, from which a
+ *      BattleScene can pick up where it left off. Like the .mesh format,
+ *      it's meant to be mapped into memory and used in place, and it's
+ *      laid out as a fixed header followed by a packed array (in the byte
+ *      order of the machine that wrote it):
+ *
+ *          CheckpointHeader                magic, version, time & counts
+ *          CheckpointUnit * unitCount      every unit, in scene order
+ *
+ *      Units refer to each other (e.g., whom they're following) by their
+ *      position in that array. CheckpointView checks that a mapped file is
+ *      well-formed before anybody uses it.
+ */
+
+#ifndef BATTLEFIELD_CHECKPOINT
+#define BATTLEFIELD_CHECKPOINT
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    struct CheckpointHeader;
+    struct CheckpointUnit;
+    class CheckpointView;
+
+    // Format identification
+    const char     CHECKPOINT_MAGIC[4] = { 'B', 'F', 'C', 'P' };
+    const uint32_t CHECKPOINT_VERSION  = 1;
+
+    // Index meaning "none" (e.g., a unit without a target)
+    const uint32_t CHECKPOINT_NONE = 0xFFFFFFFF;
+
+    // Unit flags
+    const uint32_t CHECKPOINT_SELECTED        = 0x1;
+    const uint32_t CHECKPOINT_MANUAL_CONTROL  = 0x2;
+    const uint32_t CHECKPOINT_RENDER_GOAL     = 0x4;
+    const uint32_t CHECKPOINT_RELATIVE_OFFSET = 0x8;
+
+    // Write a checkpoint (header & units, already packed into 'data') to
+    // 'filename'. It's written under a temporary name and then renamed, so
+    // that an existing checkpoint is never left half-overwritten.
+    bool writeCheckpointFile(const string &filename,
+                             const std::vector<unsigned char> &data);
+};
+
+
+struct Battlefield::CheckpointHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t unitCount;
+    uint32_t unitSize;                  // sizeof(CheckpointUnit)
+    uint32_t unitOffset;                // Byte offset from the start
+    uint32_t reserved;
+    double   time;                      // Simulation time of the snapshot
+};
+
+// Everything about one unit that isn't fixed by its type
+struct Battlefield::CheckpointUnit {
+    // Rigid-body state
+    double location[3];
+    double rotation[4];
+    double momentum[3];
+    double angularMomentum[3];
+
+    // Control & goal-reaching state
+    double throttle, brake, wheelDeflection;
+    double goalDisplacement[3];
+    double goalVelocity[3];
+    double targetOffset[3];
+
+    // Who & what it is
+    uint32_t type;                      // Index into the unit type names
+    uint32_t target;                    // Unit index, or CHECKPOINT_NONE
+    uint32_t action;                    // BattleAction
+    uint32_t armor, ammo, morale;
+    uint32_t team, rank;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+
+// Checked access to a checkpoint in memory
+class Battlefield::CheckpointView {
+public:
+    // Constructor
+    CheckpointView() : base(NULL), header(NULL) { }
+
+    // Point this at a checkpoint's contents, returning false if they're not
+    // a valid checkpoint of the version we understand. 'typeCount' and
+    // 'actionCount' are how many unit types and BattleActions there are.
+    bool open(const unsigned char *data, size_t size,
+              uint32_t typeCount, uint32_t actionCount);
+
+    // The snapshot, which points into the original data
+    double time() const { return header->time; }
+    uint32_t unitCount() const { return header->unitCount; }
+    const CheckpointUnit * units() const {
+        return reinterpret_cast<const CheckpointUnit *>(base + header->unitOffset);
+    }
+
+protected:
+    const unsigned char * base;
+    const CheckpointHeader * header;
+};
+
+#endif
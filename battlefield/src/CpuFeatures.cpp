@@ -0,0 +1,61 @@
+/*
+ * File: CpuFeatures.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the processor feature queries declared in
+ *      CpuFeatures.hpp.
+ */
+
+// Import function definitions
+#include "CpuFeatures.hpp"
+using namespace Battlefield;
+
+#if BATTLEFIELD_X86 && defined(_MSC_VER)
+#   include <intrin.h>
+#   include <immintrin.h>
+#endif
+
+
+#if BATTLEFIELD_X86 && defined(__GNUC__)
+
+bool Battlefield::cpuHasSSE2()  { return __builtin_cpu_supports("sse2") != 0; }
+bool Battlefield::cpuHasSSSE3() { return __builtin_cpu_supports("ssse3") != 0; }
+bool Battlefield::cpuHasAVX2()  { return __builtin_cpu_supports("avx2") != 0; }
+
+#elif BATTLEFIELD_X86 && defined(_MSC_VER)
+
+bool Battlefield::cpuHasSSE2() {
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+}
+
+bool Battlefield::cpuHasSSSE3() {
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+}
+
+bool Battlefield::cpuHasAVX2() {
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYMM = (info[2] & (1 << 27)) != 0        // OSXSAVE
+                   && (info[2] & (1 << 28)) != 0        // AVX
+                   && (_xgetbv(0) & 0x6) == 0x6;        // XMM & YMM state
+    if (! osSavesYMM)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+#else
+
+bool Battlefield::cpuHasSSE2()  { return false; }
+bool Battlefield::cpuHasSSSE3() { return false; }
+bool Battlefield::cpuHasAVX2()  { return false; }
+
+#endif
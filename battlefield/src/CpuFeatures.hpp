@@ -0,0 +1,43 @@
+/*
+ * File: CpuFeatures.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      Run-time detection of the vector instruction sets available on this
+ *      processor, so that the simulation can pick the fastest version of a
+ *      kernel while still running on machines that lack the newer ones.
+ *
+ *      Kernels that use a particular instruction set should be compiled
+ *      with BATTLEFIELD_TARGET("<isa>"), so that the rest of the program
+ *      can be built for the baseline processor.
+ */
+
+#ifndef BATTLEFIELD_CPU_FEATURES
+#define BATTLEFIELD_CPU_FEATURES
+
+// Are we on an x86 processor?
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   define BATTLEFIELD_X86 1
+#else
+#   define BATTLEFIELD_X86 0
+#endif
+
+// Compile a single function for a particular instruction set
+#if BATTLEFIELD_X86 && defined(__GNUC__)
+#   define BATTLEFIELD_TARGET(ISA) __attribute__((target(ISA)))
+#else
+#   define BATTLEFIELD_TARGET(ISA)
+#endif
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // What we've got to work with
+    bool cpuHasSSE2();
+    bool cpuHasSSSE3();
+    bool cpuHasAVX2();
+};
+
+#endif
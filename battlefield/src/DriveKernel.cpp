@@ -0,0 +1,262 @@
+/*
+ * File: DriveKernel.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the drive kernels declared in DriveKernel.hpp.
+ */
+
+// Import function definitions
+#include "DriveKernel.hpp"
+#include "UnitStateTable.hpp"
+#include "CpuFeatures.hpp"
+using namespace Battlefield;
+
+// Import vector intrinsics
+#if BATTLEFIELD_X86
+#   include <immintrin.h>
+#endif
+
+
+void DriveBatch::resize(size_t n) {
+    vx.resize(n);       vz.resize(n);       wy.resize(n);
+    frontX.resize(n);   frontY.resize(n);   frontZ.resize(n);
+    leftX.resize(n);    leftY.resize(n);    leftZ.resize(n);
+    Fx.resize(n);       Fy.resize(n);       Fz.resize(n);
+    Tx.resize(n);       Ty.resize(n);       Tz.resize(n);
+}
+
+
+// Scalar version -- this is the reference that the others must match
+void Battlefield::driveScalar(const UnitStateTable &t, DriveBatch &b,
+                              size_t begin, size_t end) {
+    typedef Transform::scalar_t scalar_t;
+    for (size_t i = begin; i < end; i++) {
+        scalar_t vx = b.vx[i], vz = b.vz[i];
+        scalar_t Fx = b.Fx[i], Fy = b.Fy[i], Fz = b.Fz[i];
+        scalar_t Tx = b.Tx[i], Ty = b.Ty[i], Tz = b.Tz[i];
+
+        // Engine-powered acceleration
+        scalar_t engine = t.throttle[i] * t.maxEngineForce[i];
+        Fx += engine * b.frontX[i];
+        Fy += engine * b.frontY[i];
+        Fz += engine * b.frontZ[i];
+
+        // Turning force, applied at the axle
+        scalar_t turnF = t.wheelDeflection[i] * (vx * vx + vz * vz)
+                       * t.mass[i] / t.minTurningRadius[i];
+        scalar_t forceX = turnF * b.leftX[i],
+                 forceY = turnF * b.leftY[i],
+                 forceZ = turnF * b.leftZ[i];
+        scalar_t applyX = b.frontX[i] * t.axleOffset[i],
+                 applyY = b.frontY[i] * t.axleOffset[i],
+                 applyZ = b.frontZ[i] * t.axleOffset[i];
+        Tx += applyY * forceZ - applyZ * forceY;
+        Ty += applyZ * forceX - applyX * forceZ;
+        Tz += applyX * forceY - applyY * forceX;
+
+        // Friction acts only if pressed against the ground
+        if (Fy < 0.0) {
+            scalar_t kL = t.minLinearFriction[i]
+                        + (t.maxLinearFriction[i] - t.minLinearFriction[i]) * t.brake[i];
+            Fx += vx * (kL * Fy);
+            Fz += vz * (kL * Fy);
+
+            scalar_t kA = t.minAngularFriction[i]
+                        + (t.maxAngularFriction[i] - t.minAngularFriction[i]) * t.brake[i];
+            Ty += b.wy[i] * kA * Fy;
+
+            // Zero vertical forces/torques
+            Fy = 0.0;
+            Tx = 0.0;
+            Tz = 0.0;
+        }
+
+        b.Fx[i] = Fx;   b.Fy[i] = Fy;   b.Fz[i] = Fz;
+        b.Tx[i] = Tx;   b.Ty[i] = Ty;   b.Tz[i] = Tz;
+    }
+}
+
+
+#if BATTLEFIELD_X86
+
+// SSE2 version -- two units per register, two registers per iteration
+BATTLEFIELD_TARGET("sse2")
+static inline void driveSSE2Pair(const UnitStateTable &t, DriveBatch &b,
+                                 size_t i) {
+    const __m128d zero = _mm_setzero_pd();
+    __m128d vx = _mm_loadu_pd(&b.vx[i]), vz = _mm_loadu_pd(&b.vz[i]);
+    __m128d Fx = _mm_loadu_pd(&b.Fx[i]), Fy = _mm_loadu_pd(&b.Fy[i]),
+            Fz = _mm_loadu_pd(&b.Fz[i]);
+    __m128d Tx = _mm_loadu_pd(&b.Tx[i]), Ty = _mm_loadu_pd(&b.Ty[i]),
+            Tz = _mm_loadu_pd(&b.Tz[i]);
+    __m128d frontX = _mm_loadu_pd(&b.frontX[i]),
+            frontY = _mm_loadu_pd(&b.frontY[i]),
+            frontZ = _mm_loadu_pd(&b.frontZ[i]);
+
+    // Engine-powered acceleration
+    __m128d engine = _mm_mul_pd(_mm_loadu_pd(&t.throttle[i]),
+                                _mm_loadu_pd(&t.maxEngineForce[i]));
+    Fx = _mm_add_pd(Fx, _mm_mul_pd(engine, frontX));
+    Fy = _mm_add_pd(Fy, _mm_mul_pd(engine, frontY));
+    Fz = _mm_add_pd(Fz, _mm_mul_pd(engine, frontZ));
+
+    // Turning force, applied at the axle
+    __m128d v2 = _mm_add_pd(_mm_mul_pd(vx, vx), _mm_mul_pd(vz, vz));
+    __m128d turnF = _mm_div_pd(_mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(&t.wheelDeflection[i]), v2),
+                                          _mm_loadu_pd(&t.mass[i])),
+                               _mm_loadu_pd(&t.minTurningRadius[i]));
+    __m128d forceX = _mm_mul_pd(turnF, _mm_loadu_pd(&b.leftX[i])),
+            forceY = _mm_mul_pd(turnF, _mm_loadu_pd(&b.leftY[i])),
+            forceZ = _mm_mul_pd(turnF, _mm_loadu_pd(&b.leftZ[i]));
+    __m128d axle = _mm_loadu_pd(&t.axleOffset[i]);
+    __m128d applyX = _mm_mul_pd(frontX, axle),
+            applyY = _mm_mul_pd(frontY, axle),
+            applyZ = _mm_mul_pd(frontZ, axle);
+    Tx = _mm_add_pd(Tx, _mm_sub_pd(_mm_mul_pd(applyY, forceZ), _mm_mul_pd(applyZ, forceY)));
+    Ty = _mm_add_pd(Ty, _mm_sub_pd(_mm_mul_pd(applyZ, forceX), _mm_mul_pd(applyX, forceZ)));
+    Tz = _mm_add_pd(Tz, _mm_sub_pd(_mm_mul_pd(applyX, forceY), _mm_mul_pd(applyY, forceX)));
+
+    // Friction acts only where pressed against the ground
+    __m128d onGround = _mm_cmplt_pd(Fy, zero);
+    __m128d brake = _mm_loadu_pd(&t.brake[i]);
+    __m128d minL = _mm_loadu_pd(&t.minLinearFriction[i]);
+    __m128d kL = _mm_add_pd(minL, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&t.maxLinearFriction[i]), minL), brake));
+    __m128d kLFy = _mm_mul_pd(kL, Fy);
+    Fx = _mm_add_pd(Fx, _mm_and_pd(onGround, _mm_mul_pd(vx, kLFy)));
+    Fz = _mm_add_pd(Fz, _mm_and_pd(onGround, _mm_mul_pd(vz, kLFy)));
+
+    __m128d minA = _mm_loadu_pd(&t.minAngularFriction[i]);
+    __m128d kA = _mm_add_pd(minA, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&t.maxAngularFriction[i]), minA), brake));
+    __m128d torque = _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(&b.wy[i]), kA), Fy);
+    Ty = _mm_add_pd(Ty, _mm_and_pd(onGround, torque));
+
+    // Zero vertical forces/torques
+    Fy = _mm_andnot_pd(onGround, Fy);
+    Tx = _mm_andnot_pd(onGround, Tx);
+    Tz = _mm_andnot_pd(onGround, Tz);
+
+    _mm_storeu_pd(&b.Fx[i], Fx);    _mm_storeu_pd(&b.Fy[i], Fy);
+    _mm_storeu_pd(&b.Fz[i], Fz);    _mm_storeu_pd(&b.Tx[i], Tx);
+    _mm_storeu_pd(&b.Ty[i], Ty);    _mm_storeu_pd(&b.Tz[i], Tz);
+}
+
+BATTLEFIELD_TARGET("sse2")
+void Battlefield::driveSSE2(const UnitStateTable &t, DriveBatch &b,
+                            size_t begin, size_t end) {
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        driveSSE2Pair(t, b, i);
+        driveSSE2Pair(t, b, i + 2);
+    }
+    for (; i + 2 <= end; i += 2)
+        driveSSE2Pair(t, b, i);
+    driveScalar(t, b, i, end);
+}
+
+
+// AVX2 version -- four units per register, two registers per iteration
+BATTLEFIELD_TARGET("avx2")
+static inline void driveAVX2Quad(const UnitStateTable &t, DriveBatch &b,
+                                 size_t i) {
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d vx = _mm256_loadu_pd(&b.vx[i]), vz = _mm256_loadu_pd(&b.vz[i]);
+    __m256d Fx = _mm256_loadu_pd(&b.Fx[i]), Fy = _mm256_loadu_pd(&b.Fy[i]),
+            Fz = _mm256_loadu_pd(&b.Fz[i]);
+    __m256d Tx = _mm256_loadu_pd(&b.Tx[i]), Ty = _mm256_loadu_pd(&b.Ty[i]),
+            Tz = _mm256_loadu_pd(&b.Tz[i]);
+    __m256d frontX = _mm256_loadu_pd(&b.frontX[i]),
+            frontY = _mm256_loadu_pd(&b.frontY[i]),
+            frontZ = _mm256_loadu_pd(&b.frontZ[i]);
+
+    // Engine-powered acceleration
+    __m256d engine = _mm256_mul_pd(_mm256_loadu_pd(&t.throttle[i]),
+                                   _mm256_loadu_pd(&t.maxEngineForce[i]));
+    Fx = _mm256_add_pd(Fx, _mm256_mul_pd(engine, frontX));
+    Fy = _mm256_add_pd(Fy, _mm256_mul_pd(engine, frontY));
+    Fz = _mm256_add_pd(Fz, _mm256_mul_pd(engine, frontZ));
+
+    // Turning force, applied at the axle
+    __m256d v2 = _mm256_add_pd(_mm256_mul_pd(vx, vx), _mm256_mul_pd(vz, vz));
+    __m256d turnF = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(&t.wheelDeflection[i]), v2),
+                                                _mm256_loadu_pd(&t.mass[i])),
+                                  _mm256_loadu_pd(&t.minTurningRadius[i]));
+    __m256d forceX = _mm256_mul_pd(turnF, _mm256_loadu_pd(&b.leftX[i])),
+            forceY = _mm256_mul_pd(turnF, _mm256_loadu_pd(&b.leftY[i])),
+            forceZ = _mm256_mul_pd(turnF, _mm256_loadu_pd(&b.leftZ[i]));
+    __m256d axle = _mm256_loadu_pd(&t.axleOffset[i]);
+    __m256d applyX = _mm256_mul_pd(frontX, axle),
+            applyY = _mm256_mul_pd(frontY, axle),
+            applyZ = _mm256_mul_pd(frontZ, axle);
+    Tx = _mm256_add_pd(Tx, _mm256_sub_pd(_mm256_mul_pd(applyY, forceZ), _mm256_mul_pd(applyZ, forceY)));
+    Ty = _mm256_add_pd(Ty, _mm256_sub_pd(_mm256_mul_pd(applyZ, forceX), _mm256_mul_pd(applyX, forceZ)));
+    Tz = _mm256_add_pd(Tz, _mm256_sub_pd(_mm256_mul_pd(applyX, forceY), _mm256_mul_pd(applyY, forceX)));
+
+    // Friction acts only where pressed against the ground
+    __m256d onGround = _mm256_cmp_pd(Fy, zero, _CMP_LT_OQ);
+    __m256d brake = _mm256_loadu_pd(&t.brake[i]);
+    __m256d minL = _mm256_loadu_pd(&t.minLinearFriction[i]);
+    __m256d kL = _mm256_add_pd(minL, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(&t.maxLinearFriction[i]), minL), brake));
+    __m256d kLFy = _mm256_mul_pd(kL, Fy);
+    Fx = _mm256_add_pd(Fx, _mm256_and_pd(onGround, _mm256_mul_pd(vx, kLFy)));
+    Fz = _mm256_add_pd(Fz, _mm256_and_pd(onGround, _mm256_mul_pd(vz, kLFy)));
+
+    __m256d minA = _mm256_loadu_pd(&t.minAngularFriction[i]);
+    __m256d kA = _mm256_add_pd(minA, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(&t.maxAngularFriction[i]), minA), brake));
+    __m256d torque = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(&b.wy[i]), kA), Fy);
+    Ty = _mm256_add_pd(Ty, _mm256_and_pd(onGround, torque));
+
+    // Zero vertical forces/torques
+    Fy = _mm256_andnot_pd(onGround, Fy);
+    Tx = _mm256_andnot_pd(onGround, Tx);
+    Tz = _mm256_andnot_pd(onGround, Tz);
+
+    _mm256_storeu_pd(&b.Fx[i], Fx);     _mm256_storeu_pd(&b.Fy[i], Fy);
+    _mm256_storeu_pd(&b.Fz[i], Fz);     _mm256_storeu_pd(&b.Tx[i], Tx);
+    _mm256_storeu_pd(&b.Ty[i], Ty);     _mm256_storeu_pd(&b.Tz[i], Tz);
+}
+
+BATTLEFIELD_TARGET("avx2")
+void Battlefield::driveAVX2(const UnitStateTable &t, DriveBatch &b,
+                            size_t begin, size_t end) {
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        driveAVX2Quad(t, b, i);
+        driveAVX2Quad(t, b, i + 4);
+    }
+    for (; i + 4 <= end; i += 4)
+        driveAVX2Quad(t, b, i);
+    driveScalar(t, b, i, end);
+}
+
+#else
+
+// No vector units that we know how to use...fall back to scalar
+void Battlefield::driveSSE2(const UnitStateTable &t, DriveBatch &b,
+                            size_t begin, size_t end) {
+    driveScalar(t, b, begin, end);
+}
+
+void Battlefield::driveAVX2(const UnitStateTable &t, DriveBatch &b,
+                            size_t begin, size_t end) {
+    driveScalar(t, b, begin, end);
+}
+
+#endif
+
+
+// Pick the fastest implementation this processor can run
+DriveKernel Battlefield::selectDriveKernel() {
+    if (cpuHasAVX2())   return driveAVX2;
+    if (cpuHasSSE2())   return driveSSE2;
+    return driveScalar;
+}
+
+const char * Battlefield::driveKernelName(DriveKernel k) {
+    if (k == driveAVX2)     return "avx2";
+    if (k == driveSSE2)     return "sse2";
+    return "scalar";
+}
@@ -0,0 +1,74 @@
+/*
+ * File: DriveKernel.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The drive kernel computes the forces that units apply to themselves:
+ *      engine force along front(), turning torque from the wheels, and the
+ *      brake-dependent linear and angular friction. The maths is the same
+ *      for every unit, so it is written over packed arrays (one entry per
+ *      UnitStateTable slot), with vectorized versions for SSE2 and AVX2 and
+ *      a scalar fallback. The best one is picked at run time.
+ *
+ *      All versions do exactly the same arithmetic, in the same order, with
+ *      branches replaced by masks. They only differ from each other (and
+ *      from the original branching code) in the sign of zero results.
+ */
+
+#ifndef BATTLEFIELD_DRIVE_KERNEL
+#define BATTLEFIELD_DRIVE_KERNEL
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class UnitStateTable;
+    struct DriveBatch;
+
+    // Signature of a drive kernel, processing slots [begin, end)
+    typedef void (*DriveKernel)(const UnitStateTable &units, DriveBatch &b,
+                                size_t begin, size_t end);
+
+    // The available implementations
+    void driveScalar(const UnitStateTable &units, DriveBatch &b,
+                     size_t begin, size_t end);
+    void driveSSE2(const UnitStateTable &units, DriveBatch &b,
+                   size_t begin, size_t end);
+    void driveAVX2(const UnitStateTable &units, DriveBatch &b,
+                   size_t begin, size_t end);
+
+    // Pick the fastest implementation this processor can run
+    DriveKernel selectDriveKernel();
+    const char * driveKernelName(DriveKernel k);
+};
+
+
+// The per-step values that the kernel needs from the rigid-body system,
+// gathered into packed arrays parallel to the UnitStateTable
+struct Battlefield::DriveBatch {
+    typedef Transform::scalar_t scalar_t;
+
+    // Inputs: ground-plane velocity, angular velocity about the ground
+    // normal, and the unit's front() and left() vectors
+    std::vector<scalar_t> vx, vz, wy;
+    std::vector<scalar_t> frontX, frontY, frontZ;
+    std::vector<scalar_t> leftX, leftY, leftZ;
+
+    // Inputs & outputs: the accumulated force and torque on each unit
+    std::vector<scalar_t> Fx, Fy, Fz;
+    std::vector<scalar_t> Tx, Ty, Tz;
+
+    // Make room for n units
+    void resize(size_t n);
+    size_t size() const { return vx.size(); }
+};
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ * File: FleetControl.cpp
+ * 
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the FleetControl class, defined in
+ *      FleetControl.hpp.
+ */
+
+// Import class definitions
+#include "FleetControl.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <unordered_map>
+
+
+const Transform::Vector Ypos(0.0, 1.0, 0.0);
+const Transform::Vector Zneg(0.0, 0.0, -1.0);
+
+// How close another unit must be before we try to steer clear of it
+const Transform::scalar_t AVOIDANCE_RADIUS = 0.5;
+
+// How many units a thread takes at a time during the AI pass
+const size_t AI_CHUNK_SIZE = 64;
+
+
+// The rotation taking the ground normal 'n' to +Y, which is the plane that
+// the drive kernel works in (i.e., the shortest rotation about n x Y)
+struct GroundFrame {
+    typedef Transform::scalar_t scalar_t;
+    typedef Transform::Vector Vector;
+
+    explicit GroundFrame(const Vector &n) {
+        scalar_t k = 1.0 / (1.0 + n[1]);
+        R[0][0] = 1.0 - k * n[0] * n[0];
+        R[0][1] = -n[0];
+        R[0][2] = -k * n[0] * n[2];
+        R[1][0] = n[0];  R[1][1] = n[1];  R[1][2] = n[2];
+        R[2][0] = R[0][2];
+        R[2][1] = -n[2];
+        R[2][2] = 1.0 - k * n[2] * n[2];
+    }
+
+    // Into & out of the ground's frame
+    Vector toGround(const Vector &v) const {
+        return Vector(R[0][0] * v[0] + R[0][1] * v[1] + R[0][2] * v[2],
+                      R[1][0] * v[0] + R[1][1] * v[1] + R[1][2] * v[2],
+                      R[2][0] * v[0] + R[2][1] * v[1] + R[2][2] * v[2]);
+    }
+    Vector fromGround(const Vector &v) const {
+        return Vector(R[0][0] * v[0] + R[1][0] * v[1] + R[2][0] * v[2],
+                      R[0][1] * v[0] + R[1][1] * v[1] + R[2][1] * v[2],
+                      R[0][2] * v[0] + R[1][2] * v[1] + R[2][2] * v[2]);
+    }
+
+    scalar_t R[3][3];
+};
+
+// Fleet membership (by state table slot)
+void FleetControl::addUnit(BattleUnitPtr bu, ObjectPtr rb) {
+    index_t s = bu->stateSlot();
+    if (s >= units.size()) {
+        units.resize(table->size());
+        rigidBodies.resize(table->size());
+    }
+    units[s] = bu;
+    rigidBodies[s] = rb;
+    table->stateIndex[s] = 0;       // Found on the next pass
+}
+
+void FleetControl::removeUnit(BattleUnitPtr bu) {
+    index_t s = bu->stateSlot();
+    if (s < units.size() && units[s] == bu) {
+        units[s] = BattleUnitPtr();
+        rigidBodies[s] = ObjectPtr();
+    }
+}
+
+
+// Make sure every unit knows where its body is in the SystemState
+void FleetControl::resolveIndices(const ObjectPtrList &objects) {
+    std::vector<index_t> &stateIndex = table->stateIndex;
+
+    // The common case is that nothing has moved
+    bool valid = true;
+    for (index_t u = 0; valid && u < units.size(); u++)
+        valid = units[u] == NULL
+             || (stateIndex[u] < objects.size()
+                 && objects[stateIndex[u]] == rigidBodies[u]);
+    if (valid)
+        return;
+
+    // Something has changed...re-map everybody in one pass over the bodies,
+    // rather than hunting down each unit separately
+    BATTLEFIELD_LOG(Debug, "Re-mapping state indices of " << units.size() << " unit slots");
+    std::unordered_map<const void *, index_t> indexOf;
+    indexOf.reserve(objects.size());
+    for (index_t i = 0; i < objects.size(); i++)
+        indexOf[&*objects[i]] = i;
+    for (index_t u = 0; u < units.size(); u++) {
+        if (units[u] == NULL)
+            continue;
+        std::unordered_map<const void *, index_t>::const_iterator found
+            = indexOf.find(&*rigidBodies[u]);
+        if (found != indexOf.end()) {
+            stateIndex[u] = found->second;
+        } else {
+            // Its body has left the system without it being removed from
+            // us. There's nothing for us to drive, so let it go.
+            BATTLEFIELD_LOG(Error, "Unit slot " << u << " has no body in the "
+                                   "system; no longer controlling it");
+            units[u] = BattleUnitPtr();
+            rigidBodies[u] = ObjectPtr();
+        }
+    }
+}
+
+
+// Determine our goal displacement and velocity within our coordinate frame
+void FleetControl::calculateGoal(index_t u) {
+    UnitStateTable &t = *table;
+    const BattleUnitPtr &battleUnit = units[u];
+    BattleUnitPtr target = battleUnit->target;
+    const Point &tLocation = *target->transform->locationPoint();
+    const Point &mLocation = *battleUnit->transform->locationPoint();
+    Vector tVelocity = target->rigidBody->P / t.mass[target->stateSlot()];
+    Vector mVelocity = battleUnit->rigidBody->P / t.mass[u];
+    const Quaternion &tRotation = target->transform->rotation();
+    const Quaternion &mRotation = battleUnit->transform->rotation();
+
+    const Vector &offset = battleUnit->targetOffset;
+    Point worldLocation;
+    if (battleUnit->relativeOffset) {
+        worldLocation = tLocation + tRotation.rotate(offset);
+    } else {
+        worldLocation = tLocation + offset;
+    }
+
+    Vector relativeDistance = worldLocation - *battleUnit->transform->locationPoint();
+    Vector relativeVelocity = tVelocity - mVelocity;
+
+//    if (battleUnit->selected())
+//        BATTLEFIELD_LOG(Trace, "Target is " << relativeDistance << " away, with relative V " << relativeVelocity);
+
+    t.goalDisplacement[u] = relativeDistance;
+    t.goalVelocity[u] = relativeVelocity;
+}
+
+
+// Set our controls (throttle, brake, wheels) in an attempt to meet the goal
+void FleetControl::tryToReachGoal(index_t u) {
+    UnitStateTable &t = *table;
+    const BattleUnitPtr &battleUnit = units[u];
+    scalar_t &throttle = t.throttle[u];
+    scalar_t &brake = t.brake[u];
+    scalar_t &wheelDeflection = t.wheelDeflection[u];
+
+    // Look up values
+    Vector myVelocity = battleUnit->rigidBody->P / t.mass[u];
+    const Vector &relDisplacement = t.goalDisplacement[u];
+    const Vector &relVelocity = t.goalVelocity[u];
+
+    // Calculate our metrics
+    scalar_t distance = magnitude(relDisplacement);
+    scalar_t relativeSpeed = magnitude(relVelocity);
+    scalar_t signedSpeed = dot(relVelocity, myVelocity);
+    scalar_t angleD = angle(Zneg, -relDisplacement, Ypos);
+    scalar_t angleV = angle(Zneg, relVelocity, Ypos);
+
+    // Pick velocity based on distance and relative velocity
+    if (relativeSpeed > 2.0)
+        throttle += 0.3;
+    else if (relativeSpeed < 0.5)
+        throttle -= 0.2;
+
+    if (distance > 1.0)
+        throttle += 0.3;
+    else if (distance < 0.5)
+        throttle -= 0.1;
+
+
+    // Pick turn angle based on angle to target
+    wheelDeflection = 2.0 * angleD / Transform::PI;
+
+    if (battleUnit->selected())
+        BATTLEFIELD_LOG_EVERY(Trace, 0.5, "AngleD: " << angleD);
+
+    if (throttle > 1.0)         throttle = 1.0;
+    else if (throttle < 0.0)    throttle = 0.0;
+
+    if (wheelDeflection > 1.0)          wheelDeflection = 1.0;
+    else if (wheelDeflection < -1.0)    wheelDeflection = -1.0;
+
+    if (brake > 1.0)            brake = 1.0;
+    else if (brake < 0.0)       brake = 0.0;
+}
+
+
+// Artificial intelligence function
+void FleetControl::modifyThirdDerivative(SystemState &delta,
+                                         SystemCalculation &calc,
+                                   const SystemState &prev,
+                                   const ObjectPtrList &objects) {
+    BATTLEFIELD_TIME_SCOPE("ai");
+    BATTLEFIELD_TRACE_SCOPE("ai");
+
+    // Make sure we know who's who
+    resolveIndices(objects);
+
+    // Index everybody's current position, so units can find their neighbours
+    if (grid->enabled()) {
+        grid->resize(objects.size());
+        for (index_t i = 0; i < objects.size(); i++)
+            grid->setPosition(i, prev[i].x);
+        grid->rebuild();
+    }
+
+    // Let each unit make up its mind (counting per chunk, so as not to
+    // fight over the counters)
+    auto thinkAbout = [&](size_t begin, size_t end) {
+        BATTLEFIELD_TRACE_SCOPE("ai chunk");
+        size_t thinkers = 0, neighbours = 0;
+        for (index_t u = begin; u < end; u++)
+            if (units[u] != NULL) {
+                neighbours += think(u, prev, objects);
+                thinkers++;
+            }
+        BATTLEFIELD_COUNT("units", thinkers);
+        BATTLEFIELD_COUNT("neighbours", neighbours);
+    };
+    if (workers != NULL)
+        workers->parallelFor(units.size(), AI_CHUNK_SIZE, thinkAbout);
+    else
+        thinkAbout(0, units.size());
+}
+
+size_t FleetControl::think(index_t u, const SystemState &prev,
+                                      const ObjectPtrList &objects) {
+    UnitStateTable &t = *table;
+    const BattleUnitPtr &battleUnit = units[u];
+    index_t myIndex = t.stateIndex[u];
+    size_t neighbours = 0;
+
+    if (battleUnit->manualControl()) {
+        // Don't step on the user's toes!
+        // Only think if we're not being thought for...
+
+    } else if (battleUnit->target != NULL) {
+        // First, we need to know where we're supposed to go
+        calculateGoal(u);
+#if 1
+        // Modify goal to avoid others
+        Vector newTarget(0.0);
+        index_t count = 0;
+        auto avoid = [&](index_t i) {
+            Vector diff = prev[myIndex].x - prev[i].x;
+            count++;
+            neighbours++;
+            newTarget += Vector(prev[i].x + 0.75 * diff);
+        };
+        if (grid->enabled()) {
+            // Only look at the units in the cells around us
+            grid->forEachNeighbour(myIndex, AVOIDANCE_RADIUS, avoid);
+        } else {
+            // No index...we have to check everybody
+            for (index_t i = 0; i < objects.size(); i++) {
+                if (i != myIndex) {
+                    Vector diff = prev[myIndex].x - prev[i].x;
+                    if (dot(diff, diff) < AVOIDANCE_RADIUS * AVOIDANCE_RADIUS)
+                        avoid(i);
+                }
+            }
+        }
+        if (dot(prev[myIndex].x, prev[myIndex].x) > 3 * 3) {    // Head back
+            newTarget += Vector(0.0, 0.0, 0.0);
+            count++;
+        }
+        if (count > 0) {        // Must take evasive action...
+            // Convert to me-space
+            newTarget = prev[myIndex].q.unrotate(newTarget - prev[myIndex].x)
+                      + t.goalDisplacement[u];
+            count++;
+            t.goalDisplacement[u] = newTarget / count;
+        }
+#endif
+        // Next, we must decide how to reach that
+        tryToReachGoal(u);
+
+    } else {
+        // Well...nothing to do but wander aimlessly
+        t.throttle[u] = 0.3;
+        UnitType type = battleUnit->unitType();
+        if (type == HumveeType || type == LightTankType)
+            t.wheelDeflection[u] = 0.7;
+        else
+            t.wheelDeflection[u] = -0.7;
+        if (dot(prev[myIndex].x, prev[myIndex].x) > 15) {
+            t.goalDisplacement[u] = Vector(0.0);
+            battleUnit->target = battleUnit;
+        }
+    }
+    return neighbours;
+}
+
+
+// Dynamics function
+void FleetControl::modifySecondDerivative(SystemState &delta,
+                                          SystemCalculation &calc,
+                                    const SystemState &prev,
+                                    const ObjectPtrList &objects) {
+    BATTLEFIELD_TIME_SCOPE("dynamics");
+    BATTLEFIELD_TRACE_SCOPE("dynamics");
+
+    // We can safely assume that the indices we resolved above are valid
+    const UnitStateTable &t = *table;
+    size_t n = units.size();
+    batch.resize(n);
+
+    // Gather what the kernel needs into packed arrays
+    for (index_t u = 0; u < n; u++) {
+        if (units[u] == NULL) {         // Nobody here...keep it harmless
+            batch.vx[u] = batch.vz[u] = batch.wy[u] = 0.0;
+            batch.frontX[u] = batch.frontY[u] = batch.frontZ[u] = 0.0;
+            batch.leftX[u] = batch.leftY[u] = batch.leftZ[u] = 0.0;
+            batch.Fx[u] = batch.Fy[u] = batch.Fz[u] = 0.0;
+            batch.Tx[u] = batch.Ty[u] = batch.Tz[u] = 0.0;
+            continue;
+        }
+
+        index_t i = t.stateIndex[u];
+        Vector front = units[u]->transform->front();
+        Vector left = units[u]->transform->left();
+        Vector v = calc[i].v, w = calc[i].w, F = calc[i].F, T = calc[i].T;
+
+        // On a slope, the kernel sees everything in the ground's frame
+        const Vector &normal = t.groundNormal[u];
+        if (normal[1] != 1.0) {
+            GroundFrame frame(normal);
+            front = frame.toGround(front);  left = frame.toGround(left);
+            v = frame.toGround(v);          w = frame.toGround(w);
+            F = frame.toGround(F);          T = frame.toGround(T);
+        }
+
+        // Linear velocity within the ground plane, and angular velocity
+        // w/r to the ground plane normal
+        batch.vx[u] = v[0];
+        batch.vz[u] = v[2];
+        batch.wy[u] = dot(w, Ypos);
+
+        batch.frontX[u] = front[0]; batch.frontY[u] = front[1]; batch.frontZ[u] = front[2];
+        batch.leftX[u] = left[0];   batch.leftY[u] = left[1];   batch.leftZ[u] = left[2];
+        batch.Fx[u] = F[0];         batch.Fy[u] = F[1];         batch.Fz[u] = F[2];
+        batch.Tx[u] = T[0];         batch.Ty[u] = T[1];         batch.Tz[u] = T[2];
+    }
+
+    // Engine, turning and friction forces for everybody at once
+    kernel(t, batch, 0, n);
+
+    // Scatter the results back out
+    for (index_t u = 0; u < n; u++) {
+        if (units[u] == NULL)
+            continue;
+
+        index_t i = t.stateIndex[u];
+        Vector F(batch.Fx[u], batch.Fy[u], batch.Fz[u]);
+        Vector T(batch.Tx[u], batch.Ty[u], batch.Tz[u]);
+        const Vector &normal = t.groundNormal[u];
+        if (normal[1] != 1.0) {
+            GroundFrame frame(normal);
+            F = frame.fromGround(F);
+            T = frame.fromGround(T);
+        }
+        calc[i].F[0] = F[0];    calc[i].F[1] = F[1];    calc[i].F[2] = F[2];
+        calc[i].T[0] = T[0];    calc[i].T[1] = T[1];    calc[i].T[2] = T[2];
+    }
+}
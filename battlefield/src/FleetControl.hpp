@@ -0,0 +1,113 @@
+/*
+ * File: FleetControl.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The FleetControl class drives every BattleUnit in the scene. It is a
+ *      single rigid-body operator that runs the artificial intelligence
+ *      (third derivative) and vehicle dynamics (second derivative) for the
+ *      whole fleet in one loop each, instead of one operator per unit.
+ *
+ *      It maintains the mapping from each unit to that unit's index in the
+ *      SystemState, and repairs it in a single pass whenever bodies are
+ *      added to or removed from the system. Units' per-step state is read
+ *      straight out of the UnitStateTable.
+ *
+ *      The drive kernel assumes level ground. On a slope, each unit's
+ *      velocities, axes and forces are turned into the frame of the ground
+ *      under it (as last found by the GroundConstraint) on the way in, and
+ *      the forces turned back on the way out.
+ *
+ *      Given a WorkerPool, the AI pass is spread across threads. Each unit's
+ *      decisions depend only on the previous SystemState and write only to
+ *      that unit's own controls, so the results are identical to a serial
+ *      run for any number of threads. ('scons determinism' checks this, by
+ *      recording a headless run on one thread and replaying it on eight.)
+ */
+
+#ifndef BATTLEFIELD_FLEET_CONTROL
+#define BATTLEFIELD_FLEET_CONTROL
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class FleetControl;
+
+    // Pointer type definitions
+    typedef shared_ptr<FleetControl> FleetControlPtr;
+};
+
+
+// Import other battle type definitions
+#include "BattleUnit.hpp"
+#include "SpatialGrid.hpp"
+#include "DriveKernel.hpp"
+#include "WorkerPool.hpp"
+
+
+class Battlefield::FleetControl
+             : public RigidBodySystem::ThirdDerivativeOperator,
+               public RigidBodySystem::SecondDerivativeOperator {
+public:
+    // Constructor
+    FleetControl(UnitStateTablePtr t, SpatialGridPtr g)
+        : table(t), grid(g), kernel(selectDriveKernel()) { }
+
+    // Fleet membership
+    void addUnit(BattleUnitPtr bu, ObjectPtr rb);
+    void removeUnit(BattleUnitPtr bu);
+    void reserve(size_t n) { units.reserve(n); rigidBodies.reserve(n); }
+
+    // Threads to use for the AI pass (NULL to run it serially)
+    void setWorkerPool(WorkerPoolPtr p) { workers = p; }
+
+    // Artificial intelligence functions (for the unit in slot 'u')
+    void calculateGoal(index_t u);
+    void tryToReachGoal(index_t u);
+    void modifyThirdDerivative(SystemState &delta,
+                               SystemCalculation &calc,
+                         const SystemState &prev,
+                         const ObjectPtrList &objects);
+
+    // Dynamics function, and the kernel that does the actual work (the
+    // fastest one for this processor, by default)
+    DriveKernel driveKernel() const { return kernel; }
+    void setDriveKernel(DriveKernel k) { kernel = k; }
+    void modifySecondDerivative(SystemState &delta,
+                                SystemCalculation &calc,
+                          const SystemState &prev,
+                          const ObjectPtrList &objects);
+
+protected:
+    // Make sure every unit knows where its body is in the SystemState
+    void resolveIndices(const ObjectPtrList &objects);
+
+    // Per-unit step of the fleet-wide AI pass. Returns how many
+    // neighbours the unit had to steer around.
+    size_t think(index_t u, const SystemState &prev,
+                            const ObjectPtrList &objects);
+
+    // The fleet's members and their bodies, indexed by state table slot
+    // (NULL for slots we're not driving)
+    std::vector<BattleUnitPtr> units;
+    std::vector<ObjectPtr>     rigidBodies;
+
+    UnitStateTablePtr table;
+    SpatialGridPtr grid;
+    WorkerPoolPtr workers;
+
+    // Packed per-step dynamics values
+    DriveBatch batch;
+    DriveKernel kernel;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * File: FrameCapture.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the FrameCapture class, defined in
+ *      FrameCapture.hpp.
+ */
+
+// Import class definition
+#include "FrameCapture.hpp"
+#include "WorkerPool.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+using namespace Battlefield;
+
+// Import STL & timing stuff
+#include <chrono>
+#include <thread>
+
+
+// Constructor
+FrameCapture::FrameCapture(FrameSinkPtr s, Policy p,
+                           size_t buffers, size_t encoderCount)
+        : frameSink(s), policy(p),
+          convert(selectPixelConverter()),
+          frameNumber(0), frameSequence(0), pending(0),
+          captured(0), dropped(0), stalled(0), written(0), failed(0),
+          stallNanoseconds(0) {
+    if (buffers == 0)
+        buffers = 1;
+    for (size_t i = 0; i < buffers; i++) {
+        frames.push_back(new Frame());
+        available.push_back(frames.back());
+    }
+
+    // Leave a core for the render thread. The pool counts the thread that
+    // calls parallelFor() as one of its own, so ask for one extra: that
+    // one never has anything to do, since we only ever submit().
+    if (encoderCount == 0) {
+        size_t cores = std::thread::hardware_concurrency();
+        encoderCount = (cores > 1 ? cores - 1 : 1);
+    }
+    encoders.reset(new WorkerPool(encoderCount + 1, "frame encoder"));
+}
+
+// Destructor
+FrameCapture::~FrameCapture() {
+    encoders.reset();       // Drains anything still queued up
+    frameSink->flush();
+    for (size_t i = 0; i < frames.size(); i++)
+        delete frames[i];
+}
+
+
+double FrameCapture::stalledSeconds() const {
+    return stallNanoseconds * 1e-9;
+}
+
+FrameCapture::Frame * FrameCapture::acquire(unsigned int w, unsigned int h) {
+    Frame *frame;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        size_t number = frameNumber++;
+        if (available.empty()) {
+            if (policy == DropFrames) {
+                dropped++;
+                return NULL;
+            }
+
+            // Wait for an encoder to give one back
+            typedef std::chrono::steady_clock Clock;
+            Clock::time_point start = Clock::now();
+            bufferFreed.wait(guard, [this] { return ! available.empty(); });
+            stalled++;
+            stallNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    Clock::now() - start).count();
+        }
+        frame = available.back();
+        available.pop_back();
+        frame->number = number;
+    }
+
+    // Resizing only allocates if the window has grown since last time
+    frame->width = w;
+    frame->height = h;
+    frame->pixels.resize(size_t(w) * h * 4);
+    return frame;
+}
+
+void FrameCapture::submit(Frame *frame) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        frame->sequence = frameSequence++;
+        pending++;
+    }
+    captured++;
+    encoders->submit([this, frame] { encode(frame); });
+}
+
+void FrameCapture::flush() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        frameFinished.wait(guard, [this] { return pending == 0; });
+    }
+    frameSink->flush();
+}
+
+void FrameCapture::encode(Frame *frame) {
+    BATTLEFIELD_TRACE_SCOPE("encode frame");
+    size_t number = frame->number, sequence = frame->sequence;
+    unsigned int w = frame->width, h = frame->height;
+    try {
+        // Convert, and then the buffer can go back into circulation while
+        // the sink does the (much slower) compression or writing
+        std::vector<unsigned char> rgb(size_t(w) * h * 3);
+        convert(&frame->pixels[0], &rgb[0], w, h);
+        release(frame);
+        frame = NULL;
+
+        frameSink->write(sequence, number, rgb, w, h);
+        written++;
+
+    } catch (Inca::IncaException &e) {
+        BATTLEFIELD_LOG(Error, "Couldn't write frame " << number << ": " << e);
+        frameSink->skip(sequence);
+        failed++;
+    } catch (std::exception &e) {
+        BATTLEFIELD_LOG(Error, "Couldn't write frame " << number << ": " << e.what());
+        frameSink->skip(sequence);
+        failed++;
+    }
+    if (frame != NULL)
+        release(frame);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending--;
+    }
+    frameFinished.notify_all();
+}
+
+void FrameCapture::release(Frame *frame) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        available.push_back(frame);
+    }
+    bufferFreed.notify_one();
+}
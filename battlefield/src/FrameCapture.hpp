@@ -0,0 +1,124 @@
+/*
+ * File: FrameCapture.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The FrameCapture class records the rendered frames into a FrameSink
+ *      (a series of image files, or a video stream), without holding up the
+ *      render thread.
+ *
+ *      The render thread reads each frame back into one of a small ring of
+ *      reusable buffers (acquire(), glReadPixels, submit()). The buffer is
+ *      then handed to a pool of encoder threads, which convert it to RGB,
+ *      turn it right side up, give the buffer back to the ring, and pass
+ *      the frame on to the sink.
+ *
+ *      If the encoders can't keep up, the ring runs dry. What happens then
+ *      depends on the policy: DropFrames skips capturing the frame (keeping
+ *      the frame rate up), while Backpressure waits for a buffer (keeping
+ *      every frame). Either way, it's counted.
+ */
+
+#ifndef BATTLEFIELD_FRAME_CAPTURE
+#define BATTLEFIELD_FRAME_CAPTURE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class FrameCapture;
+    class WorkerPool;
+
+    // Pointer type definitions
+    typedef shared_ptr<FrameCapture> FrameCapturePtr;
+};
+
+// Import the pixel converters and frame sinks
+#include "PixelConversion.hpp"
+#include "FrameSink.hpp"
+
+
+class Battlefield::FrameCapture {
+public:
+    // What to do when every buffer is still waiting to be encoded
+    enum Policy {
+        DropFrames,         // Skip this frame
+        Backpressure,       // Wait for the encoders to catch up
+    };
+
+    // A captured frame, as read back from OpenGL: BGRA, bottom row first
+    struct Frame {
+        std::vector<unsigned char> pixels;
+        unsigned int width, height;
+        size_t number;          // Counting every frame, captured or not
+        size_t sequence;        // Counting just the captured ones
+    };
+
+    // Constructor, giving where the frames go, what to do when we run short
+    // of buffers, how many buffers to keep and how many encoder threads to
+    // run (zero means one less than the number of cores, so the render
+    // thread keeps one).
+    FrameCapture(FrameSinkPtr sink, Policy policy = DropFrames,
+                 size_t buffers = 4, size_t encoders = 0);
+
+    // Destructor. Waits for every submitted frame to be written.
+    ~FrameCapture();
+
+    // Where the frames are going
+    FrameSinkPtr sink() const { return frameSink; }
+
+    // Get a buffer big enough for a w x h BGRA frame, or NULL if the frame
+    // is to be dropped. Every call counts as a frame, captured or not.
+    Frame * acquire(unsigned int w, unsigned int h);
+
+    // Hand a filled-in buffer off to be encoded and written
+    void submit(Frame *frame);
+
+    // Wait until every frame submitted so far has been handed to the sink,
+    // and then flush the sink
+    void flush();
+
+    // Counters
+    size_t capturedCount() const { return captured; }
+    size_t droppedCount() const { return dropped; }
+    size_t stalledCount() const { return stalled; }
+    double stalledSeconds() const;
+    size_t writtenCount() const { return written; }
+    size_t failedCount() const { return failed; }
+
+protected:
+    // Encoder-thread side of things
+    void encode(Frame *frame);
+    void release(Frame *frame);
+
+    FrameSinkPtr frameSink;
+    Policy policy;
+    PixelConverter convert;
+
+    // The ring of buffers. The ones not being filled or encoded are in
+    // 'available', guarded by 'lock', as is the count of frames submitted
+    // but not yet through the sink.
+    std::vector<Frame *> frames, available;
+    std::mutex lock;
+    std::condition_variable bufferFreed, frameFinished;
+    size_t frameNumber, frameSequence, pending;
+
+    std::atomic<size_t> captured, dropped, stalled, written, failed;
+    std::atomic<long long> stallNanoseconds;
+
+    // Declared last, so it's destroyed (and finishes its work) first
+    shared_ptr<WorkerPool> encoders;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * File: FrameSink.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the frame sinks defined in FrameSink.hpp.
+ */
+
+// Import class definitions
+#include "FrameSink.hpp"
+#include "Log.hpp"
+using namespace Battlefield;
+
+// Import STL & signal stuff
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#if __MS_WINDOZE__
+#   define popen  _popen
+#   define pclose _pclose
+#endif
+
+// How many digits go in an image's frame number
+const int FRAME_NUMBER_DIGITS = 6;
+
+// How much the stream buffers up between writes
+const size_t STREAM_BUFFER_SIZE = 4 * 1024 * 1024;
+
+
+/*---------------------------------------------------------------------------*
+ | ImageSequenceSink
+ *---------------------------------------------------------------------------*/
+ImageSequenceSink::ImageSequenceSink(const string &pre, const string &suff)
+    : prefix(pre), suffix(suff) { }
+
+void ImageSequenceSink::write(size_t sequence, size_t number,
+                              std::vector<unsigned char> &rgb,
+                              unsigned int width, unsigned int height) {
+    ImagePtr img(new ImageRGB(width, height));
+    std::memcpy(img->pixels().getContents(), &rgb[0], rgb.size());
+    Inca::IO::storeImage(img, filename(number));
+}
+
+string ImageSequenceSink::filename(size_t number) const {
+    std::ostringstream name;
+    name << prefix << std::setw(FRAME_NUMBER_DIGITS) << std::setfill('0')
+         << number << suffix;
+    return name.str();
+}
+
+
+/*---------------------------------------------------------------------------*
+ | VideoStreamSink
+ *---------------------------------------------------------------------------*/
+// Convert one top-down RGB frame to planar 4:2:0 YCbCr, using the integer
+// BT.601 (studio range) coefficients. Each chroma sample is the average of
+// a 2x2 block (or as much of it as there is, at odd edges).
+static void convertToYUV420(const unsigned char *rgb, unsigned int w,
+                            unsigned int h, std::vector<unsigned char> &yuv) {
+    unsigned int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    yuv.resize(size_t(w) * h + 2 * size_t(cw) * ch);
+    unsigned char *Y = &yuv[0],
+                  *U = Y + size_t(w) * h,
+                  *V = U + size_t(cw) * ch;
+
+    for (unsigned int y = 0; y < h; y++) {
+        const unsigned char *p = rgb + size_t(y) * w * 3;
+        unsigned char *row = Y + size_t(y) * w;
+        for (unsigned int x = 0; x < w; x++, p += 3)
+            row[x] = (unsigned char)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+    }
+
+    for (unsigned int cy = 0; cy < ch; cy++) {
+        unsigned int y0 = 2 * cy, y1 = std::min(y0 + 1, h - 1);
+        for (unsigned int cx = 0; cx < cw; cx++) {
+            unsigned int x0 = 2 * cx, x1 = std::min(x0 + 1, w - 1);
+            const unsigned char *a = rgb + (size_t(y0) * w + x0) * 3,
+                                *b = rgb + (size_t(y0) * w + x1) * 3,
+                                *c = rgb + (size_t(y1) * w + x0) * 3,
+                                *d = rgb + (size_t(y1) * w + x1) * 3;
+            int r = (a[0] + b[0] + c[0] + d[0] + 2) >> 2,
+                g = (a[1] + b[1] + c[1] + d[1] + 2) >> 2,
+                bl = (a[2] + b[2] + c[2] + d[2] + 2) >> 2;
+            U[size_t(cy) * cw + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * bl + 128) >> 8) + 128);
+            V[size_t(cy) * cw + cx] = (unsigned char)(((112 * r - 94 * g - 18 * bl + 128) >> 8) + 128);
+        }
+    }
+}
+
+VideoStreamSink::Format VideoStreamSink::formatFor(const string &t) {
+    const string raw = ".rgb";
+    if (t.size() >= raw.size() && t.compare(t.size() - raw.size(), raw.size(), raw) == 0)
+        return RawRGB;
+    return Y4M;
+}
+
+// Constructor
+VideoStreamSink::VideoStreamSink(const string &t, Format f, unsigned int fps)
+        : target(t), format(f), framesPerSecond(fps == 0 ? 30 : fps),
+          stream(NULL), piped(false), buffer(STREAM_BUFFER_SIZE),
+          previousPipeHandler(SIG_DFL), streamWidth(0), streamHeight(0), nextSequence(0),
+          written(0), failed(false) {
+    if (target == "-") {
+        stream = stdout;
+    } else if (! target.empty() && target[0] == '|') {
+        stream = popen(target.c_str() + 1, "w");
+        piped = true;
+    } else {
+        stream = std::fopen(target.c_str(), "wb");
+    }
+
+    if (stream == NULL) {
+        BATTLEFIELD_LOG(Error, "Couldn't open capture stream " << target);
+        return;
+    }
+    std::setvbuf(stream, &buffer[0], _IOFBF, buffer.size());
+
+#ifdef SIGPIPE
+    // If whoever's reading goes away, we want to hear about it from the
+    // writes, not be killed
+    if (piped || stream == stdout)
+        previousPipeHandler = std::signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+// Destructor
+VideoStreamSink::~VideoStreamSink() {
+    if (stream == NULL)
+        return;
+    flush();
+    if (! waiting.empty())
+        BATTLEFIELD_LOG(Warning, "Capture stream " << target << " closed with "
+                                 << waiting.size() << " frames out of order");
+    if (stream == stdout)   std::fflush(stream);
+    else if (piped)         pclose(stream);
+    else                    std::fclose(stream);
+
+#ifdef SIGPIPE
+    if (piped || stream == stdout)
+        std::signal(SIGPIPE, previousPipeHandler);
+#endif
+}
+
+
+void VideoStreamSink::write(size_t sequence, size_t number,
+                            std::vector<unsigned char> &rgb,
+                            unsigned int width, unsigned int height) {
+    // The first frame to get here decides the size of the whole stream
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (streamWidth == 0) {
+            streamWidth = width;
+            streamHeight = height;
+        }
+    }
+    fitFrame(rgb, width, height);
+
+    // Do the conversion here, before getting in line
+    std::vector<unsigned char> payload;
+    if (format == Y4M)  convertToYUV420(&rgb[0], streamWidth, streamHeight, payload);
+    else                payload.swap(rgb);
+
+    std::lock_guard<std::mutex> guard(lock);
+    deliver(sequence, payload);
+}
+
+void VideoStreamSink::skip(size_t sequence) {
+    std::vector<unsigned char> nothing;
+    std::lock_guard<std::mutex> guard(lock);
+    deliver(sequence, nothing);
+}
+
+void VideoStreamSink::flush() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (stream != NULL && ! failed && std::fflush(stream) != 0)
+        writeFailed();
+}
+
+void VideoStreamSink::writeFailed() {
+    if (errno == EPIPE)
+        BATTLEFIELD_LOG(Error, "Capture stream " << target << " was closed by its "
+                               "reader; not recording any more");
+    else
+        BATTLEFIELD_LOG(Error, "Couldn't write to capture stream " << target
+                               << ": " << std::strerror(errno));
+    failed = true;
+}
+
+// Crop or pad (with black) a frame that's not the size of the stream, which
+// happens if the window gets resized while we're recording
+void VideoStreamSink::fitFrame(std::vector<unsigned char> &rgb,
+                               unsigned int width, unsigned int height) const {
+    if (width == streamWidth && height == streamHeight)
+        return;
+
+    std::vector<unsigned char> fitted(size_t(streamWidth) * streamHeight * 3, 0);
+    size_t rowBytes = size_t(std::min(width, streamWidth)) * 3;
+    for (unsigned int y = 0; y < std::min(height, streamHeight); y++)
+        std::memcpy(&fitted[size_t(y) * streamWidth * 3],
+                    &rgb[size_t(y) * width * 3], rowBytes);
+    rgb.swap(fitted);
+}
+
+void VideoStreamSink::deliver(size_t sequence, std::vector<unsigned char> &payload) {
+    if (sequence != nextSequence) {
+        waiting[sequence].swap(payload);
+        return;
+    }
+
+    // Write this one, and then any that were waiting on it
+    std::vector<unsigned char> next;
+    while (true) {
+        if (! payload.empty() && stream != NULL && ! failed) {
+            if (written == 0 && format == Y4M) {
+                std::ostringstream header;
+                header << "YUV4MPEG2 W" << streamWidth << " H" << streamHeight
+                       << " F" << framesPerSecond << ":1 Ip A1:1 C420jpeg\n";
+                string h = header.str();
+                std::fwrite(h.data(), 1, h.size(), stream);
+                written += h.size();
+            }
+            if (format == Y4M) {
+                std::fwrite("FRAME\n", 1, 6, stream);
+                written += 6;
+            }
+            if (std::fwrite(&payload[0], 1, payload.size(), stream) != payload.size()
+                    || std::ferror(stream))
+                writeFailed();
+            else
+                written += payload.size();
+        }
+        nextSequence++;
+
+        std::map<size_t, std::vector<unsigned char> >::iterator i
+            = waiting.find(nextSequence);
+        if (i == waiting.end())
+            break;
+        next.swap(i->second);
+        waiting.erase(i);
+        payload.swap(next);
+    }
+}
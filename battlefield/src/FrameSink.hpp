@@ -0,0 +1,149 @@
+/*
+ * File: FrameSink.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      A FrameSink is where captured frames end up. FrameCapture's encoder
+ *      threads hand each frame to the sink as RGB, top row first, and
+ *      several of them may do so at once, in no particular order.
+ *
+ *      The ImageSequenceSink writes one image file per frame (JPEG or PNG,
+ *      according to the suffix), just like the capture always used to.
+ *
+ *      The VideoStreamSink writes every frame into a single stream, either
+ *      as YUV4MPEG2 (which most video encoders will take as-is) or as bare
+ *      RGB bytes. The stream can be a file, a named pipe, a command to pipe
+ *      into (written as "|command") or standard output (written as "-").
+ *      Frames are put back in order before they're written, and the writes
+ *      are big and sequential, so there's no per-frame filesystem cost.
+ *
+ *      While a pipe (or standard output, which may be one) is open, SIGPIPE
+ *      is ignored, so that the reader quitting makes the writes fail rather
+ *      than killing the program. Recording just stops, and says so.
+ */
+
+#ifndef BATTLEFIELD_FRAME_SINK
+#define BATTLEFIELD_FRAME_SINK
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <mutex>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class FrameSink;
+    class ImageSequenceSink;
+    class VideoStreamSink;
+
+    // Pointer type definitions
+    typedef shared_ptr<FrameSink> FrameSinkPtr;
+    typedef shared_ptr<ImageSequenceSink> ImageSequenceSinkPtr;
+    typedef shared_ptr<VideoStreamSink> VideoStreamSinkPtr;
+};
+
+
+class Battlefield::FrameSink {
+public:
+    virtual ~FrameSink() { }
+
+    // Take frame 'number' (counting every frame rendered while capturing),
+    // which is the 'sequence'th frame actually captured. The sink may keep
+    // (swap out) the contents of 'rgb'.
+    virtual void write(size_t sequence, size_t number,
+                       std::vector<unsigned char> &rgb,
+                       unsigned int width, unsigned int height) = 0;
+
+    // The 'sequence'th frame couldn't be produced, so don't wait for it
+    virtual void skip(size_t sequence) { }
+
+    // Push anything buffered out to wherever it's going
+    virtual void flush() { }
+};
+
+
+class Battlefield::ImageSequenceSink : public FrameSink {
+public:
+    // Constructor, giving the filename pattern: prefix + frame number +
+    // suffix (which also picks the image format)
+    ImageSequenceSink(const string &prefix, const string &suffix);
+
+    void write(size_t sequence, size_t number, std::vector<unsigned char> &rgb,
+               unsigned int width, unsigned int height);
+
+protected:
+    string filename(size_t number) const;
+
+    string prefix, suffix;
+};
+
+
+class Battlefield::VideoStreamSink : public FrameSink {
+public:
+    // How to lay the frames out in the stream
+    enum Format {
+        Y4M,        // YUV4MPEG2, 4:2:0, BT.601
+        RawRGB,     // Just the pixels, 3 bytes each, no header
+    };
+
+    // Guess the format from the target name (".rgb" means RawRGB)
+    static Format formatFor(const string &target);
+
+    // Constructor, giving where to write to (a file, "|command" or "-"),
+    // the layout and the nominal frame rate to record in the header.
+    // Check isOpen() afterward to see if that worked.
+    VideoStreamSink(const string &target, Format format = Y4M,
+                    unsigned int framesPerSecond = 30);
+
+    // Destructor. Writes out whatever's in order and closes the stream.
+    ~VideoStreamSink();
+
+    void write(size_t sequence, size_t number, std::vector<unsigned char> &rgb,
+               unsigned int width, unsigned int height);
+    void skip(size_t sequence);
+    void flush();
+
+    bool isOpen() const { return stream != NULL; }
+
+    // How many bytes have gone into the stream so far
+    size_t bytesWritten() const { return written; }
+
+protected:
+    // Make the frame the size the stream started out with
+    void fitFrame(std::vector<unsigned char> &rgb,
+                  unsigned int width, unsigned int height) const;
+
+    // Put a finished frame in line, and write out whatever's now in order.
+    // An empty payload means a skipped frame. Call with 'lock' held.
+    void deliver(size_t sequence, std::vector<unsigned char> &payload);
+
+    // Note that the stream can't be written to any more. Call with 'lock'
+    // held.
+    void writeFailed();
+
+    string target;
+    Format format;
+    unsigned int framesPerSecond;
+    std::FILE * stream;
+    bool piped;
+    std::vector<char> buffer;               // stdio's buffer for 'stream'
+    void (*previousPipeHandler)(int);       // SIGPIPE's, while we ignore it
+
+    // Everything below is guarded by 'lock'
+    std::mutex lock;
+    unsigned int streamWidth, streamHeight; // Fixed by the first frame
+    size_t nextSequence;                    // The next one to write out
+    std::map<size_t, std::vector<unsigned char> > waiting;
+    size_t written;
+    bool failed;
+};
+
+#endif
@@ -25,9 +25,12 @@ const string WINDOW_TITLE = "Battlefield";
 const size_t WINDOW_WIDTH  = 648;
 const size_t WINDOW_HEIGHT = 486;
 const bool FULL_SCREEN = false;
-const bool FRAME_CAPTURE = true;
+const bool FRAME_CAPTURE = false;
 const string FRAME_PREFIX = "frame";
 const string FRAME_SUFFIX = ".jpg";
+const string CAPTURE_STREAM = "";       // e.g., "battle.y4m", "-" or "|x264 ..."
+const unsigned int CAPTURE_RATE = 30;
+const string INPUT_LOG = "";            // e.g., "session.bfi", for replaying later
 
 
 // Import the main application class definition
@@ -49,8 +52,11 @@ public:
         window->setWidget(battleViewWidget.get());
         window->setFullScreen(FULL_SCREEN);
         battleViewWidget->setFilenamePattern(FRAME_PREFIX, FRAME_SUFFIX);
+        battleViewWidget->setCaptureStream(CAPTURE_STREAM, CAPTURE_RATE);
         if (FRAME_CAPTURE)
             battleViewWidget->toggleFrameCapture();
+        if (! INPUT_LOG.empty())
+            startRecording(INPUT_LOG);
     }
 
 protected:
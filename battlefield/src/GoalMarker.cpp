@@ -0,0 +1,127 @@
+/*
+ * File: GoalMarker.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the GoalMarker class, defined in GoalMarker.hpp.
+ */
+
+// Import class definition
+#include "GoalMarker.hpp"
+#include "Metrics.hpp"
+using namespace Battlefield;
+
+
+// Appearance for goal marker
+const Material::Color GOAL_COLOR(1.0f, 0.0f, 0.0f);
+const Transform::scalar_t GOAL_RADIUS = 1.0;
+const Transform::scalar_t GOAL_RAD_2_2 = GOAL_RADIUS * Transform::sqrt(2.0) / 2.0;
+const Transform::scalar_t GOAL_MAJOR_TICK_2 = 0.75;
+const Transform::scalar_t GOAL_MINOR_TICK_2 = 0.25;
+const Transform::scalar_t GOAL_MINOR_TICK_2_4 = GOAL_MINOR_TICK_2 * Transform::sqrt(2.0) / 2.0;
+const Transform::scalar_t GOAL_ELEVATION = 0.01;
+const Transform::scalar_t GOAL_SCALE = 0.3;
+const Transform::Point GOAL_VERTICES[] = {
+    Transform::Point(GOAL_RADIUS, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
+    Transform::Point(GOAL_RAD_2_2, GOAL_ELEVATION, -GOAL_RAD_2_2) * GOAL_SCALE,
+    Transform::Point(0.0, GOAL_ELEVATION, -GOAL_RADIUS) * GOAL_SCALE,
+    Transform::Point(-GOAL_RAD_2_2, GOAL_ELEVATION, -GOAL_RAD_2_2) * GOAL_SCALE,
+    Transform::Point(-GOAL_RADIUS, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
+    Transform::Point(-GOAL_RAD_2_2, GOAL_ELEVATION, GOAL_RAD_2_2) * GOAL_SCALE,
+    Transform::Point(0.0, GOAL_ELEVATION, GOAL_RADIUS) * GOAL_SCALE,
+    Transform::Point(GOAL_RAD_2_2, GOAL_ELEVATION, GOAL_RAD_2_2) * GOAL_SCALE,
+
+    Transform::Point(GOAL_RADIUS + GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
+    Transform::Point(GOAL_RADIUS - GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
+    Transform::Point(0.0, GOAL_ELEVATION, -GOAL_RADIUS - GOAL_MAJOR_TICK_2) * GOAL_SCALE,
+    Transform::Point(0.0, GOAL_ELEVATION, -GOAL_RADIUS + GOAL_MAJOR_TICK_2) * GOAL_SCALE,
+    Transform::Point(-GOAL_RADIUS - GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
+    Transform::Point(-GOAL_RADIUS + GOAL_MAJOR_TICK_2, GOAL_ELEVATION, 0.0) * GOAL_SCALE,
+    Transform::Point(0.0, GOAL_ELEVATION, GOAL_RADIUS + GOAL_MAJOR_TICK_2) * GOAL_SCALE,
+    Transform::Point(0.0, GOAL_ELEVATION, GOAL_RADIUS - GOAL_MAJOR_TICK_2) * GOAL_SCALE,
+
+    Transform::Point(GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     -GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     -GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(-GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     -GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(-GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     -GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(-GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(-GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     GOAL_RAD_2_2 + GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+    Transform::Point(GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4, GOAL_ELEVATION,
+                     GOAL_RAD_2_2 - GOAL_MINOR_TICK_2_4) * GOAL_SCALE,
+};
+const index_t GOAL_VERTEX_COUNT = 24;
+
+// Which vertices to join up: the circle, then the major ticks, then the
+// minor ticks
+const index_t GOAL_LINES[][2] = {
+    {  0,  1 }, {  1,  2 }, {  2,  3 }, {  3,  4 },
+    {  4,  5 }, {  5,  6 }, {  6,  7 }, {  7,  0 },
+    {  8,  9 }, { 10, 11 }, { 12, 13 }, { 14, 15 },
+    { 16, 17 }, { 18, 19 }, { 20, 21 }, { 22, 23 },
+};
+const index_t GOAL_LINE_COUNT = 16;
+
+// Every marker is drawn with the same material
+static MaterialPtr createGoalMaterial() {
+    MaterialPtr mat(new Material());
+    mat->illuminated = false;
+    mat->diffuse = GOAL_COLOR;
+    return mat;
+}
+
+
+// Constructor
+GoalMarker::GoalMarker() : visible(false), drawn(false), built(false) {
+    static MaterialPtr material = createGoalMaterial();
+    addMaterial(material);
+}
+
+void GoalMarker::place(const Point &goal, const Transform::Quaternion &rotation) {
+    // Slide over to it, rather than making a new location every frame
+    transform->translate(goal - *transform->locationPoint());
+    transform->setRotation(rotation);
+    visible = true;
+}
+
+void GoalMarker::updateTessellation(const Point &view, const Vector &look) {
+    // Do the normal tessellation update
+    SolidObject3D::updateTessellation(view, look);
+
+    Tessellation &tess = *tessellation;
+    if (! built) {
+        vertices.resize(GOAL_VERTEX_COUNT);
+        for (index_t i = 0; i < GOAL_VERTEX_COUNT; i++)
+            vertices[i] = tess.addVertex(GOAL_VERTICES[i]);
+        built = true;
+    }
+
+    // Put our lines in (or take them out) only when that changes
+    if (drawn != visible) {
+        Tessellation::LineGroup &lineGroup = tess.lineGroup(0);
+        lineGroup.clear();
+        if (visible) {
+            Tessellation::Line line;
+            for (index_t i = 0; i < GOAL_LINE_COUNT; i++) {
+                line.v[0] = vertices[GOAL_LINES[i][0]];
+                line.v[1] = vertices[GOAL_LINES[i][1]];
+                lineGroup.push_back(line);
+            }
+        }
+        drawn = visible;
+    }
+
+    // What we're drawing this frame
+    if (drawn)
+        BATTLEFIELD_COUNT("goal marker vertices", GOAL_VERTEX_COUNT);
+}
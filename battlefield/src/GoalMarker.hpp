@@ -0,0 +1,57 @@
+/*
+ * File: GoalMarker.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The GoalMarker is the little crosshair drawn on the ground where a
+ *      unit is trying to get to. Its lines are built once, in its own
+ *      coordinate frame, and after that it's only ever moved around (to the
+ *      goal point, turned to match the unit's target) and shown or hidden.
+ */
+
+#ifndef BATTLEFIELD_GOAL_MARKER
+#define BATTLEFIELD_GOAL_MARKER
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class GoalMarker;
+
+    // Pointer type definitions
+    typedef shared_ptr<GoalMarker> GoalMarkerPtr;
+};
+
+
+class Battlefield::GoalMarker : public Inca::World::SolidObject3D {
+public:
+    // Constructor
+    GoalMarker();
+
+    // Put the marker at 'goal', turned to 'rotation', and show it
+    void place(const Point &goal, const Transform::Quaternion &rotation);
+
+    // Hide the marker (it reappears on the next place())
+    void hide() { visible = false; }
+    bool isVisible() const { return visible; }
+
+    // Build our lines the first time, and afterward only add or remove
+    // them when we're shown or hidden
+    void updateTessellation(const Point &view, const Vector &look);
+
+protected:
+    bool visible;           // Should we be drawn?
+    bool drawn;             // Are our lines in the tessellation?
+    bool built;             // Are our vertices in the tessellation?
+    std::vector<index_t> vertices;
+};
+
+#endif
@@ -6,7 +6,10 @@
  * Copyright 2003, Ryan L. Saunders. All rights reserved.
  *
  * Description:
- *
+ *      The GroundConstraint class keeps every unit on top of the Terrain.
+ *      Each step, it looks up the ground under where all of the units are
+ *      headed in one batch, lifts anybody who'd end up underground, and
+ *      records the ground's normal under each unit for the FleetControl.
  */
 
 #ifndef BATTLEFIELD_GROUND_CONSTRAINT
@@ -24,32 +27,81 @@ namespace Battlefield {
 
 // Import other battle type definitions
 #include "BattleUnit.hpp"
+#include "Terrain.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+
+// Import STL
+#include <vector>
 
 
 class Battlefield::GroundConstraint
              : public RigidBodySystem::ZerothDerivativeOperator {
 public:
     // Constructor
-    GroundConstraint(scalar_arg_t ge) : groundElevation(ge) { }
+    GroundConstraint(TerrainPtr g, UnitStateTablePtr t)
+        : ground(g), table(t) { }
+
+    // The ground we're keeping everybody on
+    TerrainPtr terrain() const { return ground; }
 
     // Dynamics function
     void modifyZerothDerivative(SystemState &delta,
                                 SystemCalculation &calc,
                           const SystemState &prev,
                           const ObjectPtrList &objects) {
-        for (index_t i = 0; i < objects.size(); i++) {
-            BattleUnitPtr bu = static_pointer_cast<BattleUnit>(objects[i]->worldObject);
+        BATTLEFIELD_TIME_SCOPE("constraints");
+        BATTLEFIELD_TRACE_SCOPE("constraints");
+        UnitStateTable &t = *table;
+        size_t n = t.size();
+        if (n == 0)
+            return;
+        resize(n);
+
+        // Where is everybody headed?
+        for (index_t s = 0; s < n; s++) {
+            if (t.unit[s] == NULL) {        // Nobody here...look anywhere
+                x[s] = z[s] = 0.0;
+                continue;
+            }
+            index_t i = t.stateIndex[s];
+            x[s] = prev[i].x[0] + delta[i].x[0];
+            z[s] = prev[i].x[2] + delta[i].x[2];
+        }
+
+        // What's the ground like there?
+        ground->heightsAndNormals(n, &x[0], &z[0], &h[0], &nx[0], &ny[0], &nz[0]);
+
+        for (index_t s = 0; s < n; s++) {
+            if (t.unit[s] == NULL)
+                continue;
+
+            index_t i = t.stateIndex[s];
             scalar_t projectedElev = prev[i].x[1] + delta[i].x[1];
-            scalar_t groundElev = bu->elevationOffset + groundElevation;
+            scalar_t groundElev = t.elevationOffset[s] + h[s];
 
             // Force non-penetration
             if (projectedElev < groundElev)
                 delta[i].x[1] = groundElev - prev[i].x[1];
+
+            t.groundNormal[s] = UnitStateTable::Vector(nx[s], ny[s], nz[s]);
         }
     }
 
 protected:
-    scalar_t groundElevation;
+    // Make room for n units' queries
+    void resize(size_t n) {
+        if (x.size() >= n)
+            return;
+        x.resize(n);    z.resize(n);    h.resize(n);
+        nx.resize(n);   ny.resize(n);   nz.resize(n);
+    }
+
+    TerrainPtr ground;
+    UnitStateTablePtr table;
+
+    // Packed ground queries, parallel to the UnitStateTable
+    std::vector<scalar_t> x, z, h, nx, ny, nz;
 };
 
 #endif
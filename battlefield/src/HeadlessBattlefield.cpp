@@ -0,0 +1,319 @@
+/*
+ * File: HeadlessBattlefield.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file contains the main() function for the headless battlefield,
+ *      which runs the simulation in batch (no window, no OpenGL) at a fixed
+ *      time step, as fast as the machine will go, and then reports where
+ *      everybody ended up and how long it took.
+ */
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the Battlefield class definitions
+#include "BattleScene.hpp"
+#include "Metrics.hpp"
+#include "ModelCache.hpp"
+#include "ScenarioLoader.hpp"
+#include "Trace.hpp"
+using namespace Battlefield;
+
+// Import STL & timing stuff
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Default run parameters
+const size_t DEFAULT_UNITS     = 0;         // Zero means the standard team
+const double DEFAULT_DURATION  = 60.0;
+const unsigned int DEFAULT_SEED = 1;
+const double DEFAULT_TIME_STEP = 0.05;
+const size_t DEFAULT_THREADS   = 0;         // Zero means one per core
+const Transform::scalar_t UNIT_SPACING = 0.4;
+
+
+void printUsage(const char *program) {
+    std::fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --units N       number of units in the army (0 = the standard team)\n"
+        "  --scenario FILE set the battle up from a scenario file instead\n"
+        "  --terrain IMAGE shape the ground like a greyscale image (a replay\n"
+        "                  must be given the same one it was recorded with)\n"
+        "  --duration S    simulated seconds to run for (default %g)\n"
+        "  --seed N        random seed for the army layout (default %u)\n"
+        "  --dt S          simulation time step (default %g)\n"
+        "  --threads N     threads for the AI pass (0 = one per core)\n"
+        "  --dump          print the final state of every unit\n"
+        "  --metrics FILE  write per-phase timings & counters as CSV ('-' for stdout)\n"
+        "  --trace FILE    record a timeline of every thread as Chrome trace JSON\n"
+        "  --record FILE   log the run's steps (and any control changes) for replay\n"
+        "  --replay FILE   re-run a logged session as fast as possible, ignoring\n"
+        "                  --units, --seed, --duration and --dt\n"
+        "  --restore FILE  start from a checkpoint instead of a new battle\n"
+        "  --checkpoint FILE\n"
+        "                  save the battle as it is at the end of the run\n",
+        program, DEFAULT_DURATION, DEFAULT_SEED, DEFAULT_TIME_STEP);
+}
+
+// Print the state of one unit: location, heading and speed
+void printUnit(size_t i, BattleUnitPtr unit) {
+    const Transform::Point &p = *unit->transform->locationPoint();
+    const Transform::Vector &f = unit->transform->front();
+    Transform::Vector v = unit->rigidBody->P / Transform::scalar_t(unit->mass);
+    std::printf("unit %6u at (%9.4f, %9.4f, %9.4f) facing (%7.4f, %7.4f)"
+                " speed %7.4f\n", unsigned(i),
+                double(p[0]), double(p[1]), double(p[2]),
+                double(f[0]), double(f[2]), double(magnitude(v)));
+}
+
+
+/*****************************************************************************
+ * Headless main() entry function -- parses the command line, builds the
+ * battle and steps it until the requested time has passed.
+ *****************************************************************************/
+int main(int argc, char **argv) {
+    size_t units = DEFAULT_UNITS, threads = DEFAULT_THREADS;
+    double duration = DEFAULT_DURATION, dt = DEFAULT_TIME_STEP;
+    unsigned int seed = DEFAULT_SEED;
+    bool dump = false;
+    const char *metricsFile = NULL, *traceFile = NULL;
+    const char *recordFile = NULL, *replayFile = NULL;
+    const char *restoreFile = NULL, *checkpointFile = NULL;
+    const char *scenarioFile = NULL, *terrainImage = "";
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (std::strcmp(arg, "--units") == 0 && hasValue)
+            units = size_t(std::strtoul(argv[++i], NULL, 10));
+        else if (std::strcmp(arg, "--scenario") == 0 && hasValue)
+            scenarioFile = argv[++i];
+        else if (std::strcmp(arg, "--terrain") == 0 && hasValue)
+            terrainImage = argv[++i];
+        else if (std::strcmp(arg, "--duration") == 0 && hasValue)
+            duration = std::strtod(argv[++i], NULL);
+        else if (std::strcmp(arg, "--seed") == 0 && hasValue)
+            seed = unsigned(std::strtoul(argv[++i], NULL, 10));
+        else if (std::strcmp(arg, "--dt") == 0 && hasValue)
+            dt = std::strtod(argv[++i], NULL);
+        else if (std::strcmp(arg, "--threads") == 0 && hasValue)
+            threads = size_t(std::strtoul(argv[++i], NULL, 10));
+        else if (std::strcmp(arg, "--dump") == 0)
+            dump = true;
+        else if (std::strcmp(arg, "--metrics") == 0 && hasValue)
+            metricsFile = argv[++i];
+        else if (std::strcmp(arg, "--trace") == 0 && hasValue)
+            traceFile = argv[++i];
+        else if (std::strcmp(arg, "--record") == 0 && hasValue)
+            recordFile = argv[++i];
+        else if (std::strcmp(arg, "--replay") == 0 && hasValue)
+            replayFile = argv[++i];
+        else if (std::strcmp(arg, "--restore") == 0 && hasValue)
+            restoreFile = argv[++i];
+        else if (std::strcmp(arg, "--checkpoint") == 0 && hasValue)
+            checkpointFile = argv[++i];
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (dt <= 0.0 || duration < 0.0) {
+        std::fprintf(stderr, "%s: --dt must be positive and --duration "
+                             "non-negative\n", argv[0]);
+        return 1;
+    }
+    if ((restoreFile != NULL || scenarioFile != NULL)
+            && (recordFile != NULL || replayFile != NULL)) {
+        std::fprintf(stderr, "%s: input logs start from a generated battle, so "
+                             "can't be used with --restore or --scenario\n", argv[0]);
+        return 1;
+    }
+    if (restoreFile != NULL && scenarioFile != NULL) {
+        std::fprintf(stderr, "%s: --restore and --scenario both set up the "
+                             "battle; pick one\n", argv[0]);
+        return 1;
+    }
+
+    // A replay runs whatever battle the log was recorded in
+    shared_ptr<InputReplay> replay;
+    Transform::scalar_t spacing = UNIT_SPACING;
+    if (replayFile != NULL) {
+        replay.reset(new InputReplay(replayFile));
+        if (! replay->isOpen()) {
+            std::fprintf(stderr, "%s: %s isn't a readable input log\n", argv[0], replayFile);
+            return 1;
+        }
+        units = replay->header().units;
+        seed = replay->header().seed;
+        spacing = replay->header().spacing;
+    }
+
+    // Start recording before anything happens, so setup is in there too
+    if (traceFile != NULL) {
+        Tracer::nameThread("main");
+        Tracer::start();
+    }
+
+    // Set up the battle
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point setupStart = Clock::now();
+    BattleScenePtr scene(new BattleScene(terrainImage));
+    scene->setThreadCount(threads);
+    if (restoreFile != NULL) {
+        if (! scene->restore(restoreFile)) {
+            std::fprintf(stderr, "%s: couldn't restore from %s\n", argv[0], restoreFile);
+            return 1;
+        }
+    } else if (scenarioFile != NULL) {
+        if (! ScenarioLoader(scene).load(scenarioFile)) {
+            std::fprintf(stderr, "%s: couldn't load %s\n", argv[0], scenarioFile);
+            return 1;
+        }
+    } else if (units == 0) {
+        scene->createTeam();
+    } else {
+        scene->createArmy(units, spacing, seed);
+    }
+    size_t count = scene->battleUnitCount();
+    double startTime = scene->simulationTime();
+
+    // There's nothing drawn, so as far as the metrics go, each step is a frame
+    auto step = [&](double time) {
+        scene->update(time);
+        Metrics::instance().endFrame();
+    };
+    step(startTime);
+    double setupTime = std::chrono::duration<double>(Clock::now() - setupStart).count();
+
+    if (recordFile != NULL) {
+        InputRecorderPtr recorder(new InputRecorder(recordFile, uint32_t(units),
+                                                    seed, spacing));
+        if (! recorder->isOpen()) {
+            std::fprintf(stderr, "%s: couldn't write %s\n", argv[0], recordFile);
+            return 1;
+        }
+        scene->setRecorder(recorder);
+    }
+
+    // Run it. Step count is worked out up front so that 'time' doesn't drift.
+    size_t steps = 0;
+    double simulated = 0.0;
+    bool matched = true;
+    Clock::time_point start = Clock::now();
+    if (replay != NULL) {
+        // Feed the log back in, step for step
+        bool done = false;
+        while (! done) {
+            switch (replay->next()) {
+                case InputReplay::Control:
+                    scene->queueControl(replay->control());
+                    break;
+                case InputReplay::Step:
+                    simulated = replay->time();
+                    step(simulated);
+                    steps++;
+                    break;
+                case InputReplay::End:
+                    matched = (replay->steps() == steps
+                               && replay->hash() == scene->stateHash());
+                    done = true;
+                    break;
+                case InputReplay::Truncated:
+                case InputReplay::Corrupt:
+                    std::fprintf(stderr, "%s: %s ends early or is damaged; replayed "
+                                 "%u steps\n", argv[0], replayFile, unsigned(steps));
+                    matched = false;
+                    done = true;
+                    break;
+            }
+        }
+    } else {
+        steps = size_t(duration / dt + 0.5);
+        for (size_t s = 1; s <= steps; s++)
+            step(startTime + s * dt);
+        simulated = steps * dt;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    scene->setRecorder(InputRecorderPtr());     // Finishes off any log
+
+    // Save where we got to. Only the copying out holds up the simulation;
+    // the rest happens in the background.
+    double snapshotTime = 0.0;
+    std::shared_future<bool> checkpointWritten;
+    if (checkpointFile != NULL) {
+        Clock::time_point snapshotStart = Clock::now();
+        checkpointWritten = scene->checkpoint(checkpointFile);
+        snapshotTime = std::chrono::duration<double>(Clock::now() - snapshotStart).count();
+    }
+
+    // Report where everybody ended up
+    Transform::Vector centroid(0.0);
+    Transform::scalar_t totalSpeed = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        BattleUnitPtr unit = scene->battleUnit(i);
+        const Transform::Point &p = *unit->transform->locationPoint();
+        centroid += Transform::Vector(p[0], p[1], p[2]);
+        totalSpeed += magnitude(unit->rigidBody->P / Transform::scalar_t(unit->mass));
+        if (dump)
+            printUnit(i, unit);
+    }
+    if (count != 0) {
+        centroid = centroid / Transform::scalar_t(count);
+        totalSpeed /= count;
+    }
+
+    std::printf("units           %u\n", unsigned(count));
+    if (replay != NULL)
+        std::printf("simulated time  %.3f s (%u replayed steps)\n",
+                    simulated, unsigned(steps));
+    else
+        std::printf("simulated time  %.3f s (%u steps of %g s)\n",
+                    simulated, unsigned(steps), dt);
+    std::printf("centroid        (%.6f, %.6f, %.6f)\n",
+                double(centroid[0]), double(centroid[1]), double(centroid[2]));
+    std::printf("mean speed      %.6f\n", double(totalSpeed));
+    std::printf("first step at   %.3f s (%u model loads)\n", setupTime,
+                unsigned(ModelCache::instance().loadCount()));
+    std::printf("wall time       %.3f s\n", elapsed);
+    if (elapsed > 0.0) {
+        std::printf("steps/sec       %.2f\n", steps / elapsed);
+        std::printf("unit-steps/sec  %.0f\n", double(steps) * count / elapsed);
+    }
+
+    if (checkpointFile != NULL) {
+        if (! checkpointWritten.get()) {
+            std::fprintf(stderr, "%s: couldn't write %s\n", argv[0], checkpointFile);
+            return 1;
+        }
+        std::printf("checkpoint      %.3f ms to snapshot at t = %.3f s\n",
+                    snapshotTime * 1000.0, scene->simulationTime());
+    }
+    if (replay != NULL)
+        std::printf("replay          %s\n", matched ? "matches the recorded run"
+                                                     : "DIVERGED from the recorded run");
+
+    if (traceFile != NULL) {
+        Tracer::stop();
+        if (! Tracer::write(traceFile)) {
+            std::fprintf(stderr, "%s: couldn't write %s\n", argv[0], traceFile);
+            return 1;
+        }
+    }
+    if (metricsFile != NULL) {
+        if (std::strcmp(metricsFile, "-") == 0) {
+            std::fflush(stdout);
+            Metrics::instance().writeCSV(std::cout);
+        } else if (! Metrics::instance().writeCSV(metricsFile)) {
+            std::fprintf(stderr, "%s: couldn't write %s\n", argv[0], metricsFile);
+            return 1;
+        }
+    }
+    return matched ? 0 : 2;
+}
@@ -0,0 +1,140 @@
+/*
+ * File: InputLog.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the input log classes defined in InputLog.hpp.
+ */
+
+// Import class definitions
+#include "InputLog.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <cstring>
+
+// Record tags
+const char CONTROL_RECORD = 'C';
+const char STEP_RECORD    = 'S';
+const char END_RECORD     = 'E';
+
+// How big a buffer the recorder writes through
+const size_t INPUT_LOG_BUFFER_SIZE = 64 * 1024;
+
+
+// Shortcuts for writing & reading raw fields
+template <typename T>
+static void put(std::FILE *f, const T &value) {
+    std::fwrite(&value, sizeof(T), 1, f);
+}
+
+template <typename T>
+static bool get(std::FILE *f, T &value) {
+    return std::fread(&value, sizeof(T), 1, f) == 1;
+}
+
+
+/*---------------------------------------------------------------------------*
+ | InputRecorder
+ *---------------------------------------------------------------------------*/
+// Constructor
+InputRecorder::InputRecorder(const string &filename, uint32_t units,
+                             uint32_t seed, double spacing)
+        : file(std::fopen(filename.c_str(), "wb")), steps(0) {
+    if (file == NULL)
+        return;
+    std::setvbuf(file, NULL, _IOFBF, INPUT_LOG_BUFFER_SIZE);
+
+    InputLogHeader head;
+    std::memset(&head, 0, sizeof(head));
+    std::memcpy(head.magic, INPUT_LOG_MAGIC, sizeof(head.magic));
+    head.version = INPUT_LOG_VERSION;
+    head.units = units;
+    head.seed = seed;
+    head.spacing = spacing;
+    put(file, head);
+}
+
+// Destructor
+InputRecorder::~InputRecorder() {
+    if (file != NULL)
+        std::fclose(file);
+}
+
+void InputRecorder::recordControl(const ControlEvent &e) {
+    if (file == NULL)
+        return;
+    put(file, CONTROL_RECORD);
+    put(file, e.unit);
+    put(file, uint8_t(e.control));
+    put(file, e.value);
+}
+
+void InputRecorder::recordStep(double time) {
+    if (file == NULL)
+        return;
+    put(file, STEP_RECORD);
+    put(file, time);
+    steps++;
+}
+
+void InputRecorder::finish(uint64_t stateHash) {
+    if (file == NULL)
+        return;
+    put(file, END_RECORD);
+    put(file, steps);
+    put(file, stateHash);
+    std::fclose(file);
+    file = NULL;
+}
+
+
+/*---------------------------------------------------------------------------*
+ | InputReplay
+ *---------------------------------------------------------------------------*/
+// Constructor
+InputReplay::InputReplay(const string &filename)
+        : file(std::fopen(filename.c_str(), "rb")),
+          stepTime(0.0), endSteps(0), endHash(0) {
+    if (file == NULL)
+        return;
+    if (! get(file, head)
+            || std::memcmp(head.magic, INPUT_LOG_MAGIC, sizeof(head.magic)) != 0
+            || head.version != INPUT_LOG_VERSION) {
+        std::fclose(file);
+        file = NULL;
+    }
+}
+
+// Destructor
+InputReplay::~InputReplay() {
+    if (file != NULL)
+        std::fclose(file);
+}
+
+InputReplay::Record InputReplay::next() {
+    char tag;
+    if (file == NULL || ! get(file, tag))
+        return Truncated;
+
+    switch (tag) {
+        case CONTROL_RECORD: {
+            uint8_t control;
+            if (! get(file, event.unit) || ! get(file, control) || ! get(file, event.value))
+                return Truncated;
+            if (control > WheelControl)
+                return Corrupt;
+            event.control = UnitControl(control);
+            return Control;
+        }
+        case STEP_RECORD:
+            return get(file, stepTime) ? Step : Truncated;
+        case END_RECORD:
+            return (get(file, endSteps) && get(file, endHash)) ? End : Truncated;
+        default:
+            return Corrupt;
+    }
+}
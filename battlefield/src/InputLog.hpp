@@ -0,0 +1,154 @@
+/*
+ * File: InputLog.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      Recording and replaying the user's control inputs, so that a run can
+ *      be reproduced exactly (and much faster than it was first run).
+ *
+ *      Control changes don't touch the units directly: they're queued up as
+ *      ControlEvents on the BattleScene, which applies them at the start of
+ *      the next simulation step. An InputRecorder attached to the scene
+ *      logs each event it applies, along with the time given to each step,
+ *      so that feeding the log back in (InputReplay) gives the same steps
+ *      with the same inputs. The log ends with a hash of the final state of
+ *      every unit, so a replay can tell if it came out the same. Logging
+ *      starts after the scene's initial update(0.0), which a replay is
+ *      expected to do for itself.
+ *
+ *      The log is a small header followed by a stream of tagged records
+ *      (in the byte order of the machine that wrote it):
+ *
+ *          InputLogHeader                      magic, version, scenario
+ *          'C' uint32 unit, uint8 control, double value
+ *          'S' double time                     one simulation step
+ *          'E' uint64 steps, uint64 hash       end of the run
+ */
+
+#ifndef BATTLEFIELD_INPUT_LOG
+#define BATTLEFIELD_INPUT_LOG
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <cstdio>
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    struct ControlEvent;
+    struct InputLogHeader;
+    class InputRecorder;
+    class InputReplay;
+
+    // Pointer type definitions
+    typedef shared_ptr<InputRecorder> InputRecorderPtr;
+
+    // Format identification
+    const char     INPUT_LOG_MAGIC[4] = { 'B', 'F', 'I', 'R' };
+    const uint32_t INPUT_LOG_VERSION  = 1;
+
+    // The unit controls that can be changed
+    enum UnitControl {
+        SelectControl,          // value != 0 means selected
+        ManualControl,          // value != 0 means under manual control
+        ThrottleControl,
+        BrakeControl,
+        WheelControl,
+    };
+};
+
+
+// A change to one unit's controls
+struct Battlefield::ControlEvent {
+    ControlEvent() { }
+    ControlEvent(uint32_t u, UnitControl c, double v)
+        : unit(u), control(c), value(v) { }
+
+    uint32_t unit;              // Index into the scene's battle units
+    UnitControl control;
+    double value;
+};
+
+
+// What battle the log was recorded in. A zero unit count means the
+// standard team (BattleScene::createTeam()); otherwise it's createArmy().
+struct Battlefield::InputLogHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t units;
+    uint32_t seed;
+    double   spacing;
+};
+
+
+class Battlefield::InputRecorder {
+public:
+    // Constructor, giving the file to write and the scenario being run.
+    // Check isOpen() afterward to see if that worked.
+    InputRecorder(const string &filename, uint32_t units = 0,
+                  uint32_t seed = 0, double spacing = 0.0);
+
+    // Destructor. Closes the log (without an end record, if finish()
+    // wasn't called).
+    ~InputRecorder();
+
+    bool isOpen() const { return file != NULL; }
+
+    // Log things as they happen
+    void recordControl(const ControlEvent &e);
+    void recordStep(double time);
+
+    // Log the final state and close the file
+    void finish(uint64_t stateHash);
+
+    uint64_t stepCount() const { return steps; }
+
+protected:
+    std::FILE * file;
+    uint64_t steps;
+};
+
+
+class Battlefield::InputReplay {
+public:
+    // What comes next in the log
+    enum Record {
+        Control,                // A control change: see control()
+        Step,                   // A step: see time()
+        End,                    // The end of the run: see steps() & hash()
+        Truncated,              // The log stopped without an end record
+        Corrupt,                // Something in there doesn't make sense
+    };
+
+    // Constructor. Check isOpen() afterward to see if the log could be
+    // opened and has a valid header.
+    explicit InputReplay(const string &filename);
+    ~InputReplay();
+
+    bool isOpen() const { return file != NULL; }
+    const InputLogHeader & header() const { return head; }
+
+    // Read the next record
+    Record next();
+
+    // What the record we just read says
+    const ControlEvent & control() const { return event; }
+    double time() const { return stepTime; }
+    uint64_t steps() const { return endSteps; }
+    uint64_t hash() const { return endHash; }
+
+protected:
+    std::FILE * file;
+    InputLogHeader head;
+    ControlEvent event;
+    double stepTime;
+    uint64_t endSteps, endHash;
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * File: Log.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the Log and LogSite classes, defined in
+ *      Log.hpp.
+ */
+
+// Import class definitions
+#include "Log.hpp"
+using namespace Battlefield;
+
+// Import STL & timing stuff
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// How many messages the ring holds (must be a power of two)
+const size_t LOG_RING_SIZE = 1024;
+
+// How long the drain thread sleeps when there's nothing to write
+const std::chrono::milliseconds LOG_DRAIN_INTERVAL(10);
+
+// What each level looks like in the output
+const char * LOG_LEVEL_NAMES[] = { "trace", "debug", "info", "warning", "error" };
+
+typedef std::chrono::steady_clock Clock;
+
+
+/*---------------------------------------------------------------------------*
+ | Log
+ *---------------------------------------------------------------------------*/
+static void flushAtExit() {
+    Log::instance().flush();
+}
+
+Log & Log::instance() {
+    static Log *log = new Log();
+    return *log;
+}
+
+// Constructor
+Log::Log()
+        : ring(LOG_RING_SIZE), mask(LOG_RING_SIZE - 1),
+          writePosition(0), readPosition(0), dropped(0), droppedReported(0) {
+    for (size_t i = 0; i < ring.size(); i++)
+        ring[i].sequence = i;
+    drainer = std::thread(&Log::drainMain, this);
+    drainer.detach();
+    std::atexit(flushAtExit);
+}
+
+void Log::write(Level level, const string &message, size_t skipped) {
+    // Claim a slot, unless the reader's still a whole lap behind
+    size_t position = writePosition.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+        slot = &ring[position & mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (writePosition.compare_exchange_weak(position, position + 1,
+                                                    std::memory_order_relaxed))
+                break;
+        } else if (sequence < position) {
+            dropped++;          // Full. Too bad.
+            return;
+        } else {
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->skipped = skipped;
+    slot->length = std::min(message.size(), size_t(MESSAGE_SIZE));
+    std::memcpy(slot->text, message.data(), slot->length);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Log::flush() {
+    drain();
+    std::fflush(stderr);
+}
+
+void Log::drainMain() {
+    while (true) {
+        if (drain() == 0)
+            std::this_thread::sleep_for(LOG_DRAIN_INTERVAL);
+    }
+}
+
+// Write out whatever's ready, returning how many messages that was
+size_t Log::drain() {
+    std::lock_guard<std::mutex> guard(readLock);
+    size_t count = 0;
+    while (true) {
+        Slot &slot = ring[readPosition & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+            break;
+
+        std::fprintf(stderr, "[%s] %.*s", LOG_LEVEL_NAMES[slot.level],
+                     int(slot.length), slot.text);
+        if (slot.skipped != 0)
+            std::fprintf(stderr, " (%u more like this skipped)", unsigned(slot.skipped));
+        std::fputc('\n', stderr);
+
+        // Give the slot back to the writers, for the next lap
+        slot.sequence.store(readPosition + ring.size(), std::memory_order_release);
+        readPosition++;
+        count++;
+    }
+
+    size_t lost = dropped;
+    if (lost != droppedReported) {
+        std::fprintf(stderr, "[warning] log ring overflowed: %u messages lost\n",
+                     unsigned(lost - droppedReported));
+        droppedReported = lost;
+    }
+    return count;
+}
+
+
+/*---------------------------------------------------------------------------*
+ | LogSite
+ *---------------------------------------------------------------------------*/
+LogSite::LogSite(double seconds)
+    : interval((long long)(seconds * 1e9)), nextAllowed(0), held(0) { }
+
+bool LogSite::admit(size_t &skipped) {
+    long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now().time_since_epoch()).count();
+    long long next = nextAllowed.load(std::memory_order_relaxed);
+    if (now < next || ! nextAllowed.compare_exchange_strong(next, now + interval)) {
+        held++;
+        return false;
+    }
+    skipped = held.exchange(0);
+    return true;
+}
@@ -0,0 +1,153 @@
+/*
+ * File: Log.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      Diagnostic logging that's cheap enough to leave in the simulation
+ *      step.
+ *
+ *      Messages are written with BATTLEFIELD_LOG(level, stuff << to << say),
+ *      or BATTLEFIELD_LOG_EVERY(level, seconds, ...) to let a particular
+ *      call site through at most once every so often (the number skipped
+ *      is reported with the next one that gets through).
+ *
+ *      Levels below BATTLEFIELD_LOG_LEVEL are compiled out entirely. The
+ *      ones that remain are formatted on the caller's thread and pushed
+ *      into a fixed-size, lock-free ring; a background thread drains the
+ *      ring to stderr. So logging never waits on I/O (or on a lock). If the
+ *      ring fills up, messages are dropped and counted, rather than making
+ *      anybody wait.
+ */
+
+#ifndef BATTLEFIELD_LOGGING
+#define BATTLEFIELD_LOGGING
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class Log;
+    class LogSite;
+};
+
+// The lowest level that gets compiled in (0 = Trace ... 4 = Error)
+#ifndef BATTLEFIELD_LOG_LEVEL
+#   ifdef NDEBUG
+#       define BATTLEFIELD_LOG_LEVEL 2
+#   else
+#       define BATTLEFIELD_LOG_LEVEL 1
+#   endif
+#endif
+
+
+class Battlefield::Log {
+public:
+    // How much anybody should care
+    enum Level {
+        Trace   = 0,
+        Debug   = 1,
+        Info    = 2,
+        Warning = 3,
+        Error   = 4,
+    };
+
+    // The one and only log. It's never destroyed (so that it's still there
+    // for anybody logging from a destructor at exit), but whatever's in
+    // the ring is written out when the program exits.
+    static Log & instance();
+
+    // Queue a message. 'skipped' is how many messages from the same call
+    // site were held back since the last one.
+    void write(Level level, const string &message, size_t skipped = 0);
+
+    // Write out everything queued so far (on the calling thread)
+    void flush();
+
+    // How many messages were lost because the ring was full
+    size_t droppedCount() const { return dropped; }
+
+protected:
+    Log();
+
+    // One message waiting in the ring. 'sequence' says whose turn it is:
+    // a writer may fill slot i when it's equal to the write position, and
+    // the reader may empty it when it's one past.
+    enum { MESSAGE_SIZE = 240 };
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Level level;
+        size_t skipped;
+        size_t length;
+        char text[MESSAGE_SIZE];
+    };
+
+    void drainMain();
+    size_t drain();
+
+    std::vector<Slot> ring;
+    size_t mask;
+    std::atomic<size_t> writePosition;
+    size_t readPosition;            // Guarded by readLock
+    std::mutex readLock;
+    std::atomic<size_t> dropped;
+    size_t droppedReported;         // Guarded by readLock
+    std::thread drainer;
+};
+
+
+// Per-call-site rate limiter, for BATTLEFIELD_LOG_EVERY
+class Battlefield::LogSite {
+public:
+    explicit LogSite(double seconds);
+
+    // Should this message be let through? If so, 'skipped' says how many
+    // weren't since the last one that was.
+    bool admit(size_t &skipped);
+
+protected:
+    long long interval;                     // In nanoseconds
+    std::atomic<long long> nextAllowed;
+    std::atomic<size_t> held;
+};
+
+
+// The logging macros themselves. The level test is a compile-time constant,
+// so stripped levels cost nothing (but are still checked by the compiler).
+#define BATTLEFIELD_LOG(LEVEL, MESSAGE)                                     \
+    do {                                                                    \
+        if (Battlefield::Log::LEVEL >= BATTLEFIELD_LOG_LEVEL) {             \
+            std::ostringstream logMessage_;                                 \
+            logMessage_ << MESSAGE;                                         \
+            Battlefield::Log::instance().write(Battlefield::Log::LEVEL,     \
+                                               logMessage_.str());          \
+        }                                                                   \
+    } while (false)
+
+#define BATTLEFIELD_LOG_EVERY(LEVEL, SECONDS, MESSAGE)                      \
+    do {                                                                    \
+        if (Battlefield::Log::LEVEL >= BATTLEFIELD_LOG_LEVEL) {             \
+            static Battlefield::LogSite logSite_(SECONDS);                  \
+            size_t logSkipped_;                                             \
+            if (logSite_.admit(logSkipped_)) {                              \
+                std::ostringstream logMessage_;                             \
+                logMessage_ << MESSAGE;                                     \
+                Battlefield::Log::instance().write(Battlefield::Log::LEVEL, \
+                                                   logMessage_.str(),       \
+                                                   logSkipped_);            \
+            }                                                               \
+        }                                                                   \
+    } while (false)
+
+#endif
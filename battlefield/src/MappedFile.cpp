@@ -0,0 +1,105 @@
+/*
+ * File: MappedFile.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the MappedFile class, defined in MappedFile.hpp.
+ */
+
+// Import class definition
+#include "MappedFile.hpp"
+using namespace Battlefield;
+
+// Import OS file mapping stuff
+#if __MS_WINDOZE__
+#   include <windows.h>
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+
+#if __MS_WINDOZE__
+
+bool MappedFile::open(const string &filename) {
+    close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (! GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping keeps the file open, so we can let go of it now
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    bytes = static_cast<const unsigned char *>(view);
+    length = size_t(fileSize.QuadPart);
+    handle = mapping;
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes != NULL) {
+        UnmapViewOfFile(bytes);
+        CloseHandle(static_cast<HANDLE>(handle));
+    }
+    bytes = NULL;
+    length = 0;
+    handle = NULL;
+}
+
+#else
+
+bool MappedFile::open(const string &filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file open, so we can let go of it now
+    void *view = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    bytes = static_cast<const unsigned char *>(view);
+    length = size_t(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes != NULL)
+        munmap(const_cast<unsigned char *>(bytes), length);
+    bytes = NULL;
+    length = 0;
+}
+
+#endif
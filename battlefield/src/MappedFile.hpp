@@ -0,0 +1,55 @@
+/*
+ * File: MappedFile.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The MappedFile class maps a whole file read-only into memory (with
+ *      mmap() on POSIX systems, or a file mapping object on Windows), so
+ *      that binary data files can be used in place, without being read or
+ *      parsed. The mapping goes away with the MappedFile.
+ */
+
+#ifndef BATTLEFIELD_MAPPED_FILE
+#define BATTLEFIELD_MAPPED_FILE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class MappedFile;
+};
+
+
+class Battlefield::MappedFile {
+public:
+    // Constructors & destructor
+    MappedFile() : bytes(NULL), length(0), handle(NULL) { }
+    explicit MappedFile(const string &filename)
+        : bytes(NULL), length(0), handle(NULL) { open(filename); }
+    ~MappedFile() { close(); }
+
+    // Map 'filename', returning false (and leaving us closed) if we can't
+    bool open(const string &filename);
+    void close();
+
+    // The file's contents
+    bool isOpen() const { return bytes != NULL; }
+    const unsigned char * data() const { return bytes; }
+    size_t size() const { return length; }
+
+protected:
+    // Not copyable (we own the mapping)
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+
+    const unsigned char * bytes;
+    size_t length;
+    void * handle;              // Windows file mapping handle
+};
+
+#endif
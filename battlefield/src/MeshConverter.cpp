@@ -0,0 +1,263 @@
+/*
+ * File: MeshConverter.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file contains the main() function for battlefield-meshconv,
+ *      which converts Wavefront OBJ models (and the MTL material libraries
+ *      they use) into the binary .mesh format described in MeshFile.hpp:
+ *
+ *          battlefield-meshconv model.obj [model.mesh]
+ *
+ *      Only what the battlefield uses is kept: vertices, normals, texture
+ *      coordinates, polygons and their materials. Groups, smoothing groups
+ *      and the like are ignored.
+ */
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the .mesh format & file mapping, and the model loading it's for
+#include "MeshFile.hpp"
+#include "MappedFile.hpp"
+#include "ModelCache.hpp"
+using namespace Battlefield;
+
+// Import Inca stuff
+#include <io/IOUtilities.h++>
+using namespace Inca::IO;
+
+// Import STL & timing stuff
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+
+typedef std::chrono::steady_clock Clock;
+
+
+// Where relative filenames in 'filename' should be looked up
+string directoryOf(const string &filename) {
+    string::size_type slash = filename.find_last_of("/\\");
+    return slash == string::npos ? string() : filename.substr(0, slash + 1);
+}
+
+// Copy a string into a fixed-size, null-terminated field
+void copyField(char *field, size_t size, const string &value) {
+    std::strncpy(field, value.c_str(), size - 1);
+    field[size - 1] = '\0';
+    if (value.size() >= size)
+        std::fprintf(stderr, "warning: \"%s\" truncated to %u characters\n",
+                     value.c_str(), unsigned(size - 1));
+}
+
+// Turn an OBJ index (1-based, or negative for "counting back from the
+// last one") into a 0-based one, or MESH_NONE if it's missing or bogus
+uint32_t objIndex(const string &text, size_t count) {
+    if (text.empty())
+        return MESH_NONE;
+    long index = std::strtol(text.c_str(), NULL, 10);
+    if (index < 0)
+        index += long(count);
+    else
+        index -= 1;
+    return (index >= 0 && size_t(index) < count) ? uint32_t(index) : MESH_NONE;
+}
+
+
+// Read the materials from an MTL library, appending them to 'mesh' and
+// noting where each one is by name
+bool readMTL(const string &filename, MeshData &mesh,
+             std::map<string, uint32_t> &byName) {
+    std::ifstream in(filename.c_str());
+    if (! in) {
+        std::fprintf(stderr, "warning: can't read material library %s\n",
+                     filename.c_str());
+        return false;
+    }
+
+    MeshMaterial *m = NULL;
+    string line;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        string keyword;
+        words >> keyword;
+        if (keyword == "newmtl") {
+            string name;
+            words >> name;
+            MeshMaterial blank;
+            std::memset(&blank, 0, sizeof(blank));
+            byName[name] = uint32_t(mesh.materials.size());
+            mesh.materials.push_back(blank);
+            m = &mesh.materials.back();
+            copyField(m->name, sizeof(m->name), name);
+        } else if (m == NULL) {
+            continue;                   // Nothing to attach it to
+        } else if (keyword == "Ka") {
+            words >> m->ambient[0] >> m->ambient[1] >> m->ambient[2];
+        } else if (keyword == "Kd") {
+            words >> m->diffuse[0] >> m->diffuse[1] >> m->diffuse[2];
+        } else if (keyword == "Ks") {
+            words >> m->specular[0] >> m->specular[1] >> m->specular[2];
+        } else if (keyword == "Ns") {
+            words >> m->shininess;
+        } else if (keyword == "map_Kd") {
+            string texture;
+            words >> texture;
+            copyField(m->texture, sizeof(m->texture), texture);
+        }
+    }
+    return true;
+}
+
+// Read an OBJ model into 'mesh'
+bool readOBJ(const string &filename, MeshData &mesh) {
+    std::ifstream in(filename.c_str());
+    if (! in) {
+        std::fprintf(stderr, "can't read %s\n", filename.c_str());
+        return false;
+    }
+
+    std::map<string, uint32_t> materials;
+    uint32_t material = MESH_NONE;
+    bool triedLibrary = false;
+    size_t skipped = 0;
+    string line;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        string keyword;
+        words >> keyword;
+        if (keyword == "v") {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            words >> x >> y >> z;
+            mesh.vertices.push_back(x);
+            mesh.vertices.push_back(y);
+            mesh.vertices.push_back(z);
+        } else if (keyword == "vn") {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            words >> x >> y >> z;
+            mesh.normals.push_back(x);
+            mesh.normals.push_back(y);
+            mesh.normals.push_back(z);
+        } else if (keyword == "vt") {
+            float u = 0.0f, v = 0.0f;
+            words >> u >> v;
+            mesh.texCoords.push_back(u);
+            mesh.texCoords.push_back(v);
+        } else if (keyword == "f") {
+            // Each corner is v, v/vt, v//vn or v/vt/vn
+            MeshFace face;
+            face.firstVertex = uint32_t(mesh.faceVertices.size());
+            face.vertexCount = 0;
+            face.material = material;
+            string corner;
+            bool valid = true;
+            while (words >> corner) {
+                string parts[3];
+                std::istringstream fields(corner);
+                for (int p = 0; p < 3 && std::getline(fields, parts[p], '/'); p++)
+                    ;
+                MeshFaceVertex fv;
+                fv.vertex    = objIndex(parts[0], mesh.vertices.size() / 3);
+                fv.texCoords = objIndex(parts[1], mesh.texCoords.size() / 2);
+                fv.normal    = objIndex(parts[2], mesh.normals.size() / 3);
+                if (fv.vertex == MESH_NONE)
+                    valid = false;
+                mesh.faceVertices.push_back(fv);
+                face.vertexCount++;
+            }
+            if (valid && face.vertexCount >= 3) {
+                mesh.faces.push_back(face);
+            } else {
+                mesh.faceVertices.resize(face.firstVertex);
+                skipped++;
+            }
+        } else if (keyword == "mtllib") {
+            string library;
+            while (words >> library)
+                readMTL(directoryOf(filename) + library, mesh, materials);
+            triedLibrary = true;
+        } else if (keyword == "usemtl") {
+            string name;
+            words >> name;
+
+            // Some of our models use materials without saying where they
+            // are, in which case they're in the .mtl file named after the
+            // model
+            if (! triedLibrary) {
+                string library = filename.substr(0, filename.find_last_of('.')) + ".mtl";
+                readMTL(library, mesh, materials);
+                triedLibrary = true;
+            }
+            std::map<string, uint32_t>::const_iterator m = materials.find(name);
+            material = (m == materials.end()) ? MESH_NONE : m->second;
+        }
+    }
+
+    if (skipped != 0)
+        std::fprintf(stderr, "warning: skipped %u malformed faces\n", unsigned(skipped));
+    return true;
+}
+
+
+/*****************************************************************************
+ * Converter main() entry function -- reads the OBJ, writes the .mesh, then
+ * maps it back in to make sure it's good. Then it loads the model both ways
+ * the ModelCache can (Inca's OBJ loader, and the .mesh file) to show how
+ * long each takes.
+ *****************************************************************************/
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        std::fprintf(stderr, "Usage: %s model.obj [model.mesh]\n", argv[0]);
+        return 1;
+    }
+    string input(argv[1]);
+    string output = (argc == 3) ? string(argv[2]) : meshFilename(input);
+
+    MeshData mesh;
+    if (! readOBJ(input, mesh))
+        return 1;
+    if (! writeMeshFile(output, mesh)) {
+        std::fprintf(stderr, "can't write %s\n", output.c_str());
+        return 1;
+    }
+
+    MappedFile file(output);
+    MeshFileView view;
+    if (! view.open(file.data(), file.size())) {
+        std::fprintf(stderr, "%s didn't come out right\n", output.c_str());
+        return 1;
+    }
+    std::printf("%s: %u vertices, %u normals, %u tex coords, %u faces, %u materials (%u bytes)\n",
+                output.c_str(), view.vertexCount(), view.normalCount(),
+                view.texCoordsCount(), view.faceCount(), view.materialCount(),
+                unsigned(file.size()));
+
+    // Time the two ways a unit's model can get loaded
+    Clock::time_point start = Clock::now();
+    try {
+        loadModel(input);
+    } catch (const Inca::IncaException &e) {
+        std::cerr << "Inca can't load " << input << ": " << e << std::endl;
+        return 1;
+    }
+    double objTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    if (ModelCache::loadMesh(output) == NULL) {
+        std::fprintf(stderr, "can't load %s\n", output.c_str());
+        return 1;
+    }
+    double meshTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("loadModel() %.3f ms, ModelCache::loadMesh() %.3f ms\n",
+                objTime * 1e3, meshTime * 1e3);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * File: MeshFile.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the .mesh file reading and writing functions
+ *      defined in MeshFile.hpp.
+ */
+
+// Import function & class definitions
+#include "MeshFile.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <cstdio>
+#include <cstring>
+
+
+// Does an array of 'count' 'elementSize'-byte elements at 'offset' fit in
+// 'size' bytes (and is it properly aligned)?
+static bool fits(uint32_t offset, uint32_t count, size_t elementSize, size_t size) {
+    uint64_t end = uint64_t(offset) + uint64_t(count) * elementSize;
+    return offset % 4 == 0 && end <= size;
+}
+
+static bool validIndex(uint32_t index, uint32_t count) {
+    return index == MESH_NONE || index < count;
+}
+
+bool MeshFileView::open(const unsigned char *data, size_t size) {
+    header = NULL;
+    if (data == NULL || size < sizeof(MeshFileHeader))
+        return false;
+
+    const MeshFileHeader *h = reinterpret_cast<const MeshFileHeader *>(data);
+    if (std::memcmp(h->magic, MESH_FILE_MAGIC, 4) != 0 || h->version != MESH_FILE_VERSION)
+        return false;
+
+    // Make sure all the arrays are inside the file...
+    if (! fits(h->vertexOffset, h->vertexCount, 3 * sizeof(float), size)
+            || ! fits(h->normalOffset, h->normalCount, 3 * sizeof(float), size)
+            || ! fits(h->texCoordsOffset, h->texCoordsCount, 2 * sizeof(float), size)
+            || ! fits(h->faceOffset, h->faceCount, sizeof(MeshFace), size)
+            || ! fits(h->faceVertexOffset, h->faceVertexCount, sizeof(MeshFaceVertex), size)
+            || ! fits(h->materialOffset, h->materialCount, sizeof(MeshMaterial), size))
+        return false;
+
+    // ...and that everything they refer to is, too
+    base = data;
+    header = h;
+    const MeshFace *f = faces();
+    for (uint32_t i = 0; i < h->faceCount; i++) {
+        if (uint64_t(f[i].firstVertex) + f[i].vertexCount > h->faceVertexCount
+                || ! validIndex(f[i].material, h->materialCount)) {
+            header = NULL;
+            return false;
+        }
+    }
+    const MeshFaceVertex *fv = faceVertices();
+    for (uint32_t i = 0; i < h->faceVertexCount; i++) {
+        if (fv[i].vertex >= h->vertexCount
+                || ! validIndex(fv[i].normal, h->normalCount)
+                || ! validIndex(fv[i].texCoords, h->texCoordsCount)) {
+            header = NULL;
+            return false;
+        }
+    }
+    const MeshMaterial *m = materials();
+    for (uint32_t i = 0; i < h->materialCount; i++) {
+        if (std::memchr(m[i].name, '\0', sizeof(m[i].name)) == NULL
+                || std::memchr(m[i].texture, '\0', sizeof(m[i].texture)) == NULL) {
+            header = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool Battlefield::writeMeshFile(const string &filename, const MeshData &mesh) {
+    MeshFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, MESH_FILE_MAGIC, 4);
+    h.version         = MESH_FILE_VERSION;
+    h.vertexCount     = uint32_t(mesh.vertices.size() / 3);
+    h.normalCount     = uint32_t(mesh.normals.size() / 3);
+    h.texCoordsCount  = uint32_t(mesh.texCoords.size() / 2);
+    h.faceCount       = uint32_t(mesh.faces.size());
+    h.faceVertexCount = uint32_t(mesh.faceVertices.size());
+    h.materialCount   = uint32_t(mesh.materials.size());
+
+    // Lay the arrays out one after another
+    uint32_t offset = sizeof(MeshFileHeader);
+    h.vertexOffset     = offset;    offset += h.vertexCount * 3 * sizeof(float);
+    h.normalOffset     = offset;    offset += h.normalCount * 3 * sizeof(float);
+    h.texCoordsOffset  = offset;    offset += h.texCoordsCount * 2 * sizeof(float);
+    h.faceOffset       = offset;    offset += h.faceCount * sizeof(MeshFace);
+    h.faceVertexOffset = offset;    offset += h.faceVertexCount * sizeof(MeshFaceVertex);
+    h.materialOffset   = offset;
+
+    FILE *out = std::fopen(filename.c_str(), "wb");
+    if (out == NULL)
+        return false;
+    bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1;
+    if (ok && ! mesh.vertices.empty())
+        ok = std::fwrite(&mesh.vertices[0], sizeof(float), mesh.vertices.size(), out)
+                == mesh.vertices.size();
+    if (ok && ! mesh.normals.empty())
+        ok = std::fwrite(&mesh.normals[0], sizeof(float), mesh.normals.size(), out)
+                == mesh.normals.size();
+    if (ok && ! mesh.texCoords.empty())
+        ok = std::fwrite(&mesh.texCoords[0], sizeof(float), mesh.texCoords.size(), out)
+                == mesh.texCoords.size();
+    if (ok && ! mesh.faces.empty())
+        ok = std::fwrite(&mesh.faces[0], sizeof(MeshFace), mesh.faces.size(), out)
+                == mesh.faces.size();
+    if (ok && ! mesh.faceVertices.empty())
+        ok = std::fwrite(&mesh.faceVertices[0], sizeof(MeshFaceVertex),
+                         mesh.faceVertices.size(), out) == mesh.faceVertices.size();
+    if (ok && ! mesh.materials.empty())
+        ok = std::fwrite(&mesh.materials[0], sizeof(MeshMaterial),
+                         mesh.materials.size(), out) == mesh.materials.size();
+    if (std::fclose(out) != 0)
+        ok = false;
+    if (! ok)
+        std::remove(filename.c_str());
+    return ok;
+}
+
+string Battlefield::meshFilename(const string &modelFilename) {
+    string::size_type dot = modelFilename.find_last_of('.');
+    string::size_type slash = modelFilename.find_last_of("/\\");
+    if (dot == string::npos || (slash != string::npos && dot < slash))
+        return modelFilename + ".mesh";
+    return modelFilename.substr(0, dot) + ".mesh";
+}
@@ -0,0 +1,139 @@
+/*
+ * File: MeshFile.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The .mesh format is a compact binary version of a Wavefront OBJ/MTL
+ *      model, meant to be mapped into memory and used in place. It's laid
+ *      out as a fixed header followed by packed arrays, all made of 4-byte
+ *      fields (in the byte order of the machine that wrote it):
+ *
+ *          MeshFileHeader                  magic, version, counts & offsets
+ *          float[3] * vertexCount          vertex locations
+ *          float[3] * normalCount          vertex normals
+ *          float[2] * texCoordsCount       texture coordinates
+ *          MeshFace * faceCount            polygons, as runs of face vertices
+ *          MeshFaceVertex * faceVertexCount
+ *          MeshMaterial * materialCount
+ *
+ *      Files are written by the battlefield-meshconv tool. MeshFileView
+ *      checks that a mapped file is well-formed (so that nothing in it can
+ *      send us outside the mapping) and gives typed access to its arrays.
+ */
+
+#ifndef BATTLEFIELD_MESH_FILE
+#define BATTLEFIELD_MESH_FILE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    struct MeshFileHeader;
+    struct MeshFace;
+    struct MeshFaceVertex;
+    struct MeshMaterial;
+    struct MeshData;
+    class MeshFileView;
+
+    // Format identification
+    const char     MESH_FILE_MAGIC[4] = { 'B', 'F', 'M', 'S' };
+    const uint32_t MESH_FILE_VERSION  = 1;
+
+    // Index meaning "none" (e.g., a face vertex without a normal)
+    const uint32_t MESH_NONE = 0xFFFFFFFF;
+
+    // Write 'mesh' to 'filename', returning false if we couldn't
+    bool writeMeshFile(const string &filename, const MeshData &mesh);
+
+    // The .mesh file that goes with a model file (e.g., data/t62.obj ->
+    // data/t62.mesh)
+    string meshFilename(const string &modelFilename);
+};
+
+
+struct Battlefield::MeshFileHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t vertexCount, normalCount, texCoordsCount;
+    uint32_t faceCount, faceVertexCount, materialCount;
+    uint32_t vertexOffset, normalOffset, texCoordsOffset;     // Byte offsets
+    uint32_t faceOffset, faceVertexOffset, materialOffset;    // from the start
+};
+
+// A polygon, made of 'vertexCount' consecutive face vertices
+struct Battlefield::MeshFace {
+    uint32_t firstVertex, vertexCount;
+    uint32_t material;                  // Or MESH_NONE
+};
+
+// One corner of a polygon (the normal & texture coordinates may be MESH_NONE)
+struct Battlefield::MeshFaceVertex {
+    uint32_t vertex, normal, texCoords;
+};
+
+struct Battlefield::MeshMaterial {
+    float ambient[3], diffuse[3], specular[3];
+    float shininess;
+    char  name[32];                     // Null-terminated
+    char  texture[64];                  // Image filename, relative to the
+                                        // .mesh file (or empty)
+};
+
+
+// An unpacked mesh, as built up by the converter
+struct Battlefield::MeshData {
+    std::vector<float> vertices, normals, texCoords;
+    std::vector<MeshFace> faces;
+    std::vector<MeshFaceVertex> faceVertices;
+    std::vector<MeshMaterial> materials;
+};
+
+
+// Typed, checked access to a .mesh file in memory
+class Battlefield::MeshFileView {
+public:
+    // Constructor
+    MeshFileView() : base(NULL), header(NULL) { }
+
+    // Point this at a .mesh file's contents, returning false if they're not
+    // a valid .mesh file of the version we understand
+    bool open(const unsigned char *data, size_t size);
+
+    // The arrays, which point into the original data
+    uint32_t vertexCount() const     { return header->vertexCount; }
+    uint32_t normalCount() const     { return header->normalCount; }
+    uint32_t texCoordsCount() const  { return header->texCoordsCount; }
+    uint32_t faceCount() const       { return header->faceCount; }
+    uint32_t faceVertexCount() const { return header->faceVertexCount; }
+    uint32_t materialCount() const   { return header->materialCount; }
+    const float * vertices() const  { return array<float>(header->vertexOffset); }
+    const float * normals() const   { return array<float>(header->normalOffset); }
+    const float * texCoords() const { return array<float>(header->texCoordsOffset); }
+    const MeshFace * faces() const  { return array<MeshFace>(header->faceOffset); }
+    const MeshFaceVertex * faceVertices() const {
+        return array<MeshFaceVertex>(header->faceVertexOffset);
+    }
+    const MeshMaterial * materials() const {
+        return array<MeshMaterial>(header->materialOffset);
+    }
+
+protected:
+    template <typename T>
+    const T * array(uint32_t offset) const {
+        return reinterpret_cast<const T *>(base + offset);
+    }
+
+    const unsigned char * base;
+    const MeshFileHeader * header;
+};
+
+#endif
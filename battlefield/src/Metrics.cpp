@@ -0,0 +1,145 @@
+/*
+ * File: Metrics.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the Metrics class, defined in Metrics.hpp.
+ */
+
+// Import class definition
+#include "Metrics.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+
+// How many frames' worth of samples each metric keeps
+const size_t METRIC_WINDOW = 300;
+
+
+/*---------------------------------------------------------------------------*
+ | Metrics::Metric
+ *---------------------------------------------------------------------------*/
+Metrics::Metric::Metric(const string &n, Kind k)
+    : _name(n), _kind(k), pending(0), touched(false),
+      samples(METRIC_WINDOW), next(0), filled(0), total(0) { }
+
+void Metrics::Metric::endFrame() {
+    bool used = touched.exchange(false, std::memory_order_relaxed);
+    long long sample = pending.exchange(0, std::memory_order_relaxed);
+    if (! used && _kind == Time)
+        return;
+
+    std::lock_guard<std::mutex> guard(lock);
+    samples[next] = sample;
+    next = (next + 1) % samples.size();
+    filled = std::min(filled + 1, samples.size());
+    total += sample;
+}
+
+Metrics::Metric::Summary Metrics::Metric::summarize() const {
+    std::vector<long long> sorted;
+    Summary s;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        sorted.assign(samples.begin(), samples.begin() + filled);
+        s.total = total;
+    }
+    s.samples = sorted.size();
+    s.mean = s.p50 = s.p95 = s.p99 = s.max = 0.0;
+    if (sorted.empty())
+        return s;
+
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < sorted.size(); i++)
+        sum += sorted[i];
+    s.mean = sum / sorted.size();
+    s.p50 = sorted[(sorted.size() - 1) * 50 / 100];
+    s.p95 = sorted[(sorted.size() - 1) * 95 / 100];
+    s.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+    s.max = sorted.back();
+    return s;
+}
+
+
+/*---------------------------------------------------------------------------*
+ | Metrics
+ *---------------------------------------------------------------------------*/
+Metrics & Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metric & Metrics::metric(const string &name, Kind kind) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < metrics.size(); i++)
+        if (metrics[i].name() == name)
+            return metrics[i];
+    metrics.emplace_back(name, kind);
+    return metrics.back();
+}
+
+void Metrics::endFrame() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < metrics.size(); i++)
+        metrics[i].endFrame();
+    frames++;
+}
+
+void Metrics::writeCSV(std::ostream &os) const {
+    std::lock_guard<std::mutex> guard(lock);
+    os << "metric,kind,samples,mean,p50,p95,p99,max,total\n";
+    for (size_t i = 0; i < metrics.size(); i++) {
+        const Metric &m = metrics[i];
+        Metric::Summary s = m.summarize();
+        double scale = (m.kind() == Time ? 1e-6 : 1.0);     // ns -> ms
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s,%s,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                      m.name().c_str(), m.kind() == Time ? "ms" : "count",
+                      unsigned(s.samples), s.mean * scale, s.p50 * scale,
+                      s.p95 * scale, s.p99 * scale, s.max * scale,
+                      double(s.total) * scale);
+        os << line;
+    }
+}
+
+bool Metrics::writeCSV(const string &filename) const {
+    std::ofstream file(filename.c_str());
+    if (! file)
+        return false;
+    writeCSV(file);
+    return bool(file);
+}
+
+std::vector<string> Metrics::report() const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Make the name column wide enough for the longest name
+    int width = 0;
+    for (size_t i = 0; i < metrics.size(); i++)
+        width = std::max(width, int(metrics[i].name().size()));
+
+    std::vector<string> lines;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-*s %9s %9s %9s", width, "", "mean", "p95", "max");
+    lines.push_back(line);
+    for (size_t i = 0; i < metrics.size(); i++) {
+        const Metric &m = metrics[i];
+        Metric::Summary s = m.summarize();
+        if (m.kind() == Time)
+            std::snprintf(line, sizeof(line), "%-*s %7.2fms %7.2fms %7.2fms", width,
+                          m.name().c_str(), s.mean * 1e-6, s.p95 * 1e-6, s.max * 1e-6);
+        else
+            std::snprintf(line, sizeof(line), "%-*s %9.0f %9.0f %9.0f", width,
+                          m.name().c_str(), s.mean, s.p95, s.max);
+        lines.push_back(line);
+    }
+    return lines;
+}
@@ -0,0 +1,157 @@
+/*
+ * File: Metrics.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The Metrics registry keeps running statistics on where each frame's
+ *      time goes (timers) and how much work it does (counters), cheaply
+ *      enough to leave turned on all the time.
+ *
+ *      Code being measured adds to a metric with BATTLEFIELD_TIME_SCOPE(name)
+ *      (times the rest of the enclosing block) or BATTLEFIELD_COUNT(name, n).
+ *      Everything added during a frame is summed, and endFrame() turns
+ *      each sum into one sample. The last few hundred samples of each
+ *      metric are kept, for the mean and percentiles, which can be written
+ *      out as CSV or shown on screen.
+ */
+
+#ifndef BATTLEFIELD_METRICS
+#define BATTLEFIELD_METRICS
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class Metrics;
+};
+
+
+class Battlefield::Metrics {
+public:
+    // What a metric measures
+    enum Kind {
+        Time,       // Nanoseconds spent
+        Count,      // Things done
+    };
+
+    // One named metric
+    class Metric {
+    public:
+        Metric(const string &n, Kind k);
+
+        const string & name() const { return _name; }
+        Kind kind() const { return _kind; }
+
+        // Add to this frame's sum (from any thread)
+        void add(long long amount) {
+            pending.fetch_add(amount, std::memory_order_relaxed);
+            touched.store(true, std::memory_order_relaxed);
+        }
+
+        // What's been added so far this frame
+        long long sum() const { return pending.load(std::memory_order_relaxed); }
+
+        // Take this frame's sum as a sample. Timers that weren't used this
+        // frame don't get one.
+        void endFrame();
+
+        // Statistics over the recent samples
+        struct Summary {
+            size_t samples;
+            double mean, p50, p95, p99, max;
+            long long total;                // Over the whole run
+        };
+        Summary summarize() const;
+
+    protected:
+        string _name;
+        Kind _kind;
+        std::atomic<long long> pending;
+        std::atomic<bool> touched;
+
+        // The recent samples (a ring), and the all-time total
+        mutable std::mutex lock;
+        std::vector<long long> samples;
+        size_t next, filled;
+        long long total;
+    };
+
+    // Times the scope it's declared in
+    class ScopedTimer {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        explicit ScopedTimer(Metric &m) : metric(m), start(Clock::now()) { }
+        ~ScopedTimer() {
+            metric.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           Clock::now() - start).count());
+        }
+    protected:
+        Metric &metric;
+        Clock::time_point start;
+    };
+
+    // The one and only registry
+    static Metrics & instance();
+
+    // Find a metric by name, creating it if need be. The reference stays
+    // good forever, so it's worth hanging on to (the macros do).
+    Metric & timer(const string &name)   { return metric(name, Time); }
+    Metric & counter(const string &name) { return metric(name, Count); }
+    Metric & metric(const string &name, Kind kind);
+
+    // Close out the current frame. What counts as a frame is up to whoever
+    // runs the show: the viewer ends one per picture drawn, and the headless
+    // runner one per simulation step.
+    void endFrame();
+    size_t frameCount() const { return frames; }
+
+    // One line per metric: name, kind, samples, mean, percentiles, max and
+    // total. Times are in milliseconds.
+    void writeCSV(std::ostream &os) const;
+    bool writeCSV(const string &filename) const;
+
+    // A short, fixed-width table for the HUD
+    std::vector<string> report() const;
+
+protected:
+    Metrics() : frames(0) { }
+
+    mutable std::mutex lock;            // Guards 'metrics' (not their contents)
+    std::deque<Metric> metrics;
+    std::atomic<size_t> frames;
+};
+
+
+// Measuring macros. Each call site looks its metric up only once.
+#define BATTLEFIELD_METRICS_JOIN2(A, B) A ## B
+#define BATTLEFIELD_METRICS_JOIN(A, B) BATTLEFIELD_METRICS_JOIN2(A, B)
+
+#define BATTLEFIELD_TIME_SCOPE(NAME)                                        \
+    static Battlefield::Metrics::Metric &                                   \
+        BATTLEFIELD_METRICS_JOIN(metricTimer_, __LINE__)                    \
+            = Battlefield::Metrics::instance().timer(NAME);                 \
+    Battlefield::Metrics::ScopedTimer                                       \
+        BATTLEFIELD_METRICS_JOIN(metricScope_, __LINE__)                    \
+            (BATTLEFIELD_METRICS_JOIN(metricTimer_, __LINE__))
+
+#define BATTLEFIELD_COUNT(NAME, AMOUNT)                                     \
+    do {                                                                    \
+        static Battlefield::Metrics::Metric &metricCounter_                 \
+            = Battlefield::Metrics::instance().counter(NAME);               \
+        metricCounter_.add(AMOUNT);                                         \
+    } while (false)
+
+#endif
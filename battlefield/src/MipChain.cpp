@@ -0,0 +1,128 @@
+/*
+ * File: MipChain.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the MipChain class, defined in MipChain.hpp.
+ */
+
+// Import class definition
+#include "MipChain.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+
+// Total bytes in a chain for a w x h image
+size_t MipChain::byteCount(uint32_t width, uint32_t height) {
+    size_t bytes = 0;
+    while (true) {
+        bytes += size_t(width) * height * 3;
+        if (width == 1 && height == 1)
+            return bytes;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+}
+
+void MipChain::layOut(uint32_t width, uint32_t height, const unsigned char *base) {
+    levels.clear();
+    while (true) {
+        Level l = { width, height, base };
+        levels.push_back(l);
+        base += size_t(width) * height * 3;
+        if (width == 1 && height == 1)
+            return;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+}
+
+MipChain::MipChain(uint32_t width, uint32_t height, const unsigned char *pixels) {
+    storage.resize(byteCount(width, height));
+    std::memcpy(&storage[0], pixels, size_t(width) * height * 3);
+    layOut(width, height, &storage[0]);
+
+    // Each level is a 2x2 box filter of the one above it (or 2x1/1x2 once
+    // one of the dimensions has reached 1)
+    for (size_t i = 1; i < levels.size(); i++) {
+        const Level &src = levels[i - 1];
+        unsigned char *dst = &storage[levels[i].pixels - &storage[0]];
+        for (uint32_t y = 0; y < levels[i].height; y++) {
+            uint32_t y0 = std::min(2 * y, src.height - 1),
+                     y1 = std::min(2 * y + 1, src.height - 1);
+            for (uint32_t x = 0; x < levels[i].width; x++) {
+                uint32_t x0 = std::min(2 * x, src.width - 1),
+                         x1 = std::min(2 * x + 1, src.width - 1);
+                for (int c = 0; c < 3; c++) {
+                    unsigned sum = src.pixels[(size_t(y0) * src.width + x0) * 3 + c]
+                                 + src.pixels[(size_t(y0) * src.width + x1) * 3 + c]
+                                 + src.pixels[(size_t(y1) * src.width + x0) * 3 + c]
+                                 + src.pixels[(size_t(y1) * src.width + x1) * 3 + c];
+                    dst[(size_t(y) * levels[i].width + x) * 3 + c]
+                        = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+MipChainPtr MipChain::load(const string &filename,
+                           uint64_t sourceSize, int64_t sourceTime) {
+    MipChainPtr chain(new MipChain());
+    if (! chain->file.open(filename) || chain->file.size() < sizeof(MipFileHeader))
+        return MipChainPtr();
+
+    const MipFileHeader *h = reinterpret_cast<const MipFileHeader *>(chain->file.data());
+    if (std::memcmp(h->magic, MIP_FILE_MAGIC, 4) != 0 || h->version != MIP_FILE_VERSION
+            || h->sourceSize != sourceSize || h->sourceTime != sourceTime
+            || h->width == 0 || h->height == 0
+            || uint64_t(h->width) * h->height > (uint64_t(1) << 32))
+        return MipChainPtr();
+
+    if (chain->file.size() != sizeof(MipFileHeader) + byteCount(h->width, h->height))
+        return MipChainPtr();
+
+    chain->layOut(h->width, h->height, chain->file.data() + sizeof(MipFileHeader));
+    if (chain->levels.size() != h->levels)
+        return MipChainPtr();
+    return chain;
+}
+
+bool MipChain::store(const string &filename,
+                     uint64_t sourceSize, int64_t sourceTime) const {
+    MipFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, MIP_FILE_MAGIC, 4);
+    h.version    = MIP_FILE_VERSION;
+    h.width      = levels[0].width;
+    h.height     = levels[0].height;
+    h.levels     = uint32_t(levels.size());
+    h.sourceSize = sourceSize;
+    h.sourceTime = sourceTime;
+
+    // Write to a temporary file and move it into place, so that nobody
+    // ever maps a half-written one
+    string temporary = filename + ".tmp";
+    FILE *out = std::fopen(temporary.c_str(), "wb");
+    if (out == NULL)
+        return false;
+    size_t bytes = byteCount(h.width, h.height);
+    bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1
+           && std::fwrite(levels[0].pixels, 1, bytes, out) == bytes;
+    if (std::fclose(out) != 0)
+        ok = false;
+
+    std::remove(filename.c_str());      // Windows won't rename over it
+    if (! ok || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+/*
+ * File: MipChain.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The MipChain class holds an 8-bit RGB image along with all of its
+ *      box-filtered mip levels, down to 1x1. A chain can be built from
+ *      decoded pixels, or loaded from a .mips cache file, which is mapped
+ *      into memory and used in place:
+ *
+ *          MipFileHeader                   magic, version, size & source info
+ *          unsigned char[3 * w * h]        level 0
+ *          unsigned char[3 * w/2 * h/2]    level 1 ... and so on to 1x1
+ *
+ *      The header records the size & modification time of the image the
+ *      chain was built from, so that a stale cache file can be spotted.
+ */
+
+#ifndef BATTLEFIELD_MIP_CHAIN
+#define BATTLEFIELD_MIP_CHAIN
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the file mapping class
+#include "MappedFile.hpp"
+
+// Import STL
+#include <vector>
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class MipChain;
+    struct MipFileHeader;
+
+    // Pointer type definitions
+    typedef shared_ptr<MipChain> MipChainPtr;
+
+    // Format identification
+    const char     MIP_FILE_MAGIC[4] = { 'B', 'F', 'M', 'P' };
+    const uint32_t MIP_FILE_VERSION  = 1;
+};
+
+
+struct Battlefield::MipFileHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t width, height, levels;
+    uint32_t reserved;
+    uint64_t sourceSize;            // Of the image file this came from
+    int64_t  sourceTime;            // Its modification time (seconds)
+};
+
+
+class Battlefield::MipChain {
+public:
+    // One level of the chain
+    struct Level {
+        uint32_t width, height;
+        const unsigned char * pixels;   // RGB, bottom row first
+    };
+
+    // Build a chain from a w x h RGB image (copying the pixels)
+    MipChain(uint32_t width, uint32_t height, const unsigned char *pixels);
+
+    // Load a chain from a .mips file, returning NULL if the file is missing
+    // or damaged, or wasn't built from an image of this size & time
+    static MipChainPtr load(const string &filename,
+                            uint64_t sourceSize, int64_t sourceTime);
+
+    // Write the chain to a .mips file, returning false if we couldn't
+    bool store(const string &filename, uint64_t sourceSize, int64_t sourceTime) const;
+
+    // The levels, from full size (0) down to 1x1
+    size_t levelCount() const { return levels.size(); }
+    const Level & level(size_t i) const { return levels[i]; }
+
+protected:
+    MipChain() { }
+
+    // Work out where each level goes, starting at 'base', for a w x h image
+    void layOut(uint32_t width, uint32_t height, const unsigned char *base);
+    static size_t byteCount(uint32_t width, uint32_t height);
+
+    std::vector<Level> levels;
+    std::vector<unsigned char> storage;     // Pixels, if we built them...
+    MappedFile file;                        // ...or the file they're in
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * File: ModelCache.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the ModelCache class, defined in ModelCache.hpp.
+ */
+
+// Import class definition
+#include "ModelCache.hpp"
+using namespace Battlefield;
+
+// Import the .mesh format & file mapping
+#include "MeshFile.hpp"
+#include "MappedFile.hpp"
+#include "TextureCache.hpp"
+
+// Import Inca stuff
+#include <io/IOUtilities.h++>
+using namespace Inca::IO;
+
+// Import STL
+#include <vector>
+
+typedef SolidObject3D::LinearApproximation PolygonMesh;
+typedef SolidObject3D::LinearApproximationPtr PolygonMeshPtr;
+
+
+ModelCache & ModelCache::instance() {
+    static ModelCache cache;
+    return cache;
+}
+
+SolidObject3DPtr ModelCache::model(const string &filename) {
+    // Find (or make) the entry for this file
+    EntryPtr entry;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        EntryPtr &e = entries[filename];
+        if (e == NULL)
+            e = EntryPtr(new Entry());
+        entry = e;
+    }
+
+    // Load it, unless somebody beat us to it. We hold only this entry's
+    // lock while we do, so other models can load at the same time.
+    std::lock_guard<std::mutex> guard(entry->lock);
+    if (entry->model == NULL) {
+        SolidObject3DPtr loaded = loadMesh(meshFilename(filename));
+        if (loaded == NULL)
+            loaded = static_pointer_cast<SolidObject3D>(loadModel(filename));
+        entry->model = loaded;
+        std::lock_guard<std::mutex> countGuard(lock);
+        loads++;
+    }
+    return entry->model;
+}
+
+SolidObject3DPtr ModelCache::loadMesh(const string &filename) {
+    MappedFile file(filename);
+    MeshFileView view;
+    if (! view.open(file.data(), file.size()))
+        return SolidObject3DPtr();
+
+    // Vertices, normals & texture coordinates go straight from the arrays
+    PolygonMeshPtr mesh(new PolygonMesh());
+    const float *p = view.vertices();
+    std::vector<PolygonMesh::VertexPtr> vertices(view.vertexCount());
+    for (uint32_t i = 0; i < view.vertexCount(); i++, p += 3)
+        vertices[i] = mesh->createVertex(PolygonMesh::Point(p[0], p[1], p[2]));
+
+    p = view.normals();
+    std::vector<index_t> normals(view.normalCount());
+    for (uint32_t i = 0; i < view.normalCount(); i++, p += 3)
+        normals[i] = mesh->createNormal(PolygonMesh::Vector(p[0], p[1], p[2]));
+
+    p = view.texCoords();
+    std::vector<index_t> texCoords(view.texCoordsCount());
+    for (uint32_t i = 0; i < view.texCoordsCount(); i++, p += 2)
+        texCoords[i] = mesh->createTexCoords(PolygonMesh::TexCoords(p[0], p[1]));
+
+    // Put the polygons together from their corners
+    const MeshFace *face = view.faces();
+    const MeshFaceVertex *corners = view.faceVertices();
+    PolygonMesh::FaceVertexPtrList faceVertices;
+    for (uint32_t f = 0; f < view.faceCount(); f++) {
+        faceVertices.clear();
+        for (uint32_t c = face[f].firstVertex;
+                      c < face[f].firstVertex + face[f].vertexCount; c++) {
+            PolygonMesh::FaceVertexPtr fv
+                = mesh->createFaceVertex(vertices[corners[c].vertex]);
+            if (corners[c].normal != MESH_NONE)
+                fv->setNormalIndex(normals[corners[c].normal]);
+            if (corners[c].texCoords != MESH_NONE)
+                fv->setTexCoordsIndex(texCoords[corners[c].texCoords]);
+            faceVertices.push_back(fv);
+        }
+        mesh->createFace(faceVertices);
+    }
+
+    SolidObject3DPtr obj(new SolidObject3D());
+    obj->addApproximation(mesh);
+
+    // Textures are named relative to the .mesh file
+    string::size_type slash = filename.find_last_of("/\\");
+    string directory = (slash == string::npos) ? string() : filename.substr(0, slash + 1);
+    const MeshMaterial *m = view.materials();
+    for (uint32_t i = 0; i < view.materialCount(); i++) {
+        MaterialPtr mat(new Material());
+        mat->ambient  = Material::Color(m[i].ambient[0], m[i].ambient[1], m[i].ambient[2]);
+        mat->diffuse  = Material::Color(m[i].diffuse[0], m[i].diffuse[1], m[i].diffuse[2]);
+        mat->specular = Material::Color(m[i].specular[0], m[i].specular[1], m[i].specular[2]);
+        mat->shininess = m[i].shininess;
+        mat->illuminated = true;
+        if (m[i].texture[0] != '\0')
+            TextureCache::instance().bind(mat, directory + m[i].texture);
+        obj->addMaterial(mat);
+    }
+    return obj;
+}
+
+size_t ModelCache::size() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.size();
+}
+
+size_t ModelCache::loadCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return loads;
+}
+
+void ModelCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+}
@@ -0,0 +1,80 @@
+/*
+ * File: ModelCache.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The ModelCache class is a process-wide cache of the models that units
+ *      are built from, keyed by filename. Each model file is loaded once, the
+ *      first time anybody asks for it, and every unit of that type then
+ *      shares its geometry (approximations), which must not be modified.
+ *
+ *      Materials are NOT shared, since units change theirs to show whether
+ *      they're selected. Units should add copies of the model's materials.
+ *
+ *      If there's a .mesh file next to the model file (e.g., data/t62.mesh
+ *      for data/t62.obj), that gets mapped in and used instead, which is a
+ *      lot faster than having the model file parsed.
+ *
+ *      The cache is safe to use from multiple threads. Two threads asking
+ *      for the same model at once will wait on a single load; two threads
+ *      asking for different models will load them side by side.
+ */
+
+#ifndef BATTLEFIELD_MODEL_CACHE
+#define BATTLEFIELD_MODEL_CACHE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <map>
+#include <memory>
+#include <mutex>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class ModelCache;
+};
+
+
+class Battlefield::ModelCache {
+public:
+    // Singleton access function
+    static ModelCache & instance();
+
+    // Get the model stored in 'filename', loading it if nobody has yet.
+    // Throws whatever loadModel() throws if the file can't be loaded (in
+    // which case the next request for it will try again).
+    SolidObject3DPtr model(const string &filename);
+
+    // How many models are loaded, and how many times we've had to go to disk
+    size_t size() const;
+    size_t loadCount() const;
+
+    // Forget everything (units already built keep their geometry)
+    void clear();
+
+    // Build a model from a .mesh file, or return NULL if we can't. This is
+    // what model() does first, without the caching.
+    static SolidObject3DPtr loadMesh(const string &filename);
+
+protected:
+    ModelCache() : loads(0) { }
+
+    // One cached model, which is loaded by whoever first asks for it
+    struct Entry {
+        std::mutex lock;
+        SolidObject3DPtr model;
+    };
+    typedef std::shared_ptr<Entry> EntryPtr;
+
+    mutable std::mutex lock;        // Guards 'entries' & 'loads'
+    std::map<string, EntryPtr> entries;
+    size_t loads;
+};
+
+#endif
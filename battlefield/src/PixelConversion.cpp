@@ -0,0 +1,77 @@
+/*
+ * File: PixelConversion.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the pixel converters declared in
+ *      PixelConversion.hpp.
+ */
+
+// Import function definitions
+#include "PixelConversion.hpp"
+#include "CpuFeatures.hpp"
+using namespace Battlefield;
+
+#if BATTLEFIELD_X86
+#   include <tmmintrin.h>
+#endif
+
+
+void Battlefield::flipBGRAToRGBScalar(const unsigned char *bgra, unsigned char *rgb,
+                                      uint32_t width, uint32_t height) {
+    for (uint32_t y = 0; y < height; y++) {
+        const unsigned char *src = bgra + size_t(height - 1 - y) * width * 4;
+        unsigned char *dst = rgb + size_t(y) * width * 3;
+        for (uint32_t x = 0; x < width; x++, src += 4, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+    }
+}
+
+#if BATTLEFIELD_X86
+
+// Four pixels at a time: each 16-byte load of BGRA is shuffled down to 12
+// bytes of RGB, and stored as 16 (the extra 4 get overwritten by the next
+// store). So we stop the vector loop while there are still at least two
+// pixels left in the row, and let the scalar loop finish it.
+BATTLEFIELD_TARGET("ssse3")
+void Battlefield::flipBGRAToRGBSSSE3(const unsigned char *bgra, unsigned char *rgb,
+                                     uint32_t width, uint32_t height) {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                          -1, -1, -1, -1);
+    for (uint32_t y = 0; y < height; y++) {
+        const unsigned char *src = bgra + size_t(height - 1 - y) * width * 4;
+        unsigned char *dst = rgb + size_t(y) * width * 3;
+        uint32_t x = 0;
+        for (; x + 6 <= width; x += 4, src += 16, dst += 12) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                             _mm_shuffle_epi8(pixels, shuffle));
+        }
+        for (; x < width; x++, src += 4, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+    }
+}
+
+#else
+
+void Battlefield::flipBGRAToRGBSSSE3(const unsigned char *bgra, unsigned char *rgb,
+                                     uint32_t width, uint32_t height) {
+    flipBGRAToRGBScalar(bgra, rgb, width, height);
+}
+
+#endif
+
+PixelConverter Battlefield::selectPixelConverter() {
+    if (cpuHasSSSE3())
+        return flipBGRAToRGBSSSE3;
+    return flipBGRAToRGBScalar;
+}
@@ -0,0 +1,42 @@
+/*
+ * File: PixelConversion.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      Pixel-format conversion for captured frames. OpenGL hands us frames
+ *      as BGRA (the fastest format for most drivers to read back), bottom
+ *      row first; image files want RGB, top row first. The converters do
+ *      both at once. There's a vectorized version for SSSE3 and a scalar
+ *      fallback, and the best one is picked at run time.
+ */
+
+#ifndef BATTLEFIELD_PIXEL_CONVERSION
+#define BATTLEFIELD_PIXEL_CONVERSION
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Signature of a converter from a w x h bottom-up BGRA image (4 * w
+    // bytes per row) to a top-down RGB one (3 * w bytes per row)
+    typedef void (*PixelConverter)(const unsigned char *bgra, unsigned char *rgb,
+                                   uint32_t width, uint32_t height);
+
+    // The available implementations
+    void flipBGRAToRGBScalar(const unsigned char *bgra, unsigned char *rgb,
+                             uint32_t width, uint32_t height);
+    void flipBGRAToRGBSSSE3(const unsigned char *bgra, unsigned char *rgb,
+                            uint32_t width, uint32_t height);
+
+    // Pick the fastest implementation this processor can run
+    PixelConverter selectPixelConverter();
+};
+
+#endif
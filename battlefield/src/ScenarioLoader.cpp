@@ -0,0 +1,312 @@
+/*
+ * File: ScenarioLoader.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the ScenarioLoader class, defined in
+ *      ScenarioLoader.hpp.
+ */
+
+// Import class definition
+#include "ScenarioLoader.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "Trace.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <cstdlib>
+
+
+// Defaults for the generators
+const double DEFAULT_GRID_SPACING = 0.4;
+const double DEFAULT_ARMY_SPACING = 0.4;
+const unsigned int DEFAULT_ARMY_SEED = 1;
+
+const double DEGREES = Transform::PI / 180.0;
+
+
+// Constructor
+ScenarioLoader::ScenarioLoader(BattleScenePtr s)
+    : scene(s), lineNumber(0) { }
+
+
+bool ScenarioLoader::load(const string &filename) {
+    MappedFile file(filename);
+    if (! file.isOpen()) {
+        BATTLEFIELD_LOG(Error, "Couldn't read scenario " << filename);
+        return false;
+    }
+    return load(reinterpret_cast<const char *>(file.data()), file.size(), filename);
+}
+
+bool ScenarioLoader::load(const char *text, size_t length, const string &source) {
+    BATTLEFIELD_TRACE_SCOPE("load scenario");
+    sourceName = source;
+    lineNumber = 0;
+    size_t before = scene->battleUnitCount();
+
+    // Split each line into words as we go, and run it right away
+    WordList words;
+    const char *p = text, *end = text + length;
+    while (p < end) {
+        lineNumber++;
+        words.clear();
+        bool quoted = false, comment = false;
+        string word;
+        for (; p < end && *p != '\n'; p++) {
+            char c = *p;
+            if (comment) {
+                continue;
+            } else if (quoted) {
+                if (c == '"') {
+                    words.push_back(word);
+                    word.clear();
+                    quoted = false;
+                } else {
+                    word += c;
+                }
+            } else if (c == '"' && word.empty()) {
+                quoted = true;
+            } else if (c == '#') {
+                comment = true;
+            } else if (c == ' ' || c == '\t' || c == '\r') {
+                if (! word.empty()) {
+                    words.push_back(word);
+                    word.clear();
+                }
+            } else {
+                word += c;
+            }
+        }
+        p++;        // Past the newline
+
+        if (quoted) {
+            complain("unterminated quote");
+            return false;
+        }
+        if (! word.empty())
+            words.push_back(word);
+        if (! words.empty() && ! runCommand(words))
+            return false;
+    }
+
+    BATTLEFIELD_LOG(Info, "Loaded " << (scene->battleUnitCount() - before)
+                          << " units from " << sourceName);
+    return true;
+}
+
+BattleUnitPtr ScenarioLoader::unitNamed(const string &name) const {
+    std::unordered_map<string, BattleUnitPtr>::const_iterator i = named.find(name);
+    return i == named.end() ? BattleUnitPtr() : i->second;
+}
+
+
+bool ScenarioLoader::runCommand(const WordList &w) {
+    const string &command = w[0];
+    Point at(0.0, 0.0, 0.0);
+    Vector offset(0.0);
+    double heading = 0.0, spacing = -1.0, value;
+    size_t team = 0, seed = DEFAULT_ARMY_SEED;
+    bool hasTeam = false, follow = false, relative = false;
+
+    // How many words come before the options, for each command
+    size_t positional;
+    if (command == "unit" || command == "follow")   positional = 3;
+    else if (command == "row" || command == "grid") positional = 4;
+    else if (command == "diamond" || command == "triangle")
+                                                    positional = 3;
+    else if (command == "army")                     positional = 2;
+    else if (command == "standard")                 positional = 1;
+    else {
+        complain("unknown command '" + command + "'");
+        return false;
+    }
+    if (w.size() < positional) {
+        complain("not enough arguments to '" + command + "'");
+        return false;
+    }
+
+    // Pick up the options
+    for (size_t i = positional; i < w.size(); i++) {
+        const string &option = w[i];
+        if (option == "at" || option == "offset") {
+            double x, z;
+            if (! number(w, i + 1, x) || ! number(w, i + 2, z))
+                return false;
+            if (option == "at")
+                at = Point(x, 0.0, z);
+            else
+                offset = Vector(x, 0.0, z);
+            i += 2;
+        } else if (option == "heading") {
+            if (! number(w, ++i, value))
+                return false;
+            heading = value * DEGREES;
+        } else if (option == "spacing") {
+            if (! number(w, ++i, spacing))
+                return false;
+        } else if (option == "team") {
+            if (! count(w, ++i, team))
+                return false;
+            hasTeam = true;
+        } else if (option == "seed") {
+            if (! count(w, ++i, seed))
+                return false;
+        } else if (option == "follow") {
+            follow = true;
+        } else if (option == "relative") {
+            relative = true;
+        } else {
+            complain("unknown option '" + option + "' to '" + command + "'");
+            return false;
+        }
+    }
+
+    size_t before = scene->battleUnitCount();
+    UnitType type;
+
+    if (command == "unit") {
+        if (named.count(w[1]) != 0) {
+            complain("there's already a unit called '" + w[1] + "'");
+            return false;
+        }
+        if (! unitType(w[2], type))
+            return false;
+        UnitPlacement placement(at, Quaternion(), heading);
+        if (scene->spawnUnits(type, 1, &placement) == 0)
+            return false;
+        BattleUnitPtr unit = scene->battleUnit(before);
+        if (hasTeam)
+            unit->team = (unsigned int)team;
+        named[w[1]] = unit;
+
+    } else if (command == "follow") {
+        BattleUnitPtr unit = namedUnit(w[1]), leader = namedUnit(w[2]);
+        if (unit == NULL || leader == NULL)
+            return false;
+        unit->target = leader;
+        unit->targetOffset = offset;
+        unit->relativeOffset = relative;
+
+    } else if (command == "row" || command == "diamond" || command == "triangle") {
+        BattleUnitPtr leader = namedUnit(w[1]);
+        if (leader == NULL || ! unitType(w[2], type))
+            return false;
+        if (command == "row") {
+            size_t number;
+            if (! count(w, 3, number))
+                return false;
+            scene->createRow(leader, type, offset, number);
+        } else if (command == "diamond") {
+            scene->createDiamond(leader, type, offset);
+        } else {
+            scene->createTriangle(leader, type, offset);
+        }
+
+        // Formations fight on their leader's side
+        unsigned int side = leader->team;
+        for (size_t i = before; i < scene->battleUnitCount(); i++)
+            scene->battleUnit(i)->team = side;
+
+    } else if (command == "grid") {
+        size_t columns, rows;
+        if (! unitType(w[1], type) || ! count(w, 2, columns) || ! count(w, 3, rows))
+            return false;
+        if (spacing < 0.0)
+            spacing = DEFAULT_GRID_SPACING;
+
+        // Make the whole block at once, facing the right way...
+        size_t total = columns * rows;
+        std::vector<UnitPlacement> placements(total, UnitPlacement(at, Quaternion(), heading));
+        if (total != 0 && scene->spawnUnits(type, total, &placements[0]) < total)
+            return false;
+
+        // ...then lay it out around its center, in its own frame
+        Vector corner(-0.5 * spacing * (double(columns) - 1.0), 0.0,
+                      -0.5 * spacing * (double(rows) - 1.0));
+        for (size_t i = 0; i < total; i++) {
+            size_t r = i / columns, c = i % columns;
+            BattleUnitPtr unit = scene->battleUnit(before + i);
+            Vector place = corner + Vector(c * spacing, 0.0, r * spacing);
+            unit->transform->setLocationPoint(
+                new Point(at + unit->transform->rotation().rotate(place)));
+            if (hasTeam)
+                unit->team = (unsigned int)team;
+            if (follow && c != 0) {
+                unit->target = scene->battleUnit(before + i - 1);
+                unit->targetOffset = Vector(-spacing, 0.0, 0.0);
+                unit->relativeOffset = true;
+            }
+        }
+
+    } else if (command == "army") {
+        size_t number;
+        if (! count(w, 1, number))
+            return false;
+        if (spacing < 0.0)
+            spacing = DEFAULT_ARMY_SPACING;
+        scene->createArmy(number, spacing, (unsigned int)seed);
+
+    } else {    // standard
+        scene->createTeam();
+    }
+
+    // Apply the team to anything the generators made
+    if (hasTeam && (command == "army" || command == "standard"))
+        for (size_t i = before; i < scene->battleUnitCount(); i++)
+            scene->battleUnit(i)->team = (unsigned int)team;
+    return true;
+}
+
+
+bool ScenarioLoader::number(const WordList &w, size_t i, double &value) {
+    if (i >= w.size()) {
+        complain("missing number after '" + w[i - 1] + "'");
+        return false;
+    }
+    char *end;
+    value = std::strtod(w[i].c_str(), &end);
+    if (*end != '\0' || end == w[i].c_str()) {
+        complain("'" + w[i] + "' isn't a number");
+        return false;
+    }
+    return true;
+}
+
+bool ScenarioLoader::count(const WordList &w, size_t i, size_t &value) {
+    if (i >= w.size()) {
+        complain("missing count after '" + w[i - 1] + "'");
+        return false;
+    }
+    char *end;
+    value = size_t(std::strtoul(w[i].c_str(), &end, 10));
+    if (*end != '\0' || end == w[i].c_str() || w[i][0] == '-') {
+        complain("'" + w[i] + "' isn't a count");
+        return false;
+    }
+    return true;
+}
+
+bool ScenarioLoader::unitType(const string &name, UnitType &type) {
+    type = unitTypeNamed(name);
+    if (type == NoUnitType) {
+        complain("unknown unit type '" + name + "'");
+        return false;
+    }
+    return true;
+}
+
+BattleUnitPtr ScenarioLoader::namedUnit(const string &name) {
+    BattleUnitPtr unit = unitNamed(name);
+    if (unit == NULL)
+        complain("no unit called '" + name + "'");
+    return unit;
+}
+
+void ScenarioLoader::complain(const string &problem) {
+    BATTLEFIELD_LOG(Error, sourceName << ":" << lineNumber << ": " << problem);
+}
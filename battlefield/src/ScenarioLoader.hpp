@@ -0,0 +1,95 @@
+/*
+ * File: ScenarioLoader.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The ScenarioLoader class sets up a battle from a scenario file, so
+ *      that the layout of the armies doesn't have to be compiled in.
+ *
+ *      A scenario file is a list of commands, one per line. Anything from a
+ *      '#' to the end of the line is a comment. Unit type names with spaces
+ *      in them must be quoted (e.g., "light tank"). Angles are in degrees,
+ *      and options may be given in any order.
+ *
+ *          unit NAME TYPE [at X Z] [heading A] [team N]
+ *              A single unit, which later commands can refer to by NAME
+ *          follow NAME LEADER offset DX DZ [relative]
+ *              Have NAME keep station at an offset from LEADER
+ *          row LEADER TYPE COUNT offset DX DZ
+ *          diamond LEADER TYPE offset DX DZ
+ *          triangle LEADER TYPE offset DX DZ
+ *              A formation of new units following LEADER (and on its team)
+ *          grid TYPE COLUMNS ROWS [at X Z] [spacing S] [heading A]
+ *                                 [team N] [follow]
+ *              A block of units centered on (X, Z). With 'follow', each
+ *              unit follows the one beside it in its row.
+ *          army COUNT [spacing S] [seed N]
+ *              A random army, as with BattleScene::createArmy()
+ *          standard
+ *              The standard four-formation battle
+ *
+ *      The file is mapped in and read a line at a time, and each command
+ *      creates its units (in one batch, with BattleScene::spawnUnits()) as
+ *      soon as it's read, so a scenario is never held in memory in any
+ *      other form. Only named units are remembered.
+ */
+
+#ifndef BATTLEFIELD_SCENARIO_LOADER
+#define BATTLEFIELD_SCENARIO_LOADER
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class ScenarioLoader;
+};
+
+// Import other battle type definitions
+#include "BattleScene.hpp"
+
+// Import STL
+#include <unordered_map>
+#include <vector>
+
+
+class Battlefield::ScenarioLoader {
+public:
+    // Constructor, giving the scene to put the units in
+    explicit ScenarioLoader(BattleScenePtr scene);
+
+    // Load the scenario in 'filename', or one that's already in memory
+    // ('source' is what to call it in error messages). These stop at the
+    // first bad command, returning false, with whatever units were created
+    // before it still in the scene.
+    bool load(const string &filename);
+    bool load(const char *text, size_t length, const string &source);
+
+    // A unit named in the scenario (or NULL)
+    BattleUnitPtr unitNamed(const string &name) const;
+
+protected:
+    // One command, already split into words
+    typedef std::vector<string> WordList;
+    bool runCommand(const WordList &words);
+
+    // Word-reading helpers, which complain if the word isn't what we want
+    bool number(const WordList &words, size_t i, double &value);
+    bool count(const WordList &words, size_t i, size_t &value);
+    bool unitType(const string &name, UnitType &type);
+    BattleUnitPtr namedUnit(const string &name);
+
+    // Things to complain about, which say where in the scenario they are
+    void complain(const string &problem);
+
+    BattleScenePtr scene;
+    std::unordered_map<string, BattleUnitPtr> named;
+    string sourceName;
+    size_t lineNumber;
+};
+
+#endif
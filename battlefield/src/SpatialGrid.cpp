@@ -0,0 +1,67 @@
+/*
+ * File: SpatialGrid.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the SpatialGrid class, defined in
+ *      SpatialGrid.hpp.
+ */
+
+// Import class definition
+#include "SpatialGrid.hpp"
+using namespace Battlefield;
+
+
+// Smallest bucket table we'll bother with
+const size_t MIN_BUCKET_COUNT = 64;
+
+
+void SpatialGrid::resize(size_t n) {
+    px.resize(n);
+    py.resize(n);
+    pz.resize(n);
+}
+
+void SpatialGrid::rebuild() {
+    size_t n = size();
+
+    // Size the bucket table at about two buckets per body
+    size_t buckets = MIN_BUCKET_COUNT;
+    while (buckets < 2 * n)
+        buckets <<= 1;
+    bucketMask = buckets - 1;
+
+    // Count the bodies landing in each bucket
+    bucketStart.assign(buckets + 1, 0);
+    bodyBucket.resize(n);
+    for (index_t i = 0; i < n; i++) {
+        bodyBucket[i] = bucketOf(cellOf(px[i]), cellOf(pz[i]));
+        bucketStart[bodyBucket[i] + 1]++;
+    }
+
+    // Turn the counts into starting offsets
+    for (size_t b = 0; b < buckets; b++)
+        bucketStart[b + 1] += bucketStart[b];
+
+    // Scatter the bodies into their buckets. Since we walk them in index
+    // order, each bucket ends up sorted by body index.
+    entryIndex.resize(n);
+    entryCellX.resize(n);
+    entryCellZ.resize(n);
+    entryX.resize(n);
+    entryY.resize(n);
+    entryZ.resize(n);
+    bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+    for (index_t i = 0; i < n; i++) {
+        index_t e = bucketFill[bodyBucket[i]]++;
+        entryIndex[e] = i;
+        entryCellX[e] = cellOf(px[i]);
+        entryCellZ[e] = cellOf(pz[i]);
+        entryX[e] = px[i];
+        entryY[e] = py[i];
+        entryZ[e] = pz[i];
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * File: SpatialGrid.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The SpatialGrid class is a uniform-grid spatial hash over the
+ *      positions of the bodies in the rigid-body system. It is rebuilt once
+ *      per pass from the SystemState, after which a unit can find its
+ *      neighbours by visiting only the cells around it, rather than every
+ *      other body in the battle.
+ *
+ *      Cells are square in the ground (XZ) plane and are hashed into a
+ *      power-of-two bucket table. The contents of each bucket are stored
+ *      contiguously (counting sort), in ascending body index order, so that
+ *      queries are cache-friendly and visit neighbours in a deterministic
+ *      order.
+ */
+
+#ifndef BATTLEFIELD_SPATIAL_GRID
+#define BATTLEFIELD_SPATIAL_GRID
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+#include <cmath>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class SpatialGrid;
+
+    // Pointer type definitions
+    typedef shared_ptr<SpatialGrid> SpatialGridPtr;
+};
+
+
+class Battlefield::SpatialGrid {
+public:
+    // Geometric types
+    typedef Transform::scalar_t scalar_t;
+    typedef Transform::Point    Point;
+
+    // Constructor, giving the edge length of a grid cell
+    SpatialGrid(scalar_t cs) : _cellSize(cs), _enabled(true) { }
+
+    // Grid configuration
+    scalar_t cellSize() const { return _cellSize; }
+    bool enabled() const { return _enabled; }
+    void setEnabled(bool e) { _enabled = e; }
+
+    // Number of bodies indexed by the grid
+    size_t size() const { return px.size(); }
+
+    // Load the body positions, then sort them into their cells
+    void resize(size_t n);
+    void setPosition(index_t i, const Point &p) {
+        px[i] = p[0];   py[i] = p[1];   pz[i] = p[2];
+    }
+    void rebuild();
+
+    // Call visit(j) for each body j (other than 'self') that lies within
+    // 'radius' of body 'self'. The radius check is done in 3D, so the same
+    // neighbours are found as if every body had been tested -- though they
+    // come in cell order, so sums over them may round a little differently.
+    template <class Visitor>
+    void forEachNeighbour(index_t self, scalar_t radius,
+                          Visitor visit) const {
+        scalar_t x = px[self], y = py[self], z = pz[self];
+        scalar_t r2 = radius * radius;
+        int span = int(std::ceil(radius / _cellSize));
+        int cx = cellOf(x), cz = cellOf(z);
+        for (int i = cx - span; i <= cx + span; i++)
+            for (int k = cz - span; k <= cz + span; k++) {
+                size_t b = bucketOf(i, k);
+                for (index_t e = bucketStart[b]; e < bucketStart[b + 1]; e++) {
+                    // Skip hash collisions with some other cell
+                    if (entryCellX[e] != i || entryCellZ[e] != k)
+                        continue;
+
+                    index_t j = entryIndex[e];
+                    if (j == self)
+                        continue;
+
+                    scalar_t dx = x - entryX[e],
+                             dy = y - entryY[e],
+                             dz = z - entryZ[e];
+                    if (dx * dx + dy * dy + dz * dz < r2)
+                        visit(j);
+                }
+            }
+    }
+
+protected:
+    // Cell and bucket calculations
+    int cellOf(scalar_t c) const { return int(std::floor(c / _cellSize)); }
+    size_t bucketOf(int cx, int cz) const {
+        return size_t((unsigned(cx) * 73856093u) ^ (unsigned(cz) * 19349663u))
+             & bucketMask;
+    }
+
+    scalar_t _cellSize;
+    bool _enabled;
+
+    // Body positions, indexed by body
+    std::vector<scalar_t> px, py, pz;
+
+    // Bucket table: bucket b holds entries [bucketStart[b], bucketStart[b+1])
+    std::vector<index_t> bucketStart;
+    size_t bucketMask;
+
+    // Per-entry data, sorted by bucket
+    std::vector<index_t>  entryIndex;
+    std::vector<int>      entryCellX, entryCellZ;
+    std::vector<scalar_t> entryX, entryY, entryZ;
+
+    // Scratch space used during the rebuild
+    std::vector<size_t>   bodyBucket;
+    std::vector<index_t>  bucketFill;
+};
+
+#endif
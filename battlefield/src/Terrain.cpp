@@ -0,0 +1,351 @@
+/*
+ * File: Terrain.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the Terrain class, defined in Terrain.hpp.
+ */
+
+// Import class definition
+#include "Terrain.hpp"
+#include "CpuFeatures.hpp"
+#include "Log.hpp"
+using namespace Battlefield;
+
+// Import vector intrinsics
+#if BATTLEFIELD_X86
+#   include <immintrin.h>
+#endif
+
+// Import STL & file info stuff
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+// The vector version finds its way around the tiles with shifts & masks
+static_assert(Terrain::TILE_CELLS == 32, "queryAVX2() assumes 32-cell tiles");
+const int TILE_SHIFT = 5;
+
+// Weights for turning RGB into a height
+const float LUMINANCE_R = 0.299f;
+const float LUMINANCE_G = 0.587f;
+const float LUMINANCE_B = 0.114f;
+
+
+// Constructor
+Terrain::Terrain(size_t samplesX, size_t samplesZ, const float *heights,
+                 scalar_t spacing) {
+    layOut(samplesX, samplesZ, spacing);
+    tiles.resize(tilesX * tilesZ * TILE_SIZE);
+    tileData = &tiles[0];
+
+    // Copy the samples into their tiles, repeating the last row & column
+    // to fill out the tiles at the far edges
+    for (size_t tz = 0; tz < tilesZ; tz++)
+        for (size_t tx = 0; tx < tilesX; tx++) {
+            float *tile = &tiles[(tz * tilesX + tx) * TILE_SIZE];
+            for (size_t z = 0; z < TILE_SAMPLES; z++) {
+                size_t gz = std::min(tz * TILE_CELLS + z, countZ - 1);
+                for (size_t x = 0; x < TILE_SAMPLES; x++) {
+                    size_t gx = std::min(tx * TILE_CELLS + x, countX - 1);
+                    tile[z * TILE_SAMPLES + x] = heights[gz * countX + gx];
+                }
+            }
+        }
+}
+
+void Terrain::layOut(size_t samplesX, size_t samplesZ, scalar_t spacing) {
+    countX = samplesX;
+    countZ = samplesZ;
+    tilesX = (samplesX + TILE_CELLS - 2) / TILE_CELLS;
+    tilesZ = (samplesZ + TILE_CELLS - 2) / TILE_CELLS;
+    cellSize = spacing;
+    inverseCellSize = 1.0 / spacing;
+    originX = -0.5 * spacing * (samplesX - 1);
+    originZ = -0.5 * spacing * (samplesZ - 1);
+
+    // The gathers use 32-bit offsets
+    if (tilesX * tilesZ * TILE_SIZE <= size_t(std::numeric_limits<int>::max()))
+        kernel = selectQueryKernel();
+    else
+        kernel = queryScalar;
+}
+
+TerrainPtr Terrain::flat(scalar_t width, scalar_t length, scalar_t elevation) {
+    float heights[4] = { float(elevation), float(elevation),
+                         float(elevation), float(elevation) };
+    return TerrainPtr(new Terrain(2, 2, heights, std::max(width, length)));
+}
+
+
+TerrainPtr Terrain::load(const string &filename, scalar_t width,
+                         scalar_t base, scalar_t relief) {
+    // The .terrain file is only good if it was made from this version of
+    // the image, scaled the same way
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        BATTLEFIELD_LOG(Error, "Can't find terrain " << filename);
+        return TerrainPtr();
+    }
+    string cacheFile = filename + ".terrain";
+    TerrainPtr terrain = map(cacheFile, width, base, relief,
+                             uint64_t(info.st_size), int64_t(info.st_mtime));
+    if (terrain != NULL)
+        return terrain;
+
+    // If not, decode it the slow way and save it for next time
+    ImagePtr img;
+    try {
+        img = Inca::IO::loadImage(filename);
+    } catch (const Inca::IncaException &e) {
+        BATTLEFIELD_LOG(Error, "Can't load terrain " << filename << ": " << e);
+        return TerrainPtr();
+    }
+    if (img == NULL)
+        return TerrainPtr();
+
+    size_t w = img->size()[0], h = img->size()[1];
+    if (w < 2 || h < 2) {
+        BATTLEFIELD_LOG(Error, "Terrain " << filename << " is too small ("
+                               << w << "x" << h << ")");
+        return TerrainPtr();
+    }
+
+    // Same 8-bit RGB layout that the TextureCache expects
+    const unsigned char *pixels = reinterpret_cast<const unsigned char *>(img->pixels().getContents());
+    std::vector<float> heights(w * h);
+    for (size_t i = 0; i < w * h; i++) {
+        const unsigned char *p = pixels + i * 3;
+        float grey = (LUMINANCE_R * p[0] + LUMINANCE_G * p[1] + LUMINANCE_B * p[2]) / 255.0f;
+        heights[i] = float(base + relief * grey);
+    }
+
+    BATTLEFIELD_LOG(Info, "Loaded " << w << "x" << h << " terrain from " << filename);
+    terrain = TerrainPtr(new Terrain(w, h, &heights[0], width / (w - 1)));
+    if (! terrain->store(cacheFile, base, relief, uint64_t(info.st_size),
+                                                  int64_t(info.st_mtime))) {
+        BATTLEFIELD_LOG(Warning, "Can't write " << cacheFile);
+        return terrain;
+    }
+
+    // Swap the decoded tiles for the file we just wrote, so that this run
+    // pages the heights in like every later one will, instead of keeping
+    // its own copy
+    TerrainPtr mapped = map(cacheFile, width, base, relief,
+                            uint64_t(info.st_size), int64_t(info.st_mtime));
+    return mapped != NULL ? mapped : terrain;
+}
+
+TerrainPtr Terrain::map(const string &filename, scalar_t width,
+                        scalar_t base, scalar_t relief,
+                        uint64_t sourceSize, int64_t sourceTime) {
+    TerrainPtr terrain(new Terrain());
+    if (! terrain->file.open(filename) || terrain->file.size() < sizeof(TerrainFileHeader))
+        return TerrainPtr();
+
+    const TerrainFileHeader *h = reinterpret_cast<const TerrainFileHeader *>(terrain->file.data());
+    if (std::memcmp(h->magic, TERRAIN_FILE_MAGIC, 4) != 0 || h->version != TERRAIN_FILE_VERSION
+            || h->sourceSize != sourceSize || h->sourceTime != sourceTime
+            || h->base != base || h->relief != relief
+            || h->samplesX < 2 || h->samplesZ < 2
+            || h->spacing != width / (h->samplesX - 1))
+        return TerrainPtr();
+
+    terrain->layOut(h->samplesX, h->samplesZ, h->spacing);
+    uint64_t bytes = uint64_t(terrain->tilesX) * terrain->tilesZ * TILE_SIZE * sizeof(float);
+    if (terrain->file.size() != sizeof(TerrainFileHeader) + bytes)
+        return TerrainPtr();
+
+    terrain->tileData = reinterpret_cast<const float *>(terrain->file.data() + sizeof(TerrainFileHeader));
+    return terrain;
+}
+
+bool Terrain::store(const string &filename, scalar_t base, scalar_t relief,
+                    uint64_t sourceSize, int64_t sourceTime) const {
+    TerrainFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, TERRAIN_FILE_MAGIC, 4);
+    h.version    = TERRAIN_FILE_VERSION;
+    h.samplesX   = uint32_t(countX);
+    h.samplesZ   = uint32_t(countZ);
+    h.spacing    = cellSize;
+    h.base       = base;
+    h.relief     = relief;
+    h.sourceSize = sourceSize;
+    h.sourceTime = sourceTime;
+
+    // Write to a temporary file and move it into place, so that nobody
+    // ever maps a half-written one
+    string temporary = filename + ".tmp";
+    FILE *out = std::fopen(temporary.c_str(), "wb");
+    if (out == NULL)
+        return false;
+    size_t count = tilesX * tilesZ * TILE_SIZE;
+    bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1
+           && std::fwrite(tileData, sizeof(float), count, out) == count;
+    if (std::fclose(out) != 0)
+        ok = false;
+
+    if (ok) {
+#if __MS_WINDOZE__
+        // Windows won't rename over an existing file
+        std::remove(filename.c_str());
+#endif
+        ok = std::rename(temporary.c_str(), filename.c_str()) == 0;
+    }
+    if (! ok)
+        std::remove(temporary.c_str());
+    return ok;
+}
+
+
+Terrain::scalar_t Terrain::height(scalar_t x, scalar_t z) const {
+    scalar_t h;
+    queryScalar(*this, 1, &x, &z, &h, NULL, NULL, NULL);
+    return h;
+}
+
+
+// Scalar version -- this is the reference that the vector version must match
+void Terrain::queryScalar(const Terrain &t, size_t n,
+                          const scalar_t *x, const scalar_t *z, scalar_t *h,
+                          scalar_t *nx, scalar_t *ny, scalar_t *nz) {
+    const scalar_t maxX = scalar_t(t.countX - 1), maxZ = scalar_t(t.countZ - 1);
+    const scalar_t lastX = maxX - 1.0, lastZ = maxZ - 1.0;
+    const float *s = t.tileData;
+
+    for (size_t i = 0; i < n; i++) {
+        // Find the cell we're in (or nearest to), and where we are in it.
+        // NaNs go to the first cell, same as in the vector version.
+        scalar_t fx = (x[i] - t.originX) * t.inverseCellSize;
+        scalar_t fz = (z[i] - t.originZ) * t.inverseCellSize;
+        fx = ! (fx > 0.0) ? 0.0 : std::min(fx, maxX);
+        fz = ! (fz > 0.0) ? 0.0 : std::min(fz, maxZ);
+        scalar_t cx = std::min(std::floor(fx), lastX);
+        scalar_t cz = std::min(std::floor(fz), lastZ);
+        scalar_t u = fx - cx, v = fz - cz;
+        size_t ix = size_t(cx), iz = size_t(cz);
+        const float *corner = s
+            + ((iz >> TILE_SHIFT) * t.tilesX + (ix >> TILE_SHIFT)) * TILE_SIZE
+            + (iz & (TILE_CELLS - 1)) * TILE_SAMPLES + (ix & (TILE_CELLS - 1));
+
+        // Bilinear interpolation
+        scalar_t h00 = corner[0],            h10 = corner[1];
+        scalar_t h01 = corner[TILE_SAMPLES], h11 = corner[TILE_SAMPLES + 1];
+        scalar_t dx0 = h10 - h00, dx1 = h11 - h01;
+        scalar_t a = h00 + dx0 * u, b = h01 + dx1 * u;
+        scalar_t dz = b - a;
+        h[i] = a + dz * v;
+
+        // The normal is (-dh/dx, 1, -dh/dz), normalized
+        if (nx != NULL) {
+            scalar_t gx = (dx0 + (dx1 - dx0) * v) * t.inverseCellSize;
+            scalar_t gz = dz * t.inverseCellSize;
+            scalar_t r = 1.0 / std::sqrt(gx * gx + gz * gz + 1.0);
+            nx[i] = -(gx * r);
+            ny[i] = r;
+            nz[i] = -(gz * r);
+        }
+    }
+}
+
+
+#if BATTLEFIELD_X86
+
+// AVX2 version -- four points per register, with the corners fetched by
+// gathers
+BATTLEFIELD_TARGET("avx2")
+void Terrain::queryAVX2(const Terrain &t, size_t n,
+                        const scalar_t *x, const scalar_t *z, scalar_t *h,
+                        scalar_t *nx, scalar_t *ny, scalar_t *nz) {
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d maxX = _mm256_set1_pd(scalar_t(t.countX - 1)),
+                  maxZ = _mm256_set1_pd(scalar_t(t.countZ - 1));
+    const __m256d lastX = _mm256_sub_pd(maxX, one), lastZ = _mm256_sub_pd(maxZ, one);
+    const __m256d originX = _mm256_set1_pd(t.originX),
+                  originZ = _mm256_set1_pd(t.originZ);
+    const __m256d inverse = _mm256_set1_pd(t.inverseCellSize);
+    const __m128i tilesX = _mm_set1_epi32(int(t.tilesX)),
+                  tileSize = _mm_set1_epi32(int(TILE_SIZE)),
+                  tileSamples = _mm_set1_epi32(int(TILE_SAMPLES)),
+                  cellMask = _mm_set1_epi32(int(TILE_CELLS - 1));
+    const float *s = t.tileData;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // Find the cell we're in (or nearest to), and where we are in it
+        __m256d fx = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x + i), originX), inverse);
+        __m256d fz = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(z + i), originZ), inverse);
+        fx = _mm256_min_pd(_mm256_max_pd(fx, zero), maxX);
+        fz = _mm256_min_pd(_mm256_max_pd(fz, zero), maxZ);
+        __m256d cx = _mm256_min_pd(_mm256_floor_pd(fx), lastX);
+        __m256d cz = _mm256_min_pd(_mm256_floor_pd(fz), lastZ);
+        __m256d u = _mm256_sub_pd(fx, cx), v = _mm256_sub_pd(fz, cz);
+        __m128i ix = _mm256_cvttpd_epi32(cx), iz = _mm256_cvttpd_epi32(cz);
+        __m128i tile = _mm_add_epi32(_mm_mullo_epi32(_mm_srli_epi32(iz, TILE_SHIFT), tilesX),
+                                     _mm_srli_epi32(ix, TILE_SHIFT));
+        __m128i offset = _mm_add_epi32(_mm_mullo_epi32(tile, tileSize),
+                         _mm_add_epi32(_mm_mullo_epi32(_mm_and_si128(iz, cellMask), tileSamples),
+                                       _mm_and_si128(ix, cellMask)));
+
+        // Bilinear interpolation
+        __m256d h00 = _mm256_cvtps_pd(_mm_i32gather_ps(s, offset, 4));
+        __m256d h10 = _mm256_cvtps_pd(_mm_i32gather_ps(s + 1, offset, 4));
+        __m256d h01 = _mm256_cvtps_pd(_mm_i32gather_ps(s + TILE_SAMPLES, offset, 4));
+        __m256d h11 = _mm256_cvtps_pd(_mm_i32gather_ps(s + TILE_SAMPLES + 1, offset, 4));
+        __m256d dx0 = _mm256_sub_pd(h10, h00), dx1 = _mm256_sub_pd(h11, h01);
+        __m256d a = _mm256_add_pd(h00, _mm256_mul_pd(dx0, u)),
+                b = _mm256_add_pd(h01, _mm256_mul_pd(dx1, u));
+        __m256d dz = _mm256_sub_pd(b, a);
+        _mm256_storeu_pd(h + i, _mm256_add_pd(a, _mm256_mul_pd(dz, v)));
+
+        // The normal is (-dh/dx, 1, -dh/dz), normalized
+        if (nx != NULL) {
+            __m256d gx = _mm256_mul_pd(_mm256_add_pd(dx0, _mm256_mul_pd(_mm256_sub_pd(dx1, dx0), v)), inverse);
+            __m256d gz = _mm256_mul_pd(dz, inverse);
+            __m256d r = _mm256_div_pd(one, _mm256_sqrt_pd(
+                _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(gx, gx), _mm256_mul_pd(gz, gz)), one)));
+            _mm256_storeu_pd(nx + i, _mm256_xor_pd(sign, _mm256_mul_pd(gx, r)));
+            _mm256_storeu_pd(ny + i, r);
+            _mm256_storeu_pd(nz + i, _mm256_xor_pd(sign, _mm256_mul_pd(gz, r)));
+        }
+    }
+
+    // Whatever's left over
+    if (nx != NULL)
+        queryScalar(t, n - i, x + i, z + i, h + i, nx + i, ny + i, nz + i);
+    else
+        queryScalar(t, n - i, x + i, z + i, h + i, NULL, NULL, NULL);
+}
+
+#else
+
+// No vector units that we know how to use...fall back to scalar
+void Terrain::queryAVX2(const Terrain &t, size_t n,
+                        const scalar_t *x, const scalar_t *z, scalar_t *h,
+                        scalar_t *nx, scalar_t *ny, scalar_t *nz) {
+    queryScalar(t, n, x, z, h, nx, ny, nz);
+}
+
+#endif
+
+
+// Pick the fastest implementation this processor can run
+Terrain::QueryKernel Terrain::selectQueryKernel() {
+    if (cpuHasAVX2())   return queryAVX2;
+    return queryScalar;
+}
+
+const char * Terrain::queryKernelName(QueryKernel k) {
+    if (k == queryAVX2)     return "avx2";
+    return "scalar";
+}
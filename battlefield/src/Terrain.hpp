@@ -0,0 +1,188 @@
+/*
+ * File: Terrain.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The Terrain class is the shape of the ground: a heightfield sampled
+ *      on a square grid, centered on the origin, which can be flat or read
+ *      from a greyscale image (black is the base elevation, white is the
+ *      base plus the relief).
+ *
+ *      The samples are stored in tiles of TILE_CELLS x TILE_CELLS cells.
+ *      Each tile keeps its own copy of the row & column it shares with its
+ *      neighbours, so the four corners of any cell are in the same tile,
+ *      a few hundred bytes apart, and units that are near each other read
+ *      the same few pages of memory.
+ *
+ *      A terrain loaded from an image is saved next to it, already in
+ *      tiles, in a .terrain file (e.g., data/sand02.tif.terrain):
+ *
+ *          TerrainFileHeader               magic, version, size & source info
+ *          float[TILE_SIZE] * tiles        row by row of tiles
+ *
+ *      Later runs map that in and use it in place, so only the tiles that
+ *      something actually looks at (the ground under the units, and what
+ *      the TerrainStreamer is drawing) are ever read into memory, and the
+ *      system can drop them again whenever it likes.
+ *
+ *      Heights & normals are interpolated bilinearly within a cell, and
+ *      held at the edge value outside the field. They are looked up for
+ *      many points at once, with an AVX2 (gather) version and a scalar
+ *      fallback that give identical results; the best one is picked at run
+ *      time, as with the drive kernels.
+ */
+
+#ifndef BATTLEFIELD_TERRAIN
+#define BATTLEFIELD_TERRAIN
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the file mapping class
+#include "MappedFile.hpp"
+
+// Import STL
+#include <vector>
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class Terrain;
+    struct TerrainFileHeader;
+
+    // Pointer type definitions
+    typedef shared_ptr<Terrain> TerrainPtr;
+
+    // Format identification
+    const char     TERRAIN_FILE_MAGIC[4] = { 'B', 'F', 'T', 'R' };
+    const uint32_t TERRAIN_FILE_VERSION  = 1;
+};
+
+
+struct Battlefield::TerrainFileHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t samplesX, samplesZ;
+    double   spacing;
+    double   base, relief;          // What the image's greys were scaled to
+    uint64_t sourceSize;            // Of the image file this came from
+    int64_t  sourceTime;            // Its modification time (seconds)
+};
+
+
+class Battlefield::Terrain {
+public:
+    typedef Transform::scalar_t scalar_t;
+
+    // Tile dimensions
+    static const size_t TILE_CELLS = 32;
+    static const size_t TILE_SAMPLES = TILE_CELLS + 1;
+    static const size_t TILE_SIZE = TILE_SAMPLES * TILE_SAMPLES;
+
+    // Signature of a query implementation. Normals are only computed if
+    // 'nx' isn't NULL.
+    typedef void (*QueryKernel)(const Terrain &t, size_t n,
+                                const scalar_t *x, const scalar_t *z,
+                                scalar_t *h, scalar_t *nx, scalar_t *ny,
+                                scalar_t *nz);
+
+    // Constructor, from the heights of a samplesX x samplesZ grid with
+    // 'spacing' between samples, given a row (constant z) at a time. There
+    // must be at least two samples each way.
+    Terrain(size_t samplesX, size_t samplesZ, const float *heights,
+            scalar_t spacing);
+
+    // A flat field at 'elevation', at least 'width' x 'length' in size
+    static TerrainPtr flat(scalar_t width, scalar_t length, scalar_t elevation);
+
+    // A field 'width' across, shaped like the greyscale of an image (or
+    // NULL, if it can't be read), from its .terrain file if that's up to
+    // date, or else decoded and saved to one
+    static TerrainPtr load(const string &filename, scalar_t width,
+                           scalar_t base, scalar_t relief);
+
+    // Read or write a .terrain file, built from an image of this size &
+    // time and scaled like this. map() returns NULL if the file is missing
+    // or damaged, or doesn't match.
+    static TerrainPtr map(const string &filename, scalar_t width,
+                          scalar_t base, scalar_t relief,
+                          uint64_t sourceSize, int64_t sourceTime);
+    bool store(const string &filename, scalar_t base, scalar_t relief,
+               uint64_t sourceSize, int64_t sourceTime) const;
+
+    // Dimensions
+    size_t samplesX() const { return countX; }
+    size_t samplesZ() const { return countZ; }
+    scalar_t spacing() const { return cellSize; }
+    scalar_t width() const { return cellSize * (countX - 1); }
+    scalar_t length() const { return cellSize * (countZ - 1); }
+
+    // One sample of the grid, and where it is
+    float sample(size_t x, size_t z) const { return tileData[offsetOf(x, z)]; }
+    scalar_t sampleX(size_t x) const { return originX + x * cellSize; }
+    scalar_t sampleZ(size_t z) const { return originZ + z * cellSize; }
+
+    // Height of the ground under a single point
+    scalar_t height(scalar_t x, scalar_t z) const;
+
+    // Height (and normal) of the ground under each of 'n' points
+    void heights(size_t n, const scalar_t *x, const scalar_t *z,
+                 scalar_t *h) const {
+        kernel(*this, n, x, z, h, NULL, NULL, NULL);
+    }
+    void heightsAndNormals(size_t n, const scalar_t *x, const scalar_t *z,
+                           scalar_t *h, scalar_t *nx, scalar_t *ny,
+                           scalar_t *nz) const {
+        kernel(*this, n, x, z, h, nx, ny, nz);
+    }
+
+    // The query implementations, and which one we're using (the fastest
+    // one for this processor, by default)
+    static void queryScalar(const Terrain &t, size_t n,
+                            const scalar_t *x, const scalar_t *z, scalar_t *h,
+                            scalar_t *nx, scalar_t *ny, scalar_t *nz);
+    static void queryAVX2(const Terrain &t, size_t n,
+                          const scalar_t *x, const scalar_t *z, scalar_t *h,
+                          scalar_t *nx, scalar_t *ny, scalar_t *nz);
+    static QueryKernel selectQueryKernel();
+    static const char * queryKernelName(QueryKernel k);
+    QueryKernel queryKernel() const { return kernel; }
+    void setQueryKernel(QueryKernel k) { kernel = k; }
+
+protected:
+    Terrain() : tileData(NULL) { }
+
+    // Not copyable (we may own a mapping, and 'tileData' points into
+    // whichever of that or 'tiles' we're using)
+    Terrain(const Terrain &) = delete;
+    Terrain & operator=(const Terrain &) = delete;
+
+    // Work out the tile & world layout for a samplesX x samplesZ grid
+    void layOut(size_t samplesX, size_t samplesZ, scalar_t spacing);
+
+    // Where sample (x, z) lives in 'tiles'. For the cell starting there,
+    // the other corners are +1, +TILE_SAMPLES and +TILE_SAMPLES + 1. (The
+    // last row & column are only in the tiles before them.)
+    size_t offsetOf(size_t x, size_t z) const {
+        size_t tx = x / TILE_CELLS, tz = z / TILE_CELLS;
+        if (tx == tilesX)   tx--;
+        if (tz == tilesZ)   tz--;
+        return (tz * tilesX + tx) * TILE_SIZE
+             + (z - tz * TILE_CELLS) * TILE_SAMPLES + (x - tx * TILE_CELLS);
+    }
+
+    size_t countX, countZ;          // Samples each way
+    size_t tilesX, tilesZ;          // Tiles each way
+    scalar_t cellSize, inverseCellSize;
+    scalar_t originX, originZ;      // Where sample (0, 0) is
+    const float * tileData;
+    std::vector<float> tiles;       // Samples, if we built them...
+    MappedFile file;                // ...or the file they're in
+    QueryKernel kernel;
+};
+
+#endif
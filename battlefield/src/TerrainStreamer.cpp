@@ -0,0 +1,412 @@
+/*
+ * File: TerrainStreamer.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the TerrainStreamer class, defined in
+ *      TerrainStreamer.hpp.
+ */
+
+// Import class definition
+#include "TerrainStreamer.hpp"
+#include "Metrics.hpp"
+#include "TextureCache.hpp"
+#include "Trace.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+// Loading parameters
+const size_t STREAMING_THREADS = 2;
+const size_t MAX_LOADS         = 8;     // Chunks being built at once
+const size_t MAX_INSTALLS      = 2;     // Chunks handed to the scene per update
+
+// Detail parameters, in multiples of the camera's distance (rho). Chunks
+// within LOD_NEAR of the look-at point get full detail, with one level
+// less for each doubling of the distance after that, out to VIEW_RANGE.
+const Transform::scalar_t LOD_NEAR        = 0.5;
+const Transform::scalar_t VIEW_RANGE      = 4.0;
+const Transform::scalar_t LOD_HYSTERESIS  = 0.2;    // Of a level
+const Transform::scalar_t RANGE_HYSTERESIS = 0.1;   // Of VIEW_RANGE
+const Transform::scalar_t REPLAN_FRACTION = 0.05;   // Of rho
+
+// How far the skirts hang down, per unit of cell width
+const Transform::scalar_t SKIRT_SLOPE = 1.0;
+
+// Rough cost of a chunk, in Inca's mesh structures
+const size_t BYTES_PER_VERTEX   = 96;
+const size_t BYTES_PER_TRIANGLE = 128;
+
+typedef SolidObject3D::LinearApproximation PolygonMesh;
+typedef SolidObject3D::LinearApproximationPtr PolygonMeshPtr;
+
+
+// Which samples a chunk uses at a given step: every 'step'th one from
+// 'first', and always 'last'
+static void chunkSamples(size_t first, size_t last, size_t step,
+                         std::vector<size_t> &samples) {
+    samples.clear();
+    for (size_t s = first; s < last; s += step)
+        samples.push_back(s);
+    samples.push_back(last);
+}
+
+// Give a chunk object a new mesh & material (or none)
+static void setGeometry(SolidObject3D &obj, PolygonMeshPtr mesh, MaterialPtr mat) {
+    // Chunk objects only ever have the one of each
+    if (obj.approximationCount() > 0) {
+        obj.removeApproximation(0);
+        obj.removeMaterial(0);
+    }
+    if (mesh != NULL) {
+        obj.addApproximation(mesh);
+        obj.addMaterial(mat);
+    }
+}
+
+
+// Constructor
+TerrainStreamer::TerrainStreamer(Scene &s, TerrainPtr t,
+                                 MaterialPtr material, const string &texture,
+                                 Material::scalar_t u, Material::scalar_t v,
+                                 size_t budgetBytes)
+        : scene(s), terrain(t), repeatU(u), repeatV(v),
+          budgetSize(budgetBytes),
+          chunksX((t->samplesX() - 2) / CHUNK_CELLS + 1),
+          chunksZ((t->samplesZ() - 2) / CHUNK_CELLS + 1),
+          chunks(chunksX * chunksZ),
+          resident(0), residentSize(0), loads(0), waiting(0),
+          plannedLookAt(0.0), plannedRho(0.0),
+          pool(STREAMING_THREADS + 1, "terrain builder") {
+    // Each level gets the matching mip level of the texture
+    for (int lod = 0; lod < LOD_LEVELS; lod++) {
+        MaterialPtr m(new Material(*material));
+        TextureCache::instance().bind(m, texture, size_t(lod));
+        materials.push_back(m);
+    }
+}
+
+
+void TerrainStreamer::update(const Point &lookAt, scalar_t rho) {
+    BATTLEFIELD_TIME_SCOPE("terrain");
+    BATTLEFIELD_TRACE_SCOPE("terrain");
+    rho = std::max(rho, terrain->spacing());
+
+    // Only re-think what we want once the camera's moved a bit
+    Vector moved = lookAt - plannedLookAt;
+    if (std::fabs(rho - plannedRho) > REPLAN_FRACTION * plannedRho
+            || magnitude(moved) > REPLAN_FRACTION * rho)
+        plan(lookAt, rho);
+
+    finishLoads();
+    startLoads();
+
+    BATTLEFIELD_COUNT("terrain chunks", resident);
+    BATTLEFIELD_COUNT("terrain KB", residentSize / 1024);
+}
+
+
+void TerrainStreamer::plan(const Point &lookAt, scalar_t rho) {
+    plannedLookAt = lookAt;
+    plannedRho = rho;
+
+    // Forget what we wanted last time
+    std::vector<size_t> previous;
+    previous.swap(order);
+    for (size_t i = 0; i < previous.size(); i++)
+        chunks[previous[i]].wanted = -1;
+
+    // Find every chunk in range, and how far it is from the look-at point
+    scalar_t chunkSize = CHUNK_CELLS * terrain->spacing();
+    scalar_t range = VIEW_RANGE * (1.0 + RANGE_HYSTERESIS) * rho;
+    scalar_t left = terrain->sampleX(0), bottom = terrain->sampleZ(0);
+    scalar_t minX = std::max((lookAt[0] - range - left) / chunkSize, 0.0),
+             maxX = std::min((lookAt[0] + range - left) / chunkSize, scalar_t(chunksX - 1)),
+             minZ = std::max((lookAt[2] - range - bottom) / chunkSize, 0.0),
+             maxZ = std::min((lookAt[2] + range - bottom) / chunkSize, scalar_t(chunksZ - 1));
+
+    std::vector<std::pair<scalar_t, size_t> > inRange;
+    for (scalar_t cz = std::floor(minZ); cz <= maxZ; cz += 1.0)
+        for (scalar_t cx = std::floor(minX); cx <= maxX; cx += 1.0) {
+            // Distance to the nearest point of the chunk
+            scalar_t x0 = left + cx * chunkSize, z0 = bottom + cz * chunkSize;
+            scalar_t dx = std::max(std::max(x0 - lookAt[0], lookAt[0] - (x0 + chunkSize)), 0.0);
+            scalar_t dz = std::max(std::max(z0 - lookAt[2], lookAt[2] - (z0 + chunkSize)), 0.0);
+            inRange.push_back(std::make_pair(std::sqrt(dx * dx + dz * dz),
+                                             size_t(cz) * chunksX + size_t(cx)));
+        }
+    std::sort(inRange.begin(), inRange.end());
+
+    // Nearest first, each gets the level it'd like if it fits in what's
+    // left of the budget, or else the best one that does
+    size_t planned = 0;
+    for (size_t i = 0; i < inRange.size(); i++) {
+        size_t c = inRange[i].second;
+        int lod = levelFor(inRange[i].first, rho, chunks[c].lod);
+        if (lod < 0)
+            continue;
+        for (; lod < LOD_LEVELS; lod++) {
+            size_t bytes = estimateBytes(c, lod);
+            if (planned + bytes <= budgetSize) {
+                planned += bytes;
+                chunks[c].wanted = lod;
+                order.push_back(c);
+                break;
+            }
+        }
+    }
+
+    // Put away whatever we don't want any more
+    for (size_t i = 0; i < previous.size(); i++)
+        if (chunks[previous[i]].wanted < 0 && chunks[previous[i]].lod >= 0)
+            hide(previous[i]);
+}
+
+int TerrainStreamer::levelFor(scalar_t distance, scalar_t rho, int current) const {
+    scalar_t range = VIEW_RANGE * rho;
+    if (current >= 0)
+        range *= 1.0 + RANGE_HYSTERESIS;
+    if (distance > range)
+        return -1;
+
+    // One level per doubling, unless we're near the line between the
+    // level we're at and the next one
+    scalar_t f = std::log2(std::max(distance / (LOD_NEAR * rho), 1e-6));
+    int lod = (f < 0.0) ? 0 : std::min(int(f) + 1, LOD_LEVELS - 1);
+    if (current >= 0 && std::abs(lod - current) == 1
+            && std::fabs(f - (std::max(lod, current) - 1)) < LOD_HYSTERESIS)
+        lod = current;
+    return lod;
+}
+
+size_t TerrainStreamer::estimateBytes(size_t chunk, int lod) const {
+    size_t step = size_t(1) << lod;
+    size_t x0 = (chunk % chunksX) * CHUNK_CELLS, z0 = (chunk / chunksX) * CHUNK_CELLS;
+    size_t x1 = std::min(x0 + CHUNK_CELLS, terrain->samplesX() - 1),
+           z1 = std::min(z0 + CHUNK_CELLS, terrain->samplesZ() - 1);
+    size_t nx = (x1 - x0 + step - 1) / step + 1, nz = (z1 - z0 + step - 1) / step + 1;
+
+    // The grid, plus a skirt along each edge
+    return chunkBytes(nx * nz + 2 * (nx + nz),
+                      2 * (nx - 1) * (nz - 1) + 4 * ((nx - 1) + (nz - 1)));
+}
+
+size_t TerrainStreamer::chunkBytes(size_t vertices, size_t triangles) {
+    return vertices * BYTES_PER_VERTEX + triangles * BYTES_PER_TRIANGLE;
+}
+
+
+void TerrainStreamer::startLoads() {
+    // Things that are getting coarser go first, since they free up memory
+    // that the others may be waiting for
+    for (int pass = 0; pass < 2 && loads < MAX_LOADS; pass++)
+        for (size_t i = 0; i < order.size() && loads < MAX_LOADS; i++) {
+            Chunk &c = chunks[order[i]];
+            if (c.loading >= 0 || c.wanted == c.lod || c.wanted == c.built)
+                continue;
+            bool coarser = (c.lod >= 0 && c.wanted > c.lod);
+            if (coarser != (pass == 0))
+                continue;
+
+            TerrainPtr t = terrain;
+            size_t cx = order[i] % chunksX, cz = order[i] / chunksX;
+            int lod = c.wanted;
+            Material::scalar_t u = repeatU, v = repeatV;
+            c.loading = lod;
+            c.geometry = pool.async([t, cx, cz, lod, u, v] {
+                BATTLEFIELD_TRACE_SCOPE("terrain chunk");
+                return buildChunk(*t, cx, cz, lod, u, v);
+            });
+            loads++;
+        }
+}
+
+void TerrainStreamer::finishLoads() {
+    size_t installed = 0;
+    for (size_t i = 0; i < chunks.size() && (loads > 0 || waiting > 0)
+                                          && installed < MAX_INSTALLS; i++) {
+        Chunk &c = chunks[i];
+
+        // Collect whatever's finished building
+        if (c.loading >= 0 && c.geometry.wait_for(std::chrono::seconds(0))
+                                == std::future_status::ready) {
+            ChunkGeometryPtr geometry = c.geometry.get();
+            int lod = c.loading;
+            c.loading = -1;
+            c.geometry = std::shared_future<ChunkGeometryPtr>();
+            loads--;
+            if (geometry != NULL) {
+                if (c.built < 0)
+                    waiting++;
+                c.ready = geometry;
+                c.built = lod;
+            }
+        }
+        if (c.built < 0)
+            continue;
+
+        // It may not be wanted any more, or not fit just yet (in which case
+        // we hang on to it until whatever's getting smaller makes room)
+        if (c.built == c.wanted) {
+            size_t bytes = chunkBytes(c.ready->vertexCount(), c.ready->triangleCount());
+            if (bytes > c.bytes && residentSize - c.bytes + bytes > budgetSize)
+                continue;
+            show(i, *c.ready, c.built);
+            installed++;
+        }
+        c.ready.reset();
+        c.built = -1;
+        waiting--;
+    }
+}
+
+
+void TerrainStreamer::show(size_t chunk, const ChunkGeometry &g, int lod) {
+    BATTLEFIELD_TRACE_SCOPE("terrain install");
+    Chunk &c = chunks[chunk];
+
+    // Find something to draw it with
+    if (c.object == NONE) {
+        if (freeObjects.empty()) {
+            SolidObject3DPtr obj(new SolidObject3D());
+            scene.addObject(obj);
+            objects.push_back(obj);
+            freeObjects.push_back(objects.size() - 1);
+        }
+        c.object = freeObjects.back();
+        freeObjects.pop_back();
+    }
+
+    // Turn the geometry into a mesh
+    PolygonMeshPtr mesh(new PolygonMesh());
+    size_t n = g.vertexCount();
+    std::vector<PolygonMesh::VertexPtr> vertices(n);
+    std::vector<index_t> normals(n), texCoords(n);
+    for (size_t i = 0; i < n; i++) {
+        const float *p = &g.position[3 * i], *nv = &g.normal[3 * i], *t = &g.texCoords[2 * i];
+        vertices[i] = mesh->createVertex(PolygonMesh::Point(p[0], p[1], p[2]));
+        normals[i] = mesh->createNormal(PolygonMesh::Vector(nv[0], nv[1], nv[2]));
+        texCoords[i] = mesh->createTexCoords(PolygonMesh::TexCoords(t[0], t[1]));
+    }
+    for (size_t f = 0; f < g.triangleCount(); f++) {
+        PolygonMesh::FaceVertexPtrList corners;
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t i = g.triangles[3 * f + k];
+            corners.push_back(mesh->createFaceVertex(vertices[i]));
+            corners[k]->setNormalIndex(normals[i]);
+            corners[k]->setTexCoordsIndex(texCoords[i]);
+        }
+        mesh->createFace(corners);
+    }
+    setGeometry(*objects[c.object], mesh, materials[lod]);
+
+    size_t bytes = chunkBytes(n, g.triangleCount());
+    if (c.lod < 0)
+        resident++;
+    residentSize += bytes - c.bytes;
+    c.lod = lod;
+    c.bytes = bytes;
+}
+
+void TerrainStreamer::hide(size_t chunk) {
+    Chunk &c = chunks[chunk];
+    setGeometry(*objects[c.object], PolygonMeshPtr(), MaterialPtr());
+    freeObjects.push_back(c.object);
+    resident--;
+    residentSize -= c.bytes;
+    c.object = NONE;
+    c.lod = -1;
+    c.bytes = 0;
+}
+
+
+ChunkGeometryPtr TerrainStreamer::buildChunk(const Terrain &terrain,
+                                             size_t chunkX, size_t chunkZ, int lod,
+                                             Material::scalar_t repeatU,
+                                             Material::scalar_t repeatV) {
+    size_t step = size_t(1) << lod;
+    size_t lastX = terrain.samplesX() - 1, lastZ = terrain.samplesZ() - 1;
+    size_t x0 = chunkX * CHUNK_CELLS, z0 = chunkZ * CHUNK_CELLS;
+    std::vector<size_t> columns, rows;
+    chunkSamples(x0, std::min(x0 + CHUNK_CELLS, lastX), step, columns);
+    chunkSamples(z0, std::min(z0 + CHUNK_CELLS, lastZ), step, rows);
+    size_t nx = columns.size(), nz = rows.size(), n = nx * nz;
+
+    // Look up the ground at every sample we're using
+    std::vector<Transform::scalar_t> x(n), z(n), h(n), normalX(n), normalY(n), normalZ(n);
+    for (size_t r = 0; r < nz; r++)
+        for (size_t c = 0; c < nx; c++) {
+            x[r * nx + c] = terrain.sampleX(columns[c]);
+            z[r * nx + c] = terrain.sampleZ(rows[r]);
+        }
+    terrain.heightsAndNormals(n, &x[0], &z[0], &h[0], &normalX[0], &normalY[0], &normalZ[0]);
+
+    ChunkGeometryPtr g(new ChunkGeometry());
+    size_t total = n + 2 * (nx + nz);
+    g->position.reserve(3 * total);
+    g->normal.reserve(3 * total);
+    g->texCoords.reserve(2 * total);
+    for (size_t r = 0; r < nz; r++)
+        for (size_t c = 0; c < nx; c++) {
+            size_t i = r * nx + c;
+            g->position.push_back(float(x[i]));
+            g->position.push_back(float(h[i]));
+            g->position.push_back(float(z[i]));
+            g->normal.push_back(float(normalX[i]));
+            g->normal.push_back(float(normalY[i]));
+            g->normal.push_back(float(normalZ[i]));
+            g->texCoords.push_back(repeatU * columns[c] / lastX);
+            g->texCoords.push_back(repeatV * rows[r] / lastZ);
+        }
+
+    // Two triangles per cell
+    g->triangles.reserve(3 * (2 * (nx - 1) * (nz - 1) + 4 * ((nx - 1) + (nz - 1))));
+    for (size_t r = 0; r + 1 < nz; r++)
+        for (size_t c = 0; c + 1 < nx; c++) {
+            uint32_t a = uint32_t(r * nx + c);
+            uint32_t cell[6] = { a, a + uint32_t(nx), a + uint32_t(nx) + 1,
+                                 a, a + uint32_t(nx) + 1, a + 1 };
+            g->triangles.insert(g->triangles.end(), cell, cell + 6);
+        }
+
+    // A skirt along each edge, going round so that they all face out. (We
+    // reserved room for them above, so copying from the grid is safe.)
+    float depth = float(SKIRT_SLOPE * step * terrain.spacing());
+    for (int edge = 0; edge < 4; edge++) {
+        size_t count = (edge % 2 == 0) ? nx : nz;
+        uint32_t top = 0, bottom = 0;
+        for (size_t k = 0; k < count; k++) {
+            size_t i;
+            switch (edge) {
+            case 0:  i = k;                             break;  // Near, +x
+            case 1:  i = k * nx + nx - 1;               break;  // Right, +z
+            case 2:  i = (nz - 1) * nx + nx - 1 - k;    break;  // Far, -x
+            default: i = (nz - 1 - k) * nx;             break;  // Left, -z
+            }
+            uint32_t below = uint32_t(g->vertexCount());
+            g->position.push_back(g->position[3 * i]);
+            g->position.push_back(g->position[3 * i + 1] - depth);
+            g->position.push_back(g->position[3 * i + 2]);
+            for (size_t j = 0; j < 3; j++)
+                g->normal.push_back(g->normal[3 * i + j]);
+            for (size_t j = 0; j < 2; j++)
+                g->texCoords.push_back(g->texCoords[2 * i + j]);
+
+            if (k > 0) {
+                uint32_t quad[6] = { top, uint32_t(i), below,
+                                     top, below, bottom };
+                g->triangles.insert(g->triangles.end(), quad, quad + 6);
+            }
+            top = uint32_t(i);
+            bottom = below;
+        }
+    }
+    return g;
+}
@@ -0,0 +1,165 @@
+/*
+ * File: TerrainStreamer.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The TerrainStreamer class draws the Terrain in square chunks, and
+ *      keeps only the chunks around where the camera is looking in memory.
+ *
+ *      Each chunk can be built at one of LOD_LEVELS levels of detail, using
+ *      every sample, every second one, every fourth one, and so on, and
+ *      textured with the matching mip level of the ground texture. How
+ *      detailed a chunk should be depends on how far it is from the point
+ *      the camera is looking at, compared with how far away the camera is
+ *      (i.e., lookAt and rho); chunks too far out aren't drawn at all. A
+ *      chunk that's close to the line between two levels stays at whichever
+ *      one it's at, so that orbiting the camera doesn't make it flicker.
+ *
+ *      The nearest chunks get first call on the memory budget. Those that
+ *      don't fit at the level they'd like are made coarser, and dropped if
+ *      even the coarsest won't fit.
+ *
+ *      Chunks are built on the streamer's own threads, nearest first. Only
+ *      a few finished ones are handed over to the scene per update(), so
+ *      that a quick camera move doesn't stall a frame. Until its new level
+ *      arrives, a chunk keeps showing the old one. Each chunk has a skirt
+ *      hanging down from its edges, which hides the cracks between
+ *      neighbours at different levels.
+ *
+ *      The objects the chunks are drawn with are added to the scene as
+ *      they're needed and then re-used; they're never taken out again.
+ */
+
+#ifndef BATTLEFIELD_TERRAIN_STREAMER
+#define BATTLEFIELD_TERRAIN_STREAMER
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+#include <future>
+#include <stdint.h>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class TerrainStreamer;
+    struct ChunkGeometry;
+
+    // Pointer type definitions
+    typedef shared_ptr<TerrainStreamer> TerrainStreamerPtr;
+    typedef shared_ptr<ChunkGeometry> ChunkGeometryPtr;
+};
+
+
+// Import other battle type definitions
+#include "Terrain.hpp"
+#include "WorkerPool.hpp"
+
+
+// One chunk at one level of detail, as built in the background
+struct Battlefield::ChunkGeometry {
+    std::vector<float> position;        // x, y, z per vertex
+    std::vector<float> normal;          // x, y, z per vertex
+    std::vector<float> texCoords;       // u, v per vertex
+    std::vector<uint32_t> triangles;    // Three vertices each
+
+    size_t vertexCount() const { return position.size() / 3; }
+    size_t triangleCount() const { return triangles.size() / 3; }
+};
+
+
+class Battlefield::TerrainStreamer {
+public:
+    typedef Transform::scalar_t scalar_t;
+    typedef Transform::Point    Point;
+
+    // Chunk dimensions & detail levels
+    static const size_t CHUNK_CELLS = 2 * Terrain::TILE_CELLS;
+    static const int LOD_LEVELS = 4;
+
+    // Constructor, for drawing 'terrain' in 'scene', with copies of
+    // 'material' textured with 'texture' (repeated 'repeatU' x 'repeatV'
+    // times across the whole field), using no more than about
+    // 'budgetBytes' of memory for the chunks' geometry
+    TerrainStreamer(Scene &scene, TerrainPtr terrain,
+                    MaterialPtr material, const string &texture,
+                    Material::scalar_t repeatU, Material::scalar_t repeatV,
+                    size_t budgetBytes);
+
+    // Bring in the chunks around 'lookAt', as seen from 'rho' away, and
+    // put away the ones we don't need any more. This should be called
+    // every frame, to pick up the chunks that have finished loading.
+    void update(const Point &lookAt, scalar_t rho);
+
+    // Build one chunk at level 'lod' (which any thread may do)
+    static ChunkGeometryPtr buildChunk(const Terrain &terrain,
+                                       size_t chunkX, size_t chunkZ, int lod,
+                                       Material::scalar_t repeatU,
+                                       Material::scalar_t repeatV);
+
+    // How much of the budget that chunk would use
+    static size_t chunkBytes(size_t vertices, size_t triangles);
+
+    // How things stand
+    size_t chunkCount() const { return chunks.size(); }
+    size_t residentChunks() const { return resident; }
+    size_t residentBytes() const { return residentSize; }
+    size_t budget() const { return budgetSize; }
+
+protected:
+    // Where one chunk is at
+    struct Chunk {
+        Chunk() : lod(-1), wanted(-1), loading(-1), built(-1), bytes(0), object(NONE) { }
+        int lod;                // The level being shown (-1 if none)
+        int wanted;             // The level we'd like (-1 if none)
+        int loading;            // The level being built (-1 if none)
+        int built;              // The level waiting for room (-1 if none)
+        size_t bytes;           // Budget used by what's shown
+        size_t object;          // The object showing it
+        std::shared_future<ChunkGeometryPtr> geometry;
+        ChunkGeometryPtr ready; // What's waiting for room
+    };
+    static const size_t NONE = size_t(-1);
+
+    // Work out which chunks we want, and at what level
+    void plan(const Point &lookAt, scalar_t rho);
+    int levelFor(scalar_t distance, scalar_t rho, int current) const;
+    size_t estimateBytes(size_t chunk, int lod) const;
+
+    // Start building whatever we want and don't have, and put what's
+    // finished into the scene
+    void startLoads();
+    void finishLoads();
+    void show(size_t chunk, const ChunkGeometry &geometry, int lod);
+    void hide(size_t chunk);
+
+    Scene &scene;
+    TerrainPtr terrain;
+    std::vector<MaterialPtr> materials;     // One per level
+    Material::scalar_t repeatU, repeatV;
+    size_t budgetSize;
+
+    size_t chunksX, chunksZ;
+    std::vector<Chunk> chunks;
+    std::vector<size_t> order;              // What we want, nearest first
+    size_t resident, residentSize, loads, waiting;
+
+    // Where we last planned from
+    Point plannedLookAt;
+    scalar_t plannedRho;
+
+    // Objects to draw the chunks with
+    std::vector<SolidObject3DPtr> objects;
+    std::vector<size_t> freeObjects;
+
+    // The loading threads (last, so they're finished before the rest of
+    // us goes away)
+    WorkerPool pool;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * File: TextureCache.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the TextureCache class, defined in
+ *      TextureCache.hpp.
+ */
+
+// Import class definition
+#include "TextureCache.hpp"
+#include "Log.hpp"
+using namespace Battlefield;
+
+// Import Inca stuff
+#include <io/IOUtilities.h++>
+
+// Import STL & file info stuff
+#include <algorithm>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+// Copy an image into an 8-bit RGB Inca image (and back out again). These
+// are the only places that care how Inca lays out its pixels.
+static ImagePtr makeImage(const MipChain::Level &level) {
+    ImagePtr img(new ImageRGB(level.width, level.height));
+    unsigned char *pixels = reinterpret_cast<unsigned char *>(img->pixels().getContents());
+    std::memcpy(pixels, level.pixels, size_t(level.width) * level.height * 3);
+    return img;
+}
+
+static MipChainPtr decodeImage(const string &filename) {
+    ImagePtr img;
+    try {
+        img = Inca::IO::loadImage(filename);
+    } catch (const Inca::IncaException &e) {
+        BATTLEFIELD_LOG(Error, "Can't load image " << filename << ": " << e);
+        return MipChainPtr();
+    }
+    if (img == NULL)
+        return MipChainPtr();
+
+    return MipChainPtr(new MipChain(img->size()[0], img->size()[1],
+        reinterpret_cast<const unsigned char *>(img->pixels().getContents())));
+}
+
+
+TextureCache & TextureCache::instance() {
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::EntryPtr TextureCache::entry(const string &filename) {
+    std::lock_guard<std::mutex> guard(lock);
+    EntryPtr &e = entries[filename];
+    if (e == NULL)
+        e = EntryPtr(new Entry());
+    return e;
+}
+
+MipChainPtr TextureCache::mipChain(const string &filename) {
+    EntryPtr e = entry(filename);
+    std::lock_guard<std::mutex> guard(e->lock);
+    if (e->loaded)
+        return e->chain;
+    e->loaded = true;
+
+    // The .mips file is only good if it was made from this version of
+    // the image
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        BATTLEFIELD_LOG(Error, "Can't find image " << filename);
+        return e->chain;
+    }
+    string cacheFile = filename + ".mips";
+    e->chain = MipChain::load(cacheFile, uint64_t(info.st_size), int64_t(info.st_mtime));
+
+    // If not, decode it the slow way and save it for next time
+    if (e->chain == NULL) {
+        e->chain = decodeImage(filename);
+        if (e->chain != NULL) {
+            {
+                std::lock_guard<std::mutex> countGuard(lock);
+                decodes++;
+            }
+            if (! e->chain->store(cacheFile, uint64_t(info.st_size),
+                                             int64_t(info.st_mtime)))
+                BATTLEFIELD_LOG(Warning, "Can't write " << cacheFile);
+        }
+    }
+    return e->chain;
+}
+
+ImagePtr TextureCache::image(const string &filename, size_t level) {
+    MipChainPtr chain = mipChain(filename);
+    EntryPtr e = entry(filename);
+    std::lock_guard<std::mutex> guard(e->lock);
+    if (chain == NULL)
+        return ImagePtr();
+
+    level = std::min(level, chain->levelCount() - 1);
+    if (e->images.size() <= level)
+        e->images.resize(level + 1);
+    if (e->images[level] == NULL)
+        e->images[level] = makeImage(chain->level(level));
+    return e->images[level];
+}
+
+void TextureCache::setRendering(bool r) {
+    std::lock_guard<std::mutex> guard(lock);
+    rendering = r;
+    if (! rendering) {
+        pending.clear();
+        bound.clear();
+    }
+}
+
+bool TextureCache::isRendering() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return rendering;
+}
+
+// Everything waiting in 'pending' is kept alive by it, so the addresses in
+// 'bound' can't be reused by new materials until resolve() forgets them
+void TextureCache::bind(MaterialPtr m, const string &filename, size_t level) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (! rendering)
+        return;
+    pending.push_back(std::make_pair(m, Binding(filename, level)));
+    bound[&*m] = Binding(filename, level);
+}
+
+void TextureCache::bindCopy(MaterialPtr copy, MaterialPtr original) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (! rendering)
+        return;
+    std::map<const Material *, Binding>::const_iterator b = bound.find(&*original);
+    if (b != bound.end())
+        pending.push_back(std::make_pair(copy, b->second));
+}
+
+size_t TextureCache::resolve() {
+    std::vector<std::pair<MaterialPtr, Binding> > work;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        work.swap(pending);
+        bound.clear();
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < work.size(); i++) {
+        ImagePtr img = image(work[i].second.first, work[i].second.second);
+        if (img != NULL) {
+            work[i].first->setImage(img);
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t TextureCache::decodeCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return decodes;
+}
@@ -0,0 +1,106 @@
+/*
+ * File: TextureCache.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The TextureCache class is a process-wide cache of the images used to
+ *      texture materials (the ground, camouflage, etc.), keyed by filename.
+ *
+ *      Each image is decoded at most once per process, and its mip chain is
+ *      saved next to it in a .mips file (e.g., data/mud01.jpeg.mips), so
+ *      that later runs can map it in rather than decode it again.
+ *
+ *      Nothing is decoded until it's needed: bind() just notes which image
+ *      a material should get, and resolve() (which the view calls before it
+ *      renders) hands the images out. So a run that never renders (like the
+ *      headless one) never decodes anything. Such a run doesn't even keep
+ *      track of the bindings, since nothing would ever let go of them: they
+ *      only start being noted once setRendering() turns them on.
+ *
+ *      A material can be given one of the smaller mip levels instead of the
+ *      full-size image (e.g., for distant terrain), in which case that's
+ *      the only level that's turned into an image.
+ */
+
+#ifndef BATTLEFIELD_TEXTURE_CACHE
+#define BATTLEFIELD_TEXTURE_CACHE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import the mip chain class
+#include "MipChain.hpp"
+
+// Import STL & threading stuff
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class TextureCache;
+};
+
+
+class Battlefield::TextureCache {
+public:
+    // Singleton access function
+    static TextureCache & instance();
+
+    // Get the mip chain for an image file, loading its .mips file or (if
+    // it's missing or out of date) decoding the image and writing one.
+    // Returns NULL if the image can't be decoded.
+    MipChainPtr mipChain(const string &filename);
+
+    // Will anything ever call resolve()? Until this is turned on, bind()
+    // and bindCopy() do nothing.
+    void setRendering(bool r);
+    bool isRendering() const;
+
+    // Give material 'm' the image in 'filename' (or its mip level 'level',
+    // or the smallest one, if there aren't that many), the next time
+    // resolve() is called. bindCopy() gives 'copy' the same image as
+    // 'original', if that's still waiting for one (if not, 'copy' already
+    // has it, having been copied from 'original').
+    void bind(MaterialPtr m, const string &filename, size_t level = 0);
+    void bindCopy(MaterialPtr copy, MaterialPtr original);
+
+    // Hand images out to everything bound since the last call, returning
+    // how many materials got one
+    size_t resolve();
+
+    // How many images we've had to decode (i.e., not found in .mips files)
+    size_t decodeCount() const;
+
+protected:
+    TextureCache() : rendering(false), decodes(0) { }
+
+    // The image for one level of 'filename', as handed to materials
+    ImagePtr image(const string &filename, size_t level);
+
+    // One cached image, which is loaded by whoever first asks for it
+    struct Entry {
+        std::mutex lock;
+        bool loaded;
+        MipChainPtr chain;
+        std::vector<ImagePtr> images;   // By level, made when first needed
+        Entry() : loaded(false) { }
+    };
+    typedef std::shared_ptr<Entry> EntryPtr;
+    EntryPtr entry(const string &filename);
+
+    mutable std::mutex lock;        // Guards everything below
+    std::map<string, EntryPtr> entries;
+    bool rendering;
+    typedef std::pair<string, size_t> Binding;     // Filename & level
+    std::vector<std::pair<MaterialPtr, Binding> > pending;
+    std::map<const Material *, Binding> bound;      // Of those in 'pending'
+    size_t decodes;
+};
+
+#endif
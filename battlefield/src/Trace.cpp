@@ -0,0 +1,200 @@
+/*
+ * File: Trace.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the Tracer class, defined in Trace.hpp.
+ */
+
+// Import class definition
+#include "Trace.hpp"
+using namespace Battlefield;
+
+// Import STL & threading stuff
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// The most spans a thread keeps (about 24 MB worth)
+const size_t TRACE_BUFFER_LIMIT = 1 << 20;
+
+// How many spans a buffer grows by at a time
+const size_t TRACE_BLOCK_SIZE = 4096;
+
+
+// One recorded span
+struct TraceEvent {
+    const char *name;
+    long long begin, duration;          // Nanoseconds since start()
+};
+
+// A fixed-size run of spans. Buffers grow a block at a time, so recording
+// never has to copy what's already there.
+struct TraceBlock {
+    TraceEvent events[TRACE_BLOCK_SIZE];
+};
+
+// Everything one thread has recorded. Only its own thread adds to it, but
+// the lock lets write() read it safely while that's still going on.
+struct TraceBuffer {
+    std::mutex lock;
+    size_t id;
+    string name;
+    std::vector<std::unique_ptr<TraceBlock>> blocks;
+    size_t count;                       // Spans used, across all blocks
+    size_t dropped;
+    bool finished;                      // Its thread has exited
+
+    const TraceEvent & event(size_t i) const {
+        return blocks[i / TRACE_BLOCK_SIZE]->events[i % TRACE_BLOCK_SIZE];
+    }
+};
+
+// All of the threads' buffers. A thread's buffer is freed by the first
+// write() after the thread exits, so pools that come and go don't pile up.
+static std::mutex buffersLock;
+static std::vector<TraceBuffer *> buffers;
+static size_t nextBufferID = 1;
+static std::atomic<long long> epoch(0);     // When start() was called
+
+std::atomic<bool> Tracer::active(false);
+
+
+// Owns the calling thread's buffer, and hands it over to write() to free
+// once the thread is done with it
+struct TraceBufferOwner {
+    TraceBuffer *buffer;
+
+    TraceBufferOwner() : buffer(NULL) { }
+    ~TraceBufferOwner() {
+        if (buffer != NULL) {
+            std::lock_guard<std::mutex> guard(buffer->lock);
+            buffer->finished = true;
+        }
+    }
+};
+
+// Get the calling thread's buffer, making one if it hasn't got one yet
+static TraceBuffer & threadBuffer() {
+    static thread_local TraceBufferOwner owner;
+    if (owner.buffer == NULL) {
+        TraceBuffer *buffer = new TraceBuffer();
+        buffer->count = 0;
+        buffer->dropped = 0;
+        buffer->finished = false;
+        std::lock_guard<std::mutex> guard(buffersLock);
+        buffer->id = nextBufferID++;
+        buffers.push_back(buffer);
+        owner.buffer = buffer;
+    }
+    return *owner.buffer;
+}
+
+void Tracer::start() {
+    {
+        std::lock_guard<std::mutex> guard(buffersLock);
+        for (size_t i = 0; i < buffers.size(); i++) {
+            std::lock_guard<std::mutex> bufferGuard(buffers[i]->lock);
+            buffers[i]->count = 0;        // Keep the blocks for reuse
+            buffers[i]->dropped = 0;
+        }
+        epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now().time_since_epoch()).count();
+    }
+    active = true;
+}
+
+void Tracer::stop() {
+    active = false;
+}
+
+void Tracer::nameThread(const string &name) {
+    TraceBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.name = name;
+}
+
+void Tracer::record(const char *name, Clock::time_point begin,
+                                      Clock::time_point end) {
+    TraceBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    if (buffer.count == buffer.blocks.size() * TRACE_BLOCK_SIZE) {
+        if (buffer.count >= TRACE_BUFFER_LIMIT) {
+            buffer.dropped++;
+            return;
+        }
+        buffer.blocks.push_back(std::unique_ptr<TraceBlock>(new TraceBlock()));
+    }
+
+    TraceEvent &e = buffer.blocks[buffer.count / TRACE_BLOCK_SIZE]
+                        ->events[buffer.count % TRACE_BLOCK_SIZE];
+    e.name = name;
+    e.begin = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  begin.time_since_epoch()).count() - epoch;
+    e.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    buffer.count++;
+}
+
+size_t Tracer::droppedCount() {
+    std::lock_guard<std::mutex> guard(buffersLock);
+    size_t dropped = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        std::lock_guard<std::mutex> bufferGuard(buffers[i]->lock);
+        dropped += buffers[i]->dropped;
+    }
+    return dropped;
+}
+
+bool Tracer::write(const string &filename) {
+    std::FILE *file = std::fopen(filename.c_str(), "w");
+    if (file == NULL)
+        return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::lock_guard<std::mutex> guard(buffersLock);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        TraceBuffer &buffer = *buffers[i];
+        std::lock_guard<std::mutex> bufferGuard(buffer.lock);
+
+        // Thread names are metadata events
+        if (! buffer.name.empty()) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                               "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                         first ? "" : ",\n", unsigned(buffer.id), buffer.name.c_str());
+            first = false;
+        }
+
+        // Spans are "complete" events, in microseconds
+        for (size_t e = 0; e < buffer.count; e++) {
+            const TraceEvent &event = buffer.event(e);
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                               "\"ts\":%.3f,\"dur\":%.3f}",
+                         first ? "" : ",\n", event.name, unsigned(buffer.id),
+                         event.begin * 1e-3, event.duration * 1e-3);
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+
+    // Now they've been written, free the buffers of threads that are gone
+    size_t kept = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        bool finished;
+        {
+            std::lock_guard<std::mutex> bufferGuard(buffers[i]->lock);
+            finished = buffers[i]->finished;
+        }
+        if (finished)
+            delete buffers[i];
+        else
+            buffers[kept++] = buffers[i];
+    }
+    buffers.resize(kept);
+
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * File: Trace.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The Tracer records a timeline of what every thread was doing, to be
+ *      loaded into a trace viewer (chrome://tracing, Perfetto) for picking
+ *      apart individual slow frames.
+ *
+ *      Code marks the spans it wants to see with BATTLEFIELD_TRACE_SCOPE,
+ *      giving a string literal to name the span by. While the tracer is
+ *      stopped (the usual case), that costs one test of a flag. While it's
+ *      running, each span is appended to a buffer belonging to the thread
+ *      it ran on, and write() gathers them all up into a Chrome trace-event
+ *      JSON file.
+ */
+
+#ifndef BATTLEFIELD_TRACE
+#define BATTLEFIELD_TRACE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <atomic>
+#include <chrono>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class Tracer;
+    class TraceScope;
+};
+
+
+class Battlefield::Tracer {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Is anything being recorded?
+    static bool isActive() { return active.load(std::memory_order_relaxed); }
+
+    // Start recording (throwing away anything recorded before), and stop
+    static void start();
+    static void stop();
+
+    // Write out everything recorded so far as trace-event JSON. Returns
+    // false if the file couldn't be written.
+    static bool write(const string &filename);
+
+    // Give the calling thread a name to show in the viewer
+    static void nameThread(const string &name);
+
+    // Record a span that ran on the calling thread. 'name' must stay valid
+    // until it's written out (string literals are ideal).
+    static void record(const char *name, Clock::time_point begin,
+                                         Clock::time_point end);
+
+    // How many spans were thrown away because a thread's buffer was full
+    static size_t droppedCount();
+
+protected:
+    static std::atomic<bool> active;
+};
+
+
+// Records the span of the scope it's declared in
+class Battlefield::TraceScope {
+public:
+    explicit TraceScope(const char *n) : name(NULL) {
+        if (Tracer::isActive()) {
+            name = n;
+            begin = Tracer::Clock::now();
+        }
+    }
+    ~TraceScope() {
+        if (name != NULL)
+            Tracer::record(name, begin, Tracer::Clock::now());
+    }
+
+protected:
+    const char *name;
+    Tracer::Clock::time_point begin;
+};
+
+
+#define BATTLEFIELD_TRACE_JOIN2(A, B) A ## B
+#define BATTLEFIELD_TRACE_JOIN(A, B) BATTLEFIELD_TRACE_JOIN2(A, B)
+#define BATTLEFIELD_TRACE_SCOPE(NAME)                                       \
+    Battlefield::TraceScope BATTLEFIELD_TRACE_JOIN(traceScope_, __LINE__)(NAME)
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * File: UnitStateTable.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the UnitStateTable class, defined in
+ *      UnitStateTable.hpp.
+ */
+
+// Import class definition
+#include "UnitStateTable.hpp"
+using namespace Battlefield;
+
+
+// Grab a slot for a new unit and fill it in with the default values
+index_t UnitStateTable::allocate(BattleUnit *owner) {
+    index_t s;
+    if (! freeSlots.empty()) {
+        s = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        s = size();
+        throttle.push_back(0.0);            brake.push_back(0.0);
+        wheelDeflection.push_back(0.0);     mass.push_back(0.0);
+        elevationOffset.push_back(0.0);     axleOffset.push_back(0.0);
+        maxEngineForce.push_back(0.0);      minTurningRadius.push_back(0.0);
+        minLinearFriction.push_back(0.0);   minAngularFriction.push_back(0.0);
+        maxLinearFriction.push_back(0.0);   maxAngularFriction.push_back(0.0);
+        goalDisplacement.push_back(Vector(0.0));
+        goalVelocity.push_back(Vector(0.0));
+        groundNormal.push_back(Vector(0.0, 1.0, 0.0));
+        unit.push_back(NULL);               stateIndex.push_back(0);
+    }
+
+    // Control state
+    throttle[s]           = 0.0;
+    brake[s]              = 0.0;
+    wheelDeflection[s]    = 0.0;
+
+    // Physical properties
+    mass[s]               = 100.0;
+    elevationOffset[s]    = 0.0;
+    axleOffset[s]         = 0.5;
+    maxEngineForce[s]     = 10.0;
+    minTurningRadius[s]   = 1.0;
+    minLinearFriction[s]  = 0.1;    // Friction coefficients
+    minAngularFriction[s] = 0.1;    // with no brakes applied
+    maxLinearFriction[s]  = 0.3;    // Friction coefficients
+    maxAngularFriction[s] = 0.5;    // with full braking
+
+    // Goal-reaching values
+    goalDisplacement[s]   = Vector(0.0);
+    goalVelocity[s]       = Vector(0.0);
+    groundNormal[s]       = Vector(0.0, 1.0, 0.0);
+
+    unit[s] = owner;
+    stateIndex[s] = 0;
+    return s;
+}
+
+void UnitStateTable::release(index_t s) {
+    unit[s] = NULL;
+    freeSlots.push_back(s);
+}
+
+void UnitStateTable::reserve(size_t n) {
+    throttle.reserve(n);            brake.reserve(n);
+    wheelDeflection.reserve(n);     mass.reserve(n);
+    elevationOffset.reserve(n);     axleOffset.reserve(n);
+    maxEngineForce.reserve(n);      minTurningRadius.reserve(n);
+    minLinearFriction.reserve(n);   minAngularFriction.reserve(n);
+    maxLinearFriction.reserve(n);   maxAngularFriction.reserve(n);
+    goalDisplacement.reserve(n);    goalVelocity.reserve(n);
+    groundNormal.reserve(n);
+    unit.reserve(n);                stateIndex.reserve(n);
+}
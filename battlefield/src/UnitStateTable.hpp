@@ -0,0 +1,124 @@
+/*
+ * File: UnitStateTable.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The UnitStateTable class stores the control, physical and
+ *      goal-reaching state of every BattleUnit in structure-of-arrays form:
+ *      one contiguous array per field, indexed by the unit's slot. This is
+ *      the real storage for those BattleUnit properties, so that the
+ *      per-step loops (FleetControl, GroundConstraint) can stream through
+ *      memory instead of chasing a pointer per unit per field.
+ *
+ *      The UnitStateField template is a property-like view of one field of
+ *      one unit, which lets code that deals with a single BattleUnit (e.g.,
+ *      the user interface) keep writing "unit->throttle = 1.0".
+ */
+
+#ifndef BATTLEFIELD_UNIT_STATE_TABLE
+#define BATTLEFIELD_UNIT_STATE_TABLE
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL
+#include <vector>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class BattleUnit;
+    class UnitStateTable;
+    struct UnitStateSlot;
+
+    // Pointer type definitions
+    typedef shared_ptr<UnitStateTable> UnitStateTablePtr;
+};
+
+
+class Battlefield::UnitStateTable {
+public:
+    // Geometric types
+    typedef Transform::scalar_t scalar_t;
+    typedef Transform::Vector   Vector;
+
+    // Slot management. Released slots are re-used by later allocations.
+    index_t allocate(BattleUnit *owner);
+    void release(index_t slot);
+    size_t size() const { return unit.size(); }
+    void reserve(size_t n);
+
+    // Control state
+    std::vector<scalar_t> throttle;
+    std::vector<scalar_t> brake;
+    std::vector<scalar_t> wheelDeflection;
+
+    // Physical properties
+    std::vector<scalar_t> mass;
+    std::vector<scalar_t> elevationOffset;
+    std::vector<scalar_t> axleOffset;
+    std::vector<scalar_t> maxEngineForce;
+    std::vector<scalar_t> minTurningRadius;
+    std::vector<scalar_t> minLinearFriction;
+    std::vector<scalar_t> minAngularFriction;
+    std::vector<scalar_t> maxLinearFriction;
+    std::vector<scalar_t> maxAngularFriction;
+
+    // Goal-reaching (relative) temporary values
+    std::vector<Vector>   goalDisplacement;
+    std::vector<Vector>   goalVelocity;
+
+    // The ground's normal under each unit, as of the last step
+    std::vector<Vector>   groundNormal;
+
+    // Bookkeeping: who owns each slot (NULL if free), and where that
+    // unit's body lives in the rigid-body SystemState
+    std::vector<BattleUnit *> unit;
+    std::vector<index_t>      stateIndex;
+
+protected:
+    std::vector<index_t> freeSlots;
+};
+
+
+// Where a particular unit's state lives
+struct Battlefield::UnitStateSlot {
+    UnitStateTablePtr table;
+    index_t slot;
+};
+
+
+namespace Battlefield {
+    // A view of one field of one unit's state, which behaves like the
+    // property_rw it replaces
+    template <typename T, std::vector<T> UnitStateTable::*Column>
+    class UnitStateField {
+    public:
+        explicit UnitStateField(const UnitStateSlot &s) : where(s) { }
+
+        // Not copyable, since a copy would still refer to the original's
+        // unit. (Assigning one to another copies the value across.)
+        UnitStateField(const UnitStateField &) = delete;
+
+        // Read accessors
+        operator T() const { return ((*where.table).*Column)[where.slot]; }
+        T operator()() const { return *this; }
+
+        // Write accessors
+        UnitStateField & operator=(const T &value) {
+            ((*where.table).*Column)[where.slot] = value;
+            return *this;
+        }
+        UnitStateField & operator=(const UnitStateField &f) {
+            return *this = T(f);
+        }
+
+    protected:
+        const UnitStateSlot &where;
+    };
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * File: ViewFrustum.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the ViewFrustum class, defined in
+ *      ViewFrustum.hpp.
+ */
+
+// Import class definition
+#include "ViewFrustum.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <cmath>
+
+
+// Cross product, and scaling to unit length
+static Transform::Vector crossProduct(const Transform::Vector &a, const Transform::Vector &b) {
+    return Transform::Vector(a[1] * b[2] - a[2] * b[1],
+                             a[2] * b[0] - a[0] * b[2],
+                             a[0] * b[1] - a[1] * b[0]);
+}
+
+static Transform::Vector unitVector(const Transform::Vector &v) {
+    return v * (1.0 / magnitude(v));
+}
+
+
+void ViewFrustum::aim(const Point &eye, const Vector &look,
+                      scalar_t fieldOfView, scalar_t aspect) {
+    eyePoint = eye;
+    forward = unitVector(look);
+
+    // The picture's axes. (Looking straight up or down, any right will do.)
+    Vector right = crossProduct(forward, Vector(0.0, 1.0, 0.0));
+    if (magnitude(right) < 1e-6)
+        right = Vector(1.0, 0.0, 0.0);
+    right = unitVector(right);
+    Vector up = crossProduct(right, forward);
+
+    // Something at (x, y) in the picture, 'z' in front of us, is in view
+    // if |x| <= z * tanHalfWidth, and likewise for y
+    tanHalfHeight = std::tan(0.5 * fieldOfView);
+    scalar_t tanHalfWidth = tanHalfHeight * aspect;
+    planes[0] = unitVector(right + forward * tanHalfWidth);
+    planes[1] = unitVector(forward * tanHalfWidth - right);
+    planes[2] = unitVector(up + forward * tanHalfHeight);
+    planes[3] = unitVector(forward * tanHalfHeight - up);
+    aimed = true;
+}
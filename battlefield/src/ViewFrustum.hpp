@@ -0,0 +1,81 @@
+/*
+ * File: ViewFrustum.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The ViewFrustum class is the part of the world a perspective camera
+ *      can see: the four planes through the eye that bound the picture. It
+ *      answers whether a bounding sphere might be in view, and roughly how
+ *      big it'll look, for deciding what to draw and in how much detail.
+ *
+ *      There's no far plane, since the battle is always small enough to
+ *      fit inside the camera's range. A frustum that hasn't been aimed
+ *      sees everything, full size.
+ */
+
+#ifndef BATTLEFIELD_VIEW_FRUSTUM
+#define BATTLEFIELD_VIEW_FRUSTUM
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class ViewFrustum;
+};
+
+
+class Battlefield::ViewFrustum {
+public:
+    // Geometric types
+    typedef Transform::scalar_t scalar_t;
+    typedef Transform::Point    Point;
+    typedef Transform::Vector   Vector;
+
+    // Constructors, for seeing everything, or for a camera at 'eye',
+    // looking along 'look' with +Y up, with a vertical field of view of
+    // 'fieldOfView' (radians) and a picture 'aspect' times as wide as it
+    // is tall
+    ViewFrustum() : aimed(false) { }
+    ViewFrustum(const Point &eye, const Vector &look,
+                scalar_t fieldOfView, scalar_t aspect) {
+        aim(eye, look, fieldOfView, aspect);
+    }
+    void aim(const Point &eye, const Vector &look,
+             scalar_t fieldOfView, scalar_t aspect);
+
+    // Might any of this sphere be in the picture?
+    bool intersects(const Point &center, scalar_t radius) const {
+        if (! aimed)
+            return true;
+        Vector offset = center - eyePoint;
+        for (int i = 0; i < 4; i++)
+            if (dot(offset, planes[i]) < -radius)
+                return false;
+        return dot(offset, forward) > -radius;
+    }
+
+    // About how much of the picture's height this sphere would cover (1 or
+    // more if it's right up against the camera)
+    scalar_t screenSize(const Point &center, scalar_t radius) const {
+        if (! aimed)
+            return 1.0;
+        scalar_t distance = magnitude(center - eyePoint);
+        if (distance <= radius)
+            return 1.0;
+        return radius / (distance * tanHalfHeight);
+    }
+
+protected:
+    bool aimed;
+    Point eyePoint;
+    Vector forward;
+    Vector planes[4];           // Inward normals of left, right, bottom & top
+    scalar_t tanHalfHeight;
+};
+
+#endif
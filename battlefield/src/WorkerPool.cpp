@@ -0,0 +1,193 @@
+/*
+ * File: WorkerPool.cpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      This file implements the WorkerPool class, defined in WorkerPool.hpp.
+ */
+
+// Import class definition
+#include "WorkerPool.hpp"
+#include "Trace.hpp"
+using namespace Battlefield;
+
+// Import STL
+#include <algorithm>
+
+
+// Constructor
+WorkerPool::WorkerPool(size_t n, const string &threadName)
+        : name(threadName), body(NULL), count(0), grain(1), remaining(0),
+          generation(0), stopping(false) {
+    if (n == 0)
+        n = std::thread::hardware_concurrency();
+    if (n == 0)
+        n = 1;
+
+    for (size_t i = 0; i < n; i++)
+        queues.push_back(new ChunkQueue());
+
+    // Thread 0 is whoever calls parallelFor()
+    for (size_t i = 1; i < n; i++)
+        threads.push_back(std::thread(&WorkerPool::workerMain, this, i));
+}
+
+// Destructor
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+}
+
+
+void WorkerPool::parallelFor(size_t n, size_t g, const RangeFunction &f) {
+    if (n == 0)
+        return;
+    if (g == 0)
+        g = 1;
+
+    // Not worth waking anybody up for
+    size_t chunks = (n + g - 1) / g;
+    if (threads.empty() || chunks == 1) {
+        f(0, n);
+        return;
+    }
+
+    // Describe the job. This must happen before the chunks are dealt out,
+    // since a worker still finishing the last job may grab one right away.
+    body = &f;
+    count = n;
+    grain = g;
+    failure = std::exception_ptr();
+    remaining = chunks;
+
+    // Deal each thread a contiguous run of chunks
+    size_t threadCount = queues.size();
+    for (size_t t = 0; t < threadCount; t++) {
+        std::lock_guard<std::mutex> guard(queues[t]->lock);
+        queues[t]->chunks.clear();
+        for (size_t c = chunks * t / threadCount; c < chunks * (t + 1) / threadCount; c++)
+            queues[t]->chunks.push_back(c);
+    }
+
+    // Wake up the workers and pitch in
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        generation++;
+    }
+    jobReady.notify_all();
+    runChunks(0);
+
+    // Wait for any stragglers
+    {
+        std::unique_lock<std::mutex> guard(jobLock);
+        jobDone.wait(guard, [this] { return remaining == 0; });
+    }
+    body = NULL;
+
+    if (failure)
+        std::rethrow_exception(failure);
+}
+
+
+void WorkerPool::submit(const Task &task) {
+    if (threads.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        tasks.push_back(task);
+    }
+    jobReady.notify_one();
+}
+
+void WorkerPool::workerMain(size_t self) {
+    Tracer::nameThread(name + " " + std::to_string(self));
+    size_t seen = 0;
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> guard(jobLock);
+            jobReady.wait(guard, [&] {
+                return stopping || generation != seen || ! tasks.empty();
+            });
+
+            // A parallelFor() takes priority, since somebody's waiting on it
+            if (generation != seen) {
+                seen = generation;
+            } else if (! tasks.empty()) {
+                task = tasks.front();
+                tasks.pop_front();
+            } else {
+                return;         // Stopping, and nothing left to do
+            }
+        }
+
+        if (task) {
+            BATTLEFIELD_TRACE_SCOPE("task");
+            try {
+                task();
+            } catch (...) {
+                // Nobody to tell (async() jobs report through their future)
+            }
+        } else {
+            runChunks(self);
+        }
+    }
+}
+
+void WorkerPool::runChunks(size_t self) {
+    size_t chunk;
+    while (takeChunk(self, chunk)) {
+        size_t begin = chunk * grain,
+               end   = std::min(begin + grain, count);
+        try {
+            (*body)(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(failureLock);
+            if (! failure)
+                failure = std::current_exception();
+        }
+
+        // If that was the last one, let the caller know
+        if (--remaining == 0) {
+            std::lock_guard<std::mutex> guard(jobLock);
+            jobDone.notify_all();
+        }
+    }
+}
+
+// Take the next chunk from our own run, or else steal the last chunk from
+// somebody else's
+bool WorkerPool::takeChunk(size_t self, size_t &chunk) {
+    {
+        ChunkQueue &mine = *queues[self];
+        std::lock_guard<std::mutex> guard(mine.lock);
+        if (! mine.chunks.empty()) {
+            chunk = mine.chunks.front();
+            mine.chunks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); i++) {
+        ChunkQueue &victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (! victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
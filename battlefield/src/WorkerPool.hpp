@@ -0,0 +1,125 @@
+/*
+ * File: WorkerPool.hpp
+ *
+ * Author: Ryan L. Saunders
+ *
+ * Copyright 2003, Ryan L. Saunders. All rights reserved.
+ *
+ * Description:
+ *      The WorkerPool class is a small work-stealing thread pool for
+ *      data-parallel loops over the units in the battle.
+ *
+ *      parallelFor() cuts a range into fixed-size chunks and deals a
+ *      contiguous run of them to each thread (the calling thread included).
+ *      A thread that runs out of its own chunks steals from the far end of
+ *      some other thread's run. Which thread runs which chunk varies from
+ *      run to run, but the chunks themselves do not, so a loop body that
+ *      writes only to its own elements gives the same results for any
+ *      number of threads.
+ *
+ *      Independent jobs can also be handed to the pool with submit() (or
+ *      async(), which gives back a future for the result). These run on the
+ *      pool's own threads whenever they're not busy with a parallelFor().
+ */
+
+#ifndef BATTLEFIELD_WORKER_POOL
+#define BATTLEFIELD_WORKER_POOL
+
+// Import system configuration and Inca libraries
+#include "battlefield-common.h"
+
+// Import STL & threading stuff
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+
+// This is part of the Battlefield simulation
+namespace Battlefield {
+    // Forward declarations
+    class WorkerPool;
+
+    // Pointer type definitions
+    typedef shared_ptr<WorkerPool> WorkerPoolPtr;
+};
+
+
+class Battlefield::WorkerPool {
+public:
+    // The body of a parallel loop, run over elements [begin, end)
+    typedef std::function<void (size_t begin, size_t end)> RangeFunction;
+
+    // An independent job
+    typedef std::function<void ()> Task;
+
+    // Constructor, giving the total number of threads to use (including the
+    // one calling parallelFor()). Zero means one per processor core. The
+    // pool's threads are named 'name' and a number in traces.
+    explicit WorkerPool(size_t threads = 0, const string &name = "pool worker");
+    ~WorkerPool();
+
+    // How many threads share the work
+    size_t threadCount() const { return queues.size(); }
+
+    // Run body over [0, count) in chunks of 'grain' elements, returning when
+    // every chunk is done. If the body throws, the first exception is
+    // re-thrown here, after the rest of the chunks have finished.
+    void parallelFor(size_t count, size_t grain, const RangeFunction &body);
+
+    // Run a job on one of the pool's threads, as soon as one is free (or
+    // right now, on this thread, if the pool doesn't have any others).
+    // Jobs still waiting when the pool is destroyed are run first.
+    void submit(const Task &task);
+
+    // Run a job as with submit(), giving back a future for its result (or
+    // for the exception it throws)
+    template <typename Function>
+    std::shared_future<typename std::result_of<Function()>::type>
+    async(Function f) {
+        typedef typename std::result_of<Function()>::type Result;
+        std::shared_ptr<std::packaged_task<Result ()> >
+            job(new std::packaged_task<Result ()>(f));
+        std::shared_future<Result> result = job->get_future().share();
+        submit([job] { (*job)(); });
+        return result;
+    }
+
+protected:
+    // A run of chunks waiting to be processed by one thread
+    struct ChunkQueue {
+        std::mutex lock;
+        std::deque<size_t> chunks;
+    };
+
+    // Thread main loop, and the chunk-running loop shared with the caller
+    void workerMain(size_t self);
+    void runChunks(size_t self);
+    bool takeChunk(size_t self, size_t &chunk);
+
+    string name;
+    std::vector<std::thread> threads;
+    std::vector<ChunkQueue *> queues;       // One per thread; 0 is the caller
+
+    // The loop currently being run
+    const RangeFunction * body;
+    size_t count, grain;
+    std::atomic<size_t> remaining;
+    std::exception_ptr failure;
+    std::mutex failureLock;
+
+    // Waking workers up and telling the caller we're done. Submitted jobs
+    // wait in 'tasks' (also guarded by jobLock).
+    std::mutex jobLock;
+    std::condition_variable jobReady, jobDone;
+    size_t generation;
+    bool stopping;
+    std::deque<Task> tasks;
+};
+
+#endif